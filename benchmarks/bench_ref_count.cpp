@@ -23,14 +23,15 @@ namespace bench_params{
   int store_percent = 10;
   int cas_percent = 0;
   string alg = "gnu";
+  bool large = false;
 }
 
-template<template<typename> typename AtomicSPType, template<typename> typename SPType>
-struct RefCountBenchmark : Benchmark {
+template<template<typename> typename AtomicSPType, template<typename> typename SPType, typename IntType>
+struct RefCountBenchmarkImpl : Benchmark {
 
-  RefCountBenchmark(): Benchmark(), 
+  RefCountBenchmarkImpl(): Benchmark(),
                        N(bench_params::size),
-                       asp_vec(new cdrc::utils::Padded<AtomicSPType<PaddedInt>>[N]) {
+                       asp_vec(new cdrc::utils::Padded<AtomicSPType<IntType>>[N]) {
     if(N > 100000) {  // initialize in parallel
       size_t n_threads = bench_params::threads;
       assert(n_threads <= cdrc::utils::num_threads());
@@ -41,18 +42,18 @@ struct RefCountBenchmark : Benchmark {
           cdrc::utils::rand::init(p+1);
           size_t chunk_size = N/n_threads + 1;
           for(size_t i = p*chunk_size; i < N && i < (p+1)*chunk_size; i++)
-            asp_vec[i].store(make_shared_int<SPType>(3));
+            asp_vec[i].store(make_shared_int<SPType, IntType>(3));
         });        
       }
       for (auto& t : threads) t.join();     
     }
     else { // intialize sequentially 
       for(size_t i = 0; i < N; i++)
-        asp_vec[i].store(make_shared_int<SPType>(3));
+        asp_vec[i].store(make_shared_int<SPType, IntType>(3));
     }
   }
 
-  ~RefCountBenchmark() {
+  ~RefCountBenchmarkImpl() {
     delete[] asp_vec;
   }
 
@@ -72,6 +73,7 @@ struct RefCountBenchmark : Benchmark {
           cdrc::utils::rand::init(p+1);
 
           barrier.wait();
+          qsbr_online<SPType>();
           
           long long int ops = 0;
           volatile long long int sum = 0;
@@ -80,16 +82,18 @@ struct RefCountBenchmark : Benchmark {
             int op = cdrc::utils::rand::get_rand()%100;
             int asp_index = cdrc::utils::rand::get_rand()%N;
             if(op < bench_params::store_percent){ // store
-              asp_vec[asp_index].store(make_shared_int<SPType>(ops & (1023)));
+              asp_vec[asp_index].store(make_shared_int<SPType, IntType>(ops & (1023)));
             } else if(op < bench_params::store_percent + bench_params::cas_percent) {  // CAS
               cerr << "not implemented" << endl;
               exit(1);
             } else {  // load
-              SPType<PaddedInt> sp = asp_vec[asp_index].load();
+              SPType<IntType> sp = asp_vec[asp_index].load();
               int x = sp->getInt();
               sum = sum + x;
             }
+            qsbr_quiescent_state<SPType>();
           }
+          qsbr_offline<SPType>();
           cnt[p] = ops;
         });
       }
@@ -103,8 +107,8 @@ struct RefCountBenchmark : Benchmark {
       while (elapsed_time < bench_params::runtime) {
         // If the current SPType supports tracking the number of allocations, keep
         // track of it here so we can estimate the amount of deferred reclamation
-        if constexpr (AllocationTrackable<AtomicSPType<PaddedInt>>) {
-          allocations.push_back(AtomicSPType<PaddedInt>::currently_allocated());
+        if constexpr (AllocationTrackable<AtomicSPType<IntType>>) {
+          allocations.push_back(AtomicSPType<IntType>::currently_allocated());
         }
         usleep(1000);
         elapsed_time = read_timer();
@@ -117,26 +121,38 @@ struct RefCountBenchmark : Benchmark {
       long long int total = std::accumulate(std::begin(cnt), std::end(cnt), 0LL);
       std::cout << "\tTotal Throughput = " << total/1000000.0/elapsed_time << " Mop/s in " << elapsed_time << " second(s)" << std::endl;
 
-      if constexpr (AllocationTrackable<AtomicSPType<PaddedInt>>) {
+      if constexpr (AllocationTrackable<AtomicSPType<IntType>>) {
         assert(allocations.size() > 0);
         auto avg_alloc = std::accumulate(std::begin(allocations), std::end(allocations), 0.0) / allocations.size();
         auto max_alloc = *std::max_element(std::begin(allocations), std::end(allocations));
         std::cout << "\tAverage number of allocated objects: " << avg_alloc << " (" << allocations.size() << " samples)" << std::endl;
         std::cout << "\tMaximum number of allocated objects: " << max_alloc << std::endl;
+        report_object_footprint<SPType, IntType>(avg_alloc);
       }
+      report_pool_occupancy<SPType>();
     }
   }
 
+  size_t N;
+  cdrc::utils::Padded<AtomicSPType<IntType>> *asp_vec;
+};
+
+template<template<typename> typename AtomicSPType, template<typename> typename SPType>
+struct RefCountBenchmark : Benchmark {
+
+  void bench() override {
+    if (bench_params::large) RefCountBenchmarkImpl<AtomicSPType, SPType, LargeInt>().bench();
+    else RefCountBenchmarkImpl<AtomicSPType, SPType, PaddedInt>().bench();
+  }
+
   static void print_name() {
     std::cout << "----------------------------------------------------------------" << std::endl;
     std::cout << "\tMicro-benchmark: P = " << bench_params::threads << ", N = " << bench_params::size << ", stores = " << 
-                        bench_params::store_percent << ", CASes = " << bench_params::cas_percent << std::endl;
+                        bench_params::store_percent << ", CASes = " << bench_params::cas_percent <<
+                        ", objects = " << (bench_params::large ? "large" : "small") << std::endl;
     std::cout << "--------------------------------------------------------------" << std::endl;
     //std::cout << AtomicSPType<int>::get_name() << std::endl;
   }
-
-  size_t N;
-  cdrc::utils::Padded<AtomicSPType<PaddedInt>> *asp_vec;
 };
 
 int main(int argc, char* argv[]) {
@@ -149,7 +165,8 @@ int main(int argc, char* argv[]) {
   ("update,u", po::value<int>()->default_value(10), "Percentage of Stores")
   ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
   ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
-  ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, orc");
+  ("large,l", po::bool_switch()->default_value(false), "Use large objects that span several cache lines instead of small ones")
+  ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, arc-before, arc-isolated, arc-16, arc-64, arc-pool, arc-qsbr, orc");
 
 
   po::variables_map vm;
@@ -167,6 +184,7 @@ int main(int argc, char* argv[]) {
   bench_params::threads = vm["threads"].as<int>();
   bench_params::size = vm["size"].as<int>();
   bench_params::store_percent = vm["update"].as<int>();
+  bench_params::large = vm["large"].as<bool>();
 
   run_benchmark<RefCountBenchmark>(bench_params::alg);
 }
@@ -0,0 +1,132 @@
+// Measures the cost of the scans that the hazard-pointer backend performs to apply
+// its deferred decrements, as a function of the number of threads that hold
+// snapshots and of the number of snapshot slots per thread.
+//
+// A number of reader threads each fill every one of their snapshot slots with a
+// snapshot of a distinct object, and then idle. A single writer thread repeatedly
+// stores new objects, each of which defers a decrement of the object that it
+// replaces. Every so often, the writer scans all of the announcement slots to apply
+// its deferred decrements, so the time per store is dominated by the amortized cost
+// of these scans as the number of announcements grows.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/snapshot_ptr.h>
+
+#include "common.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+namespace bench_params {
+  int iterations = 1;
+  double runtime = 1;
+  int threads = 4;
+  int slots = 7;
+}
+
+template<size_t snapshot_slots>
+struct ScanBenchmark : Benchmark {
+
+  template<typename T>
+  using memory_manager = cdrc::internal::acquire_retire<T, snapshot_slots>;
+
+  using rc_ptr = cdrc::rc_ptr<PaddedInt, memory_manager<PaddedInt>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<PaddedInt, memory_manager<PaddedInt>>;
+
+  void bench() override {
+    size_t n_threads = bench_params::threads;
+
+    for (int i = 0; i < bench_params::iterations; i++) {
+      std::atomic<bool> done = false;
+      std::atomic<size_t> ready = 0;
+      std::vector<std::thread> readers;
+
+      // Each reader holds a snapshot in every one of its snapshot slots
+      for (size_t p = 0; p < n_threads; p++) {
+        readers.emplace_back([&]() {
+          std::vector<atomic_rc_ptr> objects(snapshot_slots);
+          std::vector<decltype(objects[0].get_snapshot())> snapshots;
+          for (auto& object : objects) {
+            object.store(rc_ptr::make_shared(1));
+            snapshots.push_back(object.get_snapshot());
+          }
+          ready++;
+          while (!done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+      }
+      while (ready.load() < n_threads) std::this_thread::yield();
+
+      atomic_rc_ptr target(rc_ptr::make_shared(0));
+      long long int ops = 0;
+      start_timer();
+      double elapsed_time = 0;
+      while (elapsed_time < bench_params::runtime) {
+        for (int j = 0; j < 1000; j++, ops++) {
+          target.store(rc_ptr::make_shared(static_cast<int>(ops & 1023)));
+        }
+        elapsed_time = read_timer();
+      }
+      done.store(true);
+      for (auto& t : readers) t.join();
+
+      std::cout << "\tAnnounced snapshots = " << n_threads * snapshot_slots << ", thread IDs = " << cdrc::utils::num_thread_ids()
+                << ", time per deferred decrement = " << elapsed_time * 1e9 / ops << " ns" << std::endl;
+    }
+  }
+
+  static void print_name() {
+    std::cout << "----------------------------------------------------------------" << std::endl;
+    std::cout << "\tScan micro-benchmark: P = " << bench_params::threads << ", snapshot slots = " << snapshot_slots << std::endl;
+    std::cout << "--------------------------------------------------------------" << std::endl;
+  }
+};
+
+template<size_t snapshot_slots>
+void run_scan_benchmark() {
+  ScanBenchmark<snapshot_slots>::print_name();
+  ScanBenchmark<snapshot_slots>().bench();
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description description("Usage:");
+
+  description.add_options()
+  ("help,h", "Display this help message")
+  ("threads,t", po::value<int>()->default_value(4), "Number of threads that hold snapshots")
+  ("slots,s", po::value<int>()->default_value(7), "Number of snapshot slots per thread. Choose one of: 1, 7, 15, 31")
+  ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
+  ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark");
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")){
+    cout << description;
+    exit(0);
+  }
+
+  bench_params::iterations = vm["iterations"].as<int>();
+  bench_params::runtime = vm["runtime"].as<double>();
+  bench_params::threads = vm["threads"].as<int>();
+  bench_params::slots = vm["slots"].as<int>();
+
+  switch (bench_params::slots) {
+    case 1: run_scan_benchmark<1>(); break;
+    case 7: run_scan_benchmark<7>(); break;
+    case 15: run_scan_benchmark<15>(); break;
+    case 31: run_scan_benchmark<31>(); break;
+    default:
+      std::cout << "unsupported number of snapshot slots: " << bench_params::slots << std::endl;
+      exit(1);
+  }
+}
@@ -37,6 +37,7 @@ struct StackBenchmark : Benchmark {
   StackBenchmark(): Benchmark(),
                        N(bench_params::size),
                        stacks(N) {
+    qsbr_online<SPType>();
     if(N > 100000) {  // initialize in parallel
       size_t n_threads = bench_params::threads;
       assert(n_threads <= cdrc::utils::num_threads());
@@ -44,12 +45,14 @@ struct StackBenchmark : Benchmark {
       for(size_t p = 0; p < n_threads; p++) {
         threads.emplace_back([this, p, n_threads]() {
           cdrc::utils::rand::init(p+1);
+          qsbr_online<SPType>();
           size_t chunk_size = N/n_threads + 1;
           for(size_t i = p*chunk_size; i < N && i < (p+1)*chunk_size; i++) {
             for (size_t j = 0; j < bench_params::stack_size; j++) {
               stacks[i].push_front(cdrc::utils::rand::get_rand()%bench_params::stack_size);
             }
           }
+          qsbr_offline<SPType>();
         });
       }
       for (auto& t : threads) t.join();
@@ -73,12 +76,14 @@ struct StackBenchmark : Benchmark {
 
       std::atomic<bool> done = false;
       Barrier barrier(n_threads+1);
+      qsbr_offline<SPType>();  // The main thread only waits while the others run
 
       for (size_t p = 0; p < n_threads; p++) {
         threads.emplace_back([&barrier, &done, this, &cnt, p]() {
           cdrc::utils::rand::init(p+1);
 
           barrier.wait();
+          qsbr_online<SPType>();
 
           long long int ops = 0;
           long long int sum = 0;
@@ -108,7 +113,9 @@ struct StackBenchmark : Benchmark {
                 sum += found;
               }
             }
+            qsbr_quiescent_state<SPType>();
           }
+          qsbr_offline<SPType>();
           cnt[p] = ops;
         });
       }
@@ -131,7 +138,7 @@ struct StackBenchmark : Benchmark {
       done.store(true);
 
       for (auto& t : threads) t.join();
-
+      qsbr_online<SPType>();
 
       // Read results
       long long int total = std::accumulate(std::begin(cnt), std::end(cnt), 0LL);
@@ -143,7 +150,9 @@ struct StackBenchmark : Benchmark {
         auto max_alloc = *std::max_element(std::begin(allocations), std::end(allocations));
         std::cout << "\tAverage number of allocated objects: " << avg_alloc << " (" << allocations.size() << " samples)" << std::endl;
         std::cout << "\tMaximum number of allocated objects: " << max_alloc << std::endl;
+        stack_type::report_node_footprint(avg_alloc);
       }
+      report_pool_occupancy<SPType>();
       size_t total_nodes = 0;
       for(size_t i = 0; i < N; i++) {
         total_nodes += stacks[i].size();
@@ -173,7 +182,7 @@ int main(int argc, char* argv[]) {
       ("update,u", po::value<int>()->default_value(10), "Percentage of pushes/pops")
       ("runtime,r", po::value<double>()->default_value(0.5), "Runtime of Benchmark (seconds)")
       ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark")
-      ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, orc")
+      ("alg,a", po::value<string>()->default_value("gnu"), "Choose one of: gnu, jss, folly, herlihy, weak_atomic, arc, arc-before, arc-isolated, arc-16, arc-64, arc-pool, arc-qsbr, orc")
       ("stack_size", po::value<int>()->default_value(20), "Number of initial elements in each stack")
       ("peek", po::value<bool>()->default_value(false), "Use peek instead of find as the read workload");
 
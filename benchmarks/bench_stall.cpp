@@ -0,0 +1,201 @@
+// Measures how much memory a stalled thread holds back under each memory
+// management backend.
+//
+// A number of worker threads repeatedly take a snapshot of one object and
+// replace another with a new object, each of which defers a decrement of the
+// object that it replaces. Meanwhile, one more thread reads an object the way
+// that the backend expects reads to be done, i.e., inside a guard for EBR, IBR,
+// Hyaline, Hyaline-S, and Crystalline, or inside a read phase for NBR, and then
+// stalls there until the end of the run. The number of objects that are
+// allocated at any time is sampled throughout, and its peak is reported along
+// with the throughput. Without the stalled thread (--stall 0), this gives the
+// baseline of each backend.
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/snapshot_ptr.h>
+
+#include "common.hpp"
+
+using namespace std;
+namespace po = boost::program_options;
+
+namespace bench_params {
+  int iterations = 1;
+  double runtime = 1;
+  int threads = 4;
+  int objects = 64;
+  bool stall = true;
+  string alg = "hp";
+}
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using ibr_backend = cdrc::ibr_backend<T>;
+
+template<typename T>
+using he_backend = cdrc::he_backend<T>;
+
+template<typename T>
+using nbr_backend = cdrc::nbr_backend<T>;
+
+template<typename T>
+using hyaline_backend = cdrc::hyaline_backend<T>;
+
+template<typename T>
+using hyaline_s_backend = cdrc::hyaline_s_backend<T>;
+
+template<typename T>
+using crystalline_backend = cdrc::crystalline_backend<T>;
+
+// Runs the stalled reader as is
+struct plain_reads {
+  template<typename F>
+  static void run(F&& f) { f(); }
+};
+
+// Runs the stalled reader as a read phase, which can be neutralized
+struct nbr_reads {
+  template<typename F>
+  static void run(F&& f) { cdrc::with_nbr_read_phase(f); }
+};
+
+template<template<typename> typename memory_manager, typename guard_t, typename reads>
+struct StallBenchmark : Benchmark {
+
+  using rc_ptr = cdrc::rc_ptr<PaddedInt, memory_manager<PaddedInt>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<PaddedInt, memory_manager<PaddedInt>>;
+
+  void bench() override {
+    size_t n_threads = bench_params::threads;
+    size_t n_objects = bench_params::objects;
+
+    for (int i = 0; i < bench_params::iterations; i++) {
+      std::vector<atomic_rc_ptr> objects(n_objects);
+      for (auto& object : objects) object.store(rc_ptr::make_shared(0));
+
+      std::atomic<bool> done = false;
+      std::atomic<bool> stalled = !bench_params::stall;
+      std::atomic<long long int> total_ops = 0;
+
+      // Read an object, and then stall while still reading it
+      std::thread staller;
+      if (bench_params::stall) {
+        staller = std::thread([&]() {
+          reads::run([&]() {
+            [[maybe_unused]] guard_t guard;
+            auto s = objects[0].get_snapshot();
+            stalled.store(true);
+            while (!done.load() && s->x >= 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          });
+        });
+      }
+      while (!stalled.load()) std::this_thread::yield();
+
+      std::vector<std::thread> workers;
+      for (size_t p = 0; p < n_threads; p++) {
+        workers.emplace_back([&, p]() {
+          long long int ops = 0;
+          size_t k = p;
+          while (!done.load()) {
+            for (int j = 0; j < 100; j++, ops++) {
+              [[maybe_unused]] guard_t guard;
+              k = (k * 1103515245 + 12345) % n_objects;
+              auto s = objects[k].get_snapshot();
+              auto x = s ? s->x : 0;
+              objects[(k + 1) % n_objects].store(rc_ptr::make_shared(x + 1));
+            }
+          }
+          total_ops += ops;
+        });
+      }
+
+      // Sample the number of allocated objects until the time is up
+      size_t peak_allocated = 0;
+      start_timer();
+      double elapsed_time = 0;
+      while (elapsed_time < bench_params::runtime) {
+        peak_allocated = std::max(peak_allocated, atomic_rc_ptr::currently_allocated());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        elapsed_time = read_timer();
+      }
+      done.store(true);
+      for (auto& t : workers) t.join();
+      if (staller.joinable()) staller.join();
+
+      std::cout << "\tPeak allocated objects = " << peak_allocated << ", throughput = "
+                << total_ops.load() / elapsed_time / 1e6 << " Mop/s" << std::endl;
+    }
+  }
+
+  static void print_name() {
+    std::cout << "----------------------------------------------------------------" << std::endl;
+    std::cout << "\tStall micro-benchmark: P = " << bench_params::threads << ", objects = " << bench_params::objects
+              << ", stalled thread = " << (bench_params::stall ? "yes" : "no") << std::endl;
+    std::cout << "--------------------------------------------------------------" << std::endl;
+  }
+};
+
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard, typename reads = plain_reads>
+void run_stall_benchmark(const std::string& name) {
+  StallBenchmark<memory_manager, guard_t, reads>::print_name();
+  std::cout << name << std::endl;
+  StallBenchmark<memory_manager, guard_t, reads>().bench();
+  std::cout << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+  po::options_description description("Usage:");
+
+  description.add_options()
+  ("help,h", "Display this help message")
+  ("threads,t", po::value<int>()->default_value(4), "Number of worker threads, in addition to the stalled thread")
+  ("objects,n", po::value<int>()->default_value(64), "Number of shared objects")
+  ("stall,s", po::value<bool>()->default_value(true), "Whether to stall a reading thread")
+  ("alg,a", po::value<string>()->default_value("hp"), "Choose one of: hp, ebr, ibr, he, nbr, hyaline, hyaline_s, crystalline")
+  ("runtime,r", po::value<double>()->default_value(1), "Runtime of Benchmark (seconds)")
+  ("iterations,i", po::value<int>()->default_value(5), "Number of times to run benchmark");
+
+  po::variables_map vm;
+  po::store(po::command_line_parser(argc, argv).options(description).run(), vm);
+  po::notify(vm);
+
+  if (vm.count("help")){
+    cout << description;
+    exit(0);
+  }
+
+  bench_params::iterations = vm["iterations"].as<int>();
+  bench_params::runtime = vm["runtime"].as<double>();
+  bench_params::threads = vm["threads"].as<int>();
+  bench_params::objects = vm["objects"].as<int>();
+  bench_params::stall = vm["stall"].as<bool>();
+  bench_params::alg = vm["alg"].as<string>();
+
+  if (bench_params::alg == "hp") run_stall_benchmark<hp_backend>("Hazard pointers");
+  else if (bench_params::alg == "ebr") run_stall_benchmark<ebr_backend, cdrc::epoch_guard>("EBR");
+  else if (bench_params::alg == "ibr") run_stall_benchmark<ibr_backend, cdrc::epoch_guard>("IBR");
+  else if (bench_params::alg == "he") run_stall_benchmark<he_backend>("Hazard eras");
+  else if (bench_params::alg == "nbr") run_stall_benchmark<nbr_backend, cdrc::empty_guard, nbr_reads>("NBR");
+  else if (bench_params::alg == "hyaline") run_stall_benchmark<hyaline_backend, cdrc::hyaline_guard>("Hyaline");
+  else if (bench_params::alg == "hyaline_s") run_stall_benchmark<hyaline_s_backend, cdrc::hyaline_guard>("Hyaline-S");
+  else if (bench_params::alg == "crystalline") run_stall_benchmark<crystalline_backend, cdrc::crystalline_guard>("Crystalline");
+  else {
+    std::cout << "unsupported backend: " << bench_params::alg << std::endl;
+    exit(1);
+  }
+}
@@ -70,6 +70,51 @@ using SnapshottingArcPtr = cdrc::atomic_rc_ptr<T>;
 template<typename T>
 using OurRcPtr = cdrc::rc_ptr<T>;
 
+template<typename T>
+using SnapshottingArcPtrCompact = cdrc::atomic_rc_ptr<T, cdrc::hp_backend<T, cdrc::compact_counters_object_policy>>;
+
+template<typename T>
+using OurRcPtrCompact = cdrc::rc_ptr<T, cdrc::hp_backend<T, cdrc::compact_counters_object_policy>>;
+
+template<typename T>
+using SnapshottingArcPtrWide = cdrc::atomic_rc_ptr<T, cdrc::hp_backend<T, cdrc::wide_counters_object_policy>>;
+
+template<typename T>
+using OurRcPtrWide = cdrc::rc_ptr<T, cdrc::hp_backend<T, cdrc::wide_counters_object_policy>>;
+
+template<typename T>
+using SnapshottingArcPtrPool = cdrc::atomic_rc_ptr<T, cdrc::hp_backend<T, cdrc::pool_object_policy>>;
+
+template<typename T>
+using OurRcPtrPool = cdrc::rc_ptr<T, cdrc::hp_backend<T, cdrc::pool_object_policy>>;
+
+template<typename T>
+using SnapshottingArcPtrBefore = cdrc::atomic_rc_ptr<T, cdrc::hp_backend<T, cdrc::counters_before_payload_object_policy>>;
+
+template<typename T>
+using OurRcPtrBefore = cdrc::rc_ptr<T, cdrc::hp_backend<T, cdrc::counters_before_payload_object_policy>>;
+
+template<typename T>
+using SnapshottingArcPtrIsolated = cdrc::atomic_rc_ptr<T, cdrc::hp_backend<T, cdrc::isolated_counters_object_policy>>;
+
+template<typename T>
+using OurRcPtrIsolated = cdrc::rc_ptr<T, cdrc::hp_backend<T, cdrc::isolated_counters_object_policy>>;
+
+template<typename T>
+using SnapshottingArcPtrQsbr = cdrc::atomic_rc_ptr<T, cdrc::qsbr_backend<T>>;
+
+template<typename T>
+using OurRcPtrQsbr = cdrc::rc_ptr<T, cdrc::qsbr_backend<T>>;
+
+// Matches any of our rc_ptr types, regardless of its memory manager
+template<typename T>
+struct is_our_rc_ptr : std::false_type { };
+
+template<typename T, typename memory_manager, typename pointer_policy>
+struct is_our_rc_ptr<cdrc::rc_ptr<T, memory_manager, pointer_policy>> : std::true_type {
+  using counted_object_t = cdrc::internal::counted_object<T, typename memory_manager::object_policy>;
+};
+
 template<typename T>
 using HerlihyRcPtr = herlihy_rc_ptr<T, false>;
 
@@ -88,22 +133,30 @@ struct alignas(32) PaddedInt : orcgc_ptp::orc_base {
   int getInt() { return x; }
 };
 
-template<template<typename> typename SPType>
-SPType<PaddedInt> make_shared_int(int val) {
-  if constexpr (std::is_same<SPType<PaddedInt>, std::shared_ptr<PaddedInt>>::value)
-    return std::make_shared<PaddedInt>(val);                                        // STL shared_ptr
+// An object that spans several cache lines, whose hot field is at the front
+struct alignas(32) LargeInt : orcgc_ptp::orc_base {
+  int x;
+  char payload[248];
+  LargeInt(int x) : x(x) {}
+  int getInt() { return x; }
+};
+
+template<template<typename> typename SPType, typename IntType = PaddedInt>
+SPType<IntType> make_shared_int(int val) {
+  if constexpr (std::is_same<SPType<IntType>, std::shared_ptr<IntType>>::value)
+    return std::make_shared<IntType>(val);                                        // STL shared_ptr
 #ifdef ARC_JUST_THREADS_AVAILABLE
-  else if constexpr (std::is_same<SPType<PaddedInt>, std::experimental::shared_ptr<PaddedInt>>::value)
-    return std::experimental::make_shared<PaddedInt>(val);                          // JustThreads shared_ptr
+  else if constexpr (std::is_same<SPType<IntType>, std::experimental::shared_ptr<IntType>>::value)
+    return std::experimental::make_shared<IntType>(val);                          // JustThreads shared_ptr
 #endif
-  else if constexpr (std::is_same<SPType<PaddedInt>, HerlihyRcPtr<PaddedInt>>::value)
-    return herlihy_rc_ptr<PaddedInt, false>::make_shared(val);                             // Herlihy's algorithm
-  else if constexpr (std::is_same<SPType<PaddedInt>, HerlihyRcPtrOpt<PaddedInt>>::value)
-    return herlihy_rc_ptr<PaddedInt, true>::make_shared(val);                             // Herlihy's algorithm
-  else if constexpr (std::is_same<SPType<PaddedInt>, cdrc::rc_ptr<PaddedInt>>::value)
-    return cdrc::rc_ptr<PaddedInt>::make_shared(val);                                     // Our algorithm
-  else if constexpr (std::is_same<SPType<PaddedInt>, OrcRcPtr<PaddedInt>>::value)   // ORC-GC's "orc_ptr"
-    return orcgc_ptp::make_orc<PaddedInt>(val);
+  else if constexpr (std::is_same<SPType<IntType>, HerlihyRcPtr<IntType>>::value)
+    return herlihy_rc_ptr<IntType, false>::make_shared(val);                             // Herlihy's algorithm
+  else if constexpr (std::is_same<SPType<IntType>, HerlihyRcPtrOpt<IntType>>::value)
+    return herlihy_rc_ptr<IntType, true>::make_shared(val);                             // Herlihy's algorithm
+  else if constexpr (is_our_rc_ptr<SPType<IntType>>::value)
+    return SPType<IntType>::make_shared(val);                                     // Our algorithm
+  else if constexpr (std::is_same<SPType<IntType>, OrcRcPtr<IntType>>::value)   // ORC-GC's "orc_ptr"
+    return orcgc_ptp::make_orc<IntType>(val);
   else // homebrew shared pointer [depricated]
   {
     std::cerr << "invalid SPType" << std::endl;
@@ -124,8 +177,8 @@ SPType<T> make_shared() {
     return HerlihyRcPtr<T>::make_shared();
   else if constexpr (std::is_same<SPType<T>, HerlihyRcPtrOpt<T>>::value)
     return HerlihyRcPtrOpt<T>::make_shared();
-  else if constexpr (std::is_same<SPType<T>, cdrc::rc_ptr<T>>::value)
-    return cdrc::rc_ptr<T>::make_shared();
+  else if constexpr (is_our_rc_ptr<SPType<T>>::value)
+    return SPType<T>::make_shared();
   else if (std::is_same<SPType<PaddedInt>, OrcRcPtr<PaddedInt>>::value)   // ORC-GC's "orc_ptr"
     return orcgc_ptp::make_orc<T>();
   else {
@@ -139,6 +192,48 @@ concept AllocationTrackable = requires(T&& t) {
   t.currently_allocated();
 };
 
+// Under QSBR, a thread may only read while it is online, and objects are only reclaimed
+// once every online thread has announced a quiescent state. These do nothing for the
+// other shared pointer types
+template<template<typename> typename SPType>
+constexpr bool uses_qsbr = std::is_same<SPType<PaddedInt>, OurRcPtrQsbr<PaddedInt>>::value;
+
+template<template<typename> typename SPType>
+void qsbr_online() {
+  if constexpr (uses_qsbr<SPType>) cdrc::online();
+}
+
+template<template<typename> typename SPType>
+void qsbr_offline() {
+  if constexpr (uses_qsbr<SPType>) cdrc::offline();
+}
+
+template<template<typename> typename SPType>
+void qsbr_quiescent_state() {
+  if constexpr (uses_qsbr<SPType>) cdrc::quiescent_state();
+}
+
+// Print the occupancy of the slab pool if the given shared pointer type allocates from it
+template<template<typename> typename SPType>
+void report_pool_occupancy() {
+  if constexpr (std::is_same<SPType<PaddedInt>, OurRcPtrPool<PaddedInt>>::value) {
+    auto stats = cdrc::internal::pool_allocator::get_statistics();
+    std::cout << "\tPool occupancy: " << stats.used_bytes << " / " << stats.reserved_bytes << " bytes ("
+              << 100.0 * stats.occupancy() << "%) in " << stats.used_blocks << " blocks" << std::endl;
+  }
+}
+
+// Print the number of bytes occupied by each object, including its reference counts, and
+// the resulting average amount of allocated memory, if the given shared pointer type is one of ours
+template<template<typename> typename SPType, typename T>
+void report_object_footprint(double avg_allocated) {
+  if constexpr (is_our_rc_ptr<SPType<T>>::value) {
+    using counted_object_t = typename is_our_rc_ptr<SPType<T>>::counted_object_t;
+    std::cout << "\tMemory per node: " << sizeof(counted_object_t) << " bytes for a " << sizeof(T) << " byte object" << std::endl;
+    std::cout << "\tAverage allocated memory: " << avg_allocated * sizeof(counted_object_t) << " bytes" << std::endl;
+  }
+}
+
 // ==================================================================
 //                     Benchmarking framework
 // ==================================================================
@@ -202,6 +297,18 @@ void run_benchmark(std::string alg) {
     run_benchmark_helper<BenchmarkType, herlihy_arc_ptr_opt, HerlihyRcPtrOpt>("Herlihy-Opt");
   else if (alg == "arc")
     run_benchmark_helper<BenchmarkType, SnapshottingArcPtr, OurRcPtr>("ARC");
+  else if (alg == "arc-before")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrBefore, OurRcPtrBefore>("ARC (counters before payload)");
+  else if (alg == "arc-isolated")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrIsolated, OurRcPtrIsolated>("ARC (counters on isolated cache line)");
+  else if (alg == "arc-16")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrCompact, OurRcPtrCompact>("ARC (16-bit counters)");
+  else if (alg == "arc-64")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrWide, OurRcPtrWide>("ARC (64-bit counters)");
+  else if (alg == "arc-pool")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrPool, OurRcPtrPool>("ARC (pool allocator)");
+  else if (alg == "arc-qsbr")
+    run_benchmark_helper<BenchmarkType, SnapshottingArcPtrQsbr, OurRcPtrQsbr>("ARC (QSBR)");
   else if (alg == "orc")
     run_benchmark_helper<BenchmarkType, OrcAtomicRcPtr, OrcRcPtr>("ORC-GC");
   else {
@@ -162,6 +162,10 @@ class alignas(64) atomic_stack {
   static std::ptrdiff_t currently_allocated() requires AllocationTrackable<atomic_sp_t> {
     return atomic_sp_t::currently_allocated();
   }
+
+  static void report_node_footprint(double avg_allocated) {
+    report_object_footprint<SPType, Node>(avg_allocated);
+  }
 };
 
 // Stack specialization for OrcGC, since it unfortunately does not adhere to the C++
@@ -262,6 +266,8 @@ class alignas(64) atomic_stack<T, OrcAtomicRcPtr, OrcRcPtr> {
 
   static std::ptrdiff_t currently_allocated() { return atomic_sp_t::currently_allocated(); }
 
+  static void report_node_footprint(double) { }
+
 };
 
 
@@ -37,6 +37,13 @@ names = {
     'RCHE' : 'RC (HE)',
     'RCIBR' : 'RC (IBR)',
     'RCHyaline' : 'RC (Hyaline)',
+    'RCHPPool' : 'RC (HP, pool)',
+    'RCHPAsym' : 'RC (HP, asymmetric)',
+    'RCHE' : 'RC (HE)',
+    'RCNBR' : 'RC (NBR)',
+    'RCHyalineS' : 'RC (Hyaline-S)',
+    'RCIBRTag' : 'RC (IBR, tagged)',
+    'RCCrystalline' : 'RC (Crystalline)',
 }
 
 colors = {
@@ -55,6 +62,13 @@ colors = {
     'RCUShared' : 'C9',
     'Hyaline' : 'C3',
     'RCHyaline' : 'C1',
+    'RCHPPool' : 'tab:olive',
+    'RCHPAsym' : 'tab:brown',
+    'RCHE' : 'tab:pink',
+    'RCNBR' : 'tab:cyan',
+    'RCHyalineS' : 'tab:gray',
+    'RCIBRTag' : 'C4',
+    'RCCrystalline' : 'tab:green',
 }
 
 markers = {
@@ -73,6 +87,13 @@ markers = {
     'RCUShared' : '<',
     'Hyaline' : 's',
     'RCHyaline' : 'v',
+    'RCHPPool' : 'd',
+    'RCHPAsym' : 'X',
+    'RCHE' : 'P',
+    'RCNBR' : 'h',
+    'RCHyalineS' : '8',
+    'RCIBRTag' : 'p',
+    'RCCrystalline' : 'H',
 }
 
 
@@ -306,7 +327,7 @@ def graph_results_from_file(exp_name, filename_tag):
   print(benchmarks)
   print(memory_managers)
 
-  memory_managers = ['NIL', 'HazardOpt', 'RCU', 'DEBRA', 'Hazard', 'Range_new', 'HE', 'Hyaline', 'RC', 'RCHP', 'RSQ', 'RCUShared', 'RCEBR', 'RCIBR', 'RCHyaline']
+  memory_managers = ['NIL', 'HazardOpt', 'RCU', 'DEBRA', 'Hazard', 'Range_new', 'HE', 'Hyaline', 'RC', 'RCHP', 'RSQ', 'RCUShared', 'RCEBR', 'RCIBR', 'RCHyaline', 'RCHPPool', 'RCHPAsym', 'RCHE', 'RCNBR', 'RCHyalineS', 'RCIBRTag', 'RCCrystalline']
 
   create_graph(exp_name+filename_tag, results, stddev, convert(exp_name), memory_managers, threads, 'throughput', 'throughput', False, False)
   create_graph(exp_name+filename_tag, results, stddev, convert(exp_name), memory_managers, threads, 'memory', 'retired', False, False)
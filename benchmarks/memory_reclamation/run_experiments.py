@@ -5,18 +5,39 @@
 # Rideable 4 : SortedUnorderedMapRCEBR
 # Rideable 5 : SortedUnorderedMapRCIBR
 # Rideable 6 : SortedUnorderedMapRCHyaline
-# Rideable 7 : LinkList
-# Rideable 8 : LinkedListRC
-# Rideable 9 : LinkListRCHP
-# Rideable 10 : LinkListRCEBR
-# Rideable 11 : LinkListRCIBR
-# Rideable 12 : LinkListRCHyaline
-# Rideable 13 : NatarajanTree
-# Rideable 14 : NatarajanTreeRC
-# Rideable 15 : NatarajanTreeRCHP
-# Rideable 16 : NatarajanTreeRCEBR
-# Rideable 17 : NatarajanTreeRCIBR
-# Rideable 18 : NatarajanTreeRCHyaline
+# Rideable 7 : SortedUnorderedMapRCHPPool
+# Rideable 8 : SortedUnorderedMapRCHPAsym
+# Rideable 9 : SortedUnorderedMapRCHE
+# Rideable 10 : SortedUnorderedMapRCNBR
+# Rideable 11 : SortedUnorderedMapRCHyalineS
+# Rideable 12 : SortedUnorderedMapRCIBRTag
+# Rideable 13 : SortedUnorderedMapRCCrystalline
+# Rideable 14 : LinkList
+# Rideable 15 : LinkedListRC
+# Rideable 16 : LinkListRCHP
+# Rideable 17 : LinkListRCEBR
+# Rideable 18 : LinkListRCIBR
+# Rideable 19 : LinkListRCHyaline
+# Rideable 20 : LinkListRCHPPool
+# Rideable 21 : LinkListRCHPAsym
+# Rideable 22 : LinkListRCHE
+# Rideable 23 : LinkListRCNBR
+# Rideable 24 : LinkListRCHyalineS
+# Rideable 25 : LinkListRCIBRTag
+# Rideable 26 : LinkListRCCrystalline
+# Rideable 27 : NatarajanTree
+# Rideable 28 : NatarajanTreeRC
+# Rideable 29 : NatarajanTreeRCHP
+# Rideable 30 : NatarajanTreeRCEBR
+# Rideable 31 : NatarajanTreeRCIBR
+# Rideable 32 : NatarajanTreeRCHyaline
+# Rideable 33 : NatarajanTreeRCHPPool
+# Rideable 34 : NatarajanTreeRCHPAsym
+# Rideable 35 : NatarajanTreeRCHE
+# Rideable 36 : NatarajanTreeRCNBR
+# Rideable 37 : NatarajanTreeRCHyalineS
+# Rideable 38 : NatarajanTreeRCIBRTag
+# Rideable 39 : NatarajanTreeRCCrystalline
 
 # Test Mode 0 : SequentialRemoveTest:prefill=20K
 # Test Mode 1 : ObjRetire:u50:range=200:prefill=100
@@ -46,6 +67,10 @@
 # Test Mode 25 : ObjRetire:u50rq50:range=2M:prefill=1M
 # Test Mode 26 : ObjRetire:u50rq50:range=20M:prefill=10M
 # Test Mode 27 : ObjRetire:u50rq50:range=200M:prefill=100M
+# Test Mode 28 : Stall:u50:range=2000:prefill=1000
+# Test Mode 29 : NoStall:u50:range=2000:prefill=1000
+# Test Mode 30 : Stall:u50:range=200K:prefill=100K
+# Test Mode 31 : NoStall:u50:range=200K:prefill=100K
 
 
 
@@ -60,11 +85,11 @@ import create_graphs as graph
 datastructures = ['hashtable', 'list', 'bst']
 
 smr_datastructure = {'hashtable': 1,
-                     'list': 7,
-                     'bst': 13}
-rc_datastructures = {'hashtable' : [3, 4, 5, 6],
-                     'list' : [9,10,11,12],
-                     'bst' : [15,16,17,18],}
+                     'list': 14,
+                     'bst': 27}
+rc_datastructures = {'hashtable' : [3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13],
+                     'list' : [16,17,18,19,20,21,22,23,24,25,26],
+                     'bst' : [29,30,31,32,33,34,35,36,37,38,39],}
 wl_num =          {
                    '100-50':1,
                    '1000-50':2,
@@ -26,6 +26,9 @@ limitations under the License.
 #include <set>
 #include <iterator>
 #include <climits>
+#include <algorithm>
+#include <random>
+#include <sstream>
 
 using namespace std;
 
@@ -63,6 +66,81 @@ int SequentialRemoveTest::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc) {
 	return ops;
 }
 
+void StallTest::init(GlobalTestConfig* gtc) {
+	if(gtc->checkEnv("range")){
+		range = atoi((gtc->getEnv("range")).c_str());
+	}
+	if(gtc->checkEnv("prefill")){
+		prefill = atoi((gtc->getEnv("prefill")).c_str());
+	} else {
+		std::stringstream ss;
+		ss << prefill;
+		gtc->setEnv("prefill", ss.str());
+	}
+
+	Rideable* ptr = gtc->allocRideable();
+	this->m = dynamic_cast<RUnorderedMap<int,int>*>(ptr);
+	if (!m) {
+		 errexit("StallTest must be run on RUnorderedMap<int,int> type object.");
+	}
+	if (stall && !m->stall_read(0, [](){ return true; }, 0)) {
+		 errexit("StallTest must be run on a map that supports stalling reads.");
+	}
+	if (stall && gtc->actual_task_num < 2) {
+		 errexit("StallTest needs at least one thread in addition to the stalled one.");
+	}
+
+	int i = 0;
+	std::mt19937_64 gen(1);
+	while(i < prefill) {
+		int k = gen()%range;
+		if(m->insert(k,k,0))
+			i++;
+	}
+	printf("Prefilled %d\n",i);
+}
+
+int StallTest::execute(GlobalTestConfig* gtc, LocalTestConfig* ltc) {
+	struct timeval time_up = gtc->finish;
+	struct timeval now;
+	gettimeofday(&now,NULL);
+	int ops = 0;
+	std::mt19937_64 gen_k(ltc->seed);
+	std::mt19937_64 gen_p(ltc->seed+1);
+	int tid = ltc->tid;
+
+	if(tid == gtc->actual_task_num) { // dedicate thread to sampling the allocated nodes
+		int64_t peak_allocs = 0;
+		while(timeDiff(&now,&time_up)>0){
+			usleep(50);
+			peak_allocs = std::max(peak_allocs, m->get_allocated());
+			gettimeofday(&now,NULL);
+		}
+		std::stringstream ss;
+		ss << "Peak allocated nodes: " << peak_allocs << std::endl;
+		std::cout << ss.str();
+	} else if(stall && tid == 0) { // stall inside of a read until the time is up
+		m->stall_read(gen_k()%range, [&](){
+			gettimeofday(&now,NULL);
+			return timeDiff(&now,&time_up) <= 0;
+		}, tid);
+	} else {
+		while(timeDiff(&now,&time_up)>0){
+			int k = gen_k()%range;
+			int p = gen_p()%100;
+			if(p<50)
+				m->get(k,tid);
+			else if(p<75)
+				m->insert(k,k,tid);
+			else
+				m->remove(k,tid);
+			ops++;
+			gettimeofday(&now,NULL);
+		}
+	}
+	return ops;
+}
+
 void DebugTest::init(GlobalTestConfig* gtc){
 	Rideable* ptr = gtc->allocRideable();
 	this->m = dynamic_cast<RUnorderedMap<string, string>*>(ptr);
@@ -389,6 +389,25 @@ int ObjRetireTest<T>::ObjRetireTest::execute(GlobalTestConfig* gtc, LocalTestCon
 }
 
 
+// Measures how much memory a thread that stalls in the middle of a read holds
+// back. One thread starts a read and stalls inside of it for the whole run,
+// while the others perform gets, inserts, and removes, and a dedicated thread
+// samples the number of allocated nodes and reports the peak. Without the
+// stalled thread, this gives the baseline of each rideable.
+class StallTest : public Test{
+public:
+	RUnorderedMap<int,int>* m;
+	int range;
+	int prefill;
+	bool stall;
+
+	StallTest(int range, int prefill, bool stall) : range(range), prefill(prefill), stall(stall) {}
+	void init(GlobalTestConfig* gtc);
+	void parInit(GlobalTestConfig* gtc, LocalTestConfig* ltc){}
+	int execute(GlobalTestConfig* gtc, LocalTestConfig* ltc);
+	void cleanup(GlobalTestConfig* gtc){ delete m; }
+};
+
 // by Hs: test framework used for debugging, modifiy it as needed.
 class DebugTest : public Test{
 public:
@@ -20,6 +20,7 @@ limitations under the License.
 #ifndef RUNORDEREDMAP_HPP
 #define RUNORDEREDMAP_HPP
 
+#include <functional>
 #include <string>
 #include "Rideable.hpp"
 
@@ -54,6 +55,11 @@ public:
 	virtual uint64_t size()=0;
 
 	virtual int64_t get_allocated() = 0;
+
+	// Starts a read of the key as get does, and stalls in the middle of it,
+	// while still protecting what it has read, until done() returns true
+	// returns : false if the map does not support stalling a read
+	virtual bool stall_read(K, const std::function<bool()>&, int) { return false; }
 };
 
 #endif
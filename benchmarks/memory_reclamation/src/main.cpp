@@ -38,18 +38,38 @@ limitations under the License.
 #include <cdrc/internal/smr/acquire_retire.h>
 #include <cdrc/internal/smr/acquire_retire_ibr.h>
 #include <cdrc/internal/smr/acquire_retire_ebr.h>
+#include <cdrc/internal/smr/acquire_retire_he.h>
 #include <cdrc/internal/smr/acquire_retire_hyaline.h>
+#include <cdrc/internal/smr/acquire_retire_hyaline_s.h>
+#include <cdrc/internal/smr/acquire_retire_crystalline.h>
+#include <cdrc/internal/smr/acquire_retire_nbr.h>
 
 using namespace std;
 
 GlobalTestConfig* gtc;
 
+template<typename T>
+using acquire_retire_pool = cdrc::internal::acquire_retire<T, 7, 2, cdrc::pool_object_policy>;
+
+template<typename T>
+using acquire_retire_asym = cdrc::internal::acquire_retire<T, 7, 2, cdrc::default_object_policy, cdrc::internal::asymmetric_fence_policy>;
+
+template<typename T>
+using acquire_retire_ibr_tagged = cdrc::internal::acquire_retire_ibr<T, 40, 2, cdrc::default_object_policy, cdrc::internal::ibr_tagged_policy>;
+
 template<template<class, class, template<typename> typename, typename> typename FactoryType>
 void addRideableOptions(GlobalTestConfig* testConfig, const std::string ds_name) {
 	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire,cdrc::empty_guard>, (ds_name + "RCHP").c_str());
 	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_ebr,cdrc::epoch_guard>, (ds_name + "RCEBR").c_str());
 	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_ibr,cdrc::epoch_guard>, (ds_name + "RCIBR").c_str());
 	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_hyaline, cdrc::hyaline_guard>, (ds_name + "RCHyaline").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,acquire_retire_pool,cdrc::empty_guard>, (ds_name + "RCHPPool").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,acquire_retire_asym,cdrc::empty_guard>, (ds_name + "RCHPAsym").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_he,cdrc::empty_guard>, (ds_name + "RCHE").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_nbr,cdrc::empty_guard>, (ds_name + "RCNBR").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_hyaline_s,cdrc::hyaline_guard>, (ds_name + "RCHyalineS").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,acquire_retire_ibr_tagged,cdrc::epoch_guard>, (ds_name + "RCIBRTag").c_str());
+	testConfig->addRideableOption(new FactoryType<int,int,cdrc::internal::acquire_retire_crystalline,cdrc::crystalline_guard>, (ds_name + "RCCrystalline").c_str());
 }
 
 // the main function
@@ -107,6 +127,11 @@ int main(int argc, char *argv[])
 	gtc->addTestOption(new ObjRetireTest<int>(0,50,0,50,20000000,10000000), "ObjRetire:u50rq50:range=20M:prefill=10M");
 	gtc->addTestOption(new ObjRetireTest<int>(0,50,0,50,200000000,100000000), "ObjRetire:u50rq50:range=200M:prefill=100M");
 
+	gtc->addTestOption(new StallTest(2000,1000,true), "Stall:u50:range=2000:prefill=1000");
+	gtc->addTestOption(new StallTest(2000,1000,false), "NoStall:u50:range=2000:prefill=1000");
+	gtc->addTestOption(new StallTest(200000,100000,true), "Stall:u50:range=200K:prefill=100K");
+	gtc->addTestOption(new StallTest(200000,100000,false), "NoStall:u50:range=200K:prefill=100K");
+
 	// parse command line
 	gtc->parseCommandLine(argc,argv);
 
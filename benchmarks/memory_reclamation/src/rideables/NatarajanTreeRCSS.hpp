@@ -60,7 +60,8 @@ class NatarajanTreeRCSS : public ROrderedMap<K,V>, public RetiredMonitorable{
 
  private:
   /* structs*/
-  struct Node{
+  // Nodes hold their own reference counts so that they share a cache line with the key and children
+  struct Node : public cdrc::rc_base {
     int level;
     K key;
     V val;
@@ -147,8 +148,16 @@ class NatarajanTreeRCSS : public ROrderedMap<K,V>, public RetiredMonitorable{
 
   /* private interfaces */
   void seek(K key, int tid);
-  void seekLeaf(K key, int tid);
+  void seekLeaf(K key, marked_snapshot_ptr& leaf);
   bool cleanup(K key, int tid);
+
+  // Run f as a read phase if the backend is NBR, so that its reads skip their
+  // fences, and as is otherwise. The snapshots taken by f must not outlive it
+  template<typename F>
+  static auto read_phase(F&& f) {
+    if constexpr (cdrc::internal::is_nbr_backend<memory_manager<Node>>) return cdrc::with_nbr_read_phase(std::forward<F>(f));
+    else return f();
+  }
   void doRangeQuery(Node& k1, Node& k2, int tid, marked_snapshot_ptr root, std::map<K,V>& res);
 
   void reportAlloc(int) {
@@ -233,6 +242,7 @@ class NatarajanTreeRCSS : public ROrderedMap<K,V>, public RetiredMonitorable{
   optional<V> remove(K key, int tid);
   optional<V> replace(K key, V val, int tid);
   std::map<K, V> rangeQuery(K key1, K key2, int& len, int tid);
+  bool stall_read(K key, const std::function<bool()>& done, int tid);
 };
 
 template <class K, class V, template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
@@ -245,29 +255,28 @@ class NatarajanTreeRCSSFactory : public RideableFactory{
 
 //-------Definition----------
 template <class K, class V, template<typename> typename memory_manager, typename guard_t>
-void NatarajanTreeRCSS<K,V,memory_manager,guard_t>::seekLeaf(K key, int tid){
+void NatarajanTreeRCSS<K,V,memory_manager,guard_t>::seekLeaf(K key, marked_snapshot_ptr& leaf){
   // seek_count++;
-  /* initialize the seek record using sentinel nodes */
+  /* initialize the leaf using sentinel nodes */
   Node keyNode{key,defltV,nullptr,nullptr};//node to be compared
-  SeekRecord* seekRecord=&(records[tid].ui);
-  seekRecord->leaf=s.get_snapshot()->left.get_snapshot();
-  seekRecord->leaf.set_mark(0);
+  leaf=s.get_snapshot()->left.get_snapshot();
+  leaf.set_mark(0);
 
-  assert(seekRecord->leaf);
-  marked_snapshot_ptr current = seekRecord->leaf->left.get_snapshot();
+  assert(leaf);
+  marked_snapshot_ptr current = leaf->left.get_snapshot();
   current.set_mark(0);
 
   /* traverse the tree */
   while(current){
-    /* advance parent and leaf pointers */
-    seekRecord->leaf=std::move(current);
+    /* advance leaf pointer */
+    leaf=std::move(current);
 
     /* update other variables used in traversal */
-    if(nodeLess(&keyNode,seekRecord->leaf.get())){
-      current=seekRecord->leaf->left.get_snapshot();
+    if(nodeLess(&keyNode,leaf.get())){
+      current=leaf->left.get_snapshot();
     }
     else{
-      current=seekRecord->leaf->right.get_snapshot();
+      current=leaf->right.get_snapshot();
     }
     current.set_mark(0);
   }
@@ -420,15 +429,30 @@ optional<V> NatarajanTreeRCSS<K,V,memory_manager,guard_t>::get(K key, int tid){
 
   reportAlloc(tid);
   Node keyNode{key,defltV,nullptr,nullptr};//node to be compared
-  optional<V> res={};
-  SeekRecord* seekRecord=&(records[tid].ui);
-  seekLeaf(key,tid);
-  marked_snapshot_ptr& leaf = seekRecord->leaf;
-  if(nodeEqual(&keyNode,leaf.get())){
-    res = leaf->val;
-  }
-  seekRecord->leaf.clear();
-  return res;
+  // The leaf is kept locally rather than in the seek record, since the
+  // snapshots of a read phase must not outlive it
+  return read_phase([&]() {
+    optional<V> res={};
+    marked_snapshot_ptr leaf;
+    seekLeaf(key,leaf);
+    if(nodeEqual(&keyNode,leaf.get())){
+      res = leaf->val;
+    }
+    return res;
+  });
+}
+
+// Like get, but stalls after finding the leaf until done() returns true
+template <class K, class V, template<typename> typename memory_manager, typename guard_t>
+bool NatarajanTreeRCSS<K,V,memory_manager,guard_t>::stall_read(K key, const std::function<bool()>& done, int){
+  [[maybe_unused]] guard_t guard;
+
+  return read_phase([&]() {
+    marked_snapshot_ptr leaf;
+    seekLeaf(key,leaf);
+    while(!done()) usleep(50);
+    return true;
+  });
 }
 
 template <class K, class V, template<typename> typename memory_manager, typename guard_t>
@@ -31,6 +31,7 @@ limitations under the License.
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <unistd.h>
 
 #include <cdrc/marked_arc_ptr.h>
 #include <cdrc/internal/utils.h>
@@ -49,7 +50,8 @@ class SortedUnorderedMapRCSS : public RUnorderedMap<K,V>, public RetiredMonitora
   using marked_rc_ptr = cdrc::marked_rc_ptr<Node, memory_manager<Node>>;
   using marked_snapshot_ptr = cdrc::marked_snapshot_ptr<Node, memory_manager<Node>>;
 
-  struct Node{
+  // Nodes hold their own reference counts so that they share a cache line with key and next
+  struct Node : public cdrc::rc_base {
     K key;
     V val;
     marked_arc_ptr next;
@@ -64,6 +66,14 @@ private:
   padded<marked_arc_ptr>* bucket=new padded<marked_arc_ptr>[idxSize]{};
   bool findNode(marked_snapshot_ptr &prev, marked_snapshot_ptr &cur, marked_snapshot_ptr &nxt, K key, int tid);
 
+  // Run f as a read phase if the backend is NBR, so that its reads skip their
+  // fences, and as is otherwise. The snapshots taken by f must not outlive it
+  template<typename F>
+  static auto read_phase(F&& f) {
+    if constexpr (cdrc::internal::is_nbr_backend<memory_manager<Node>>) return cdrc::with_nbr_read_phase(std::forward<F>(f));
+    else return f();
+  }
+
   void reportAlloc([[maybe_unused]] int tid) {
     // counter[tid].ui++;
     // if(counter[tid].ui == 4000) {
@@ -124,11 +134,16 @@ public:
     return node->key + keySumHelper(node->next.load());
   }
 
+  // Points at the value inside of a node, sharing ownership of the node
+  using value_ptr = cdrc::marked_rc_ptr<V, memory_manager<Node>>;
+
   optional<V> get(K key, int tid);
+  value_ptr get_value_ptr(K key, int tid);
   optional<V> put(K key, V val, int tid);
   bool insert(K key, V val, int tid);
   optional<V> remove(K key, int tid);
   optional<V> replace(K key, V val, int tid);
+  bool stall_read(K key, const std::function<bool()>& done, int tid);
 };
 
 template <class K, class V, template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
@@ -150,17 +165,49 @@ class SortedUnorderedMapRCSSTestFactory : public RideableFactory{
 //-------Definition----------
 template <class K, class V, template<typename> typename memory_manager, typename guard_t> 
 optional<V> SortedUnorderedMapRCSS<K,V,memory_manager,guard_t>::get(K key, int tid) {
+  [[maybe_unused]] guard_t guard;
+  reportAlloc(tid);
+  return read_phase([&]() {
+    marked_snapshot_ptr prev;
+    marked_snapshot_ptr cur;
+    marked_snapshot_ptr nxt;
+    optional<V> res={};
+
+    if(findNode(prev,cur,nxt,key,tid)){
+      res=cur->val;
+    }
+    return res;
+  });
+}
+
+// Like get, but stalls after finding the node until done() returns true
+template <class K, class V, template<typename> typename memory_manager, typename guard_t> 
+bool SortedUnorderedMapRCSS<K,V,memory_manager,guard_t>::stall_read(K key, const std::function<bool()>& done, int tid) {
+  [[maybe_unused]] guard_t guard;
+  return read_phase([&]() {
+    marked_snapshot_ptr prev;
+    marked_snapshot_ptr cur;
+    marked_snapshot_ptr nxt;
+
+    findNode(prev,cur,nxt,key,tid);
+    while(!done()) usleep(50);
+    return true;
+  });
+}
+
+// Like get, but returns a reference-counted pointer to the value in place instead of a copy
+template <class K, class V, template<typename> typename memory_manager, typename guard_t> 
+typename SortedUnorderedMapRCSS<K,V,memory_manager,guard_t>::value_ptr SortedUnorderedMapRCSS<K,V,memory_manager,guard_t>::get_value_ptr(K key, int tid) {
   [[maybe_unused]] guard_t guard;
   reportAlloc(tid);
   marked_snapshot_ptr prev;
   marked_snapshot_ptr cur;
   marked_snapshot_ptr nxt;
-  optional<V> res={};
 
   if(findNode(prev,cur,nxt,key,tid)){
-    res=cur->val;
+    return value_ptr(marked_rc_ptr(cur), &cur->val);
   }
-  return res;
+  return nullptr;
 }
 
 template <class K, class V, template<typename> typename memory_manager, typename guard_t> 
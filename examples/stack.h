@@ -32,27 +32,6 @@ class alignas(64) atomic_stack {
  public:
   atomic_stack() = default;
 
-  // Avoid exploding the call stack when destructing
-  ~atomic_stack() {
-    // Note: We need to go through and unlink the nodes in the stack
-    // because of deferred reclamation. The "standard" algorithm of
-    // just popping each node off might not prevent a stack overflow
-    // because the destruction might be deferred, and hence there
-    // might still be a long chain that gets recursively destroyed,
-    // which will blow the call stack if the stack is large.
-    auto node = head.load();
-    if (node) {
-      head.store(nullptr);
-      auto next = node->next;
-      node->next = nullptr;
-      while (next) {
-        node = next;
-        next = node->next;
-        node->next = nullptr;
-      }
-    }
-  }
-
   bool find(T t) {
     // Holding a snapshot protects the entire list from
     // destruction while we are reading it. The alternative
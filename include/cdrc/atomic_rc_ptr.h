@@ -5,6 +5,7 @@
 #include <cstddef>
 
 #include <atomic>
+#include <type_traits>
 
 #include "internal/counted_object.h"
 #include "internal/fwd_decl.h"
@@ -27,7 +28,10 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
   // to the corresponding pointer types. See marked_arc_ptr.h for an example.
 
  private:
-  using counted_object_t = internal::counted_object<T>;
+  static_assert(std::is_same_v<T, typename memory_manager::managed_type>,
+    "Aliasing pointers can not be stored in an atomic_rc_ptr");
+
+  using counted_object_t = internal::counted_object<T, typename memory_manager::object_policy>;
   using counted_ptr_t = typename pointer_policy::template pointer_type<counted_object_t>;
 
   using rc_ptr_t = rc_ptr<T, memory_manager, pointer_policy>;
@@ -69,17 +73,20 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
   static constexpr bool is_always_lock_free = true;
 
   void store(std::nullptr_t) noexcept {
+    mm.before_update();
     auto old_ptr = atomic_ptr.exchange(nullptr, std::memory_order_seq_cst);
     if (old_ptr != nullptr) mm.delayed_decrement_ref_cnt(old_ptr);
   }
 
   void store(rc_ptr_t desired, std::memory_order order = std::memory_order_seq_cst) noexcept {
+    mm.before_update();
     auto new_ptr = desired.release();
     auto old_ptr = atomic_ptr.exchange(new_ptr, order);
     if (old_ptr != nullptr) mm.delayed_decrement_ref_cnt(old_ptr);
   }
 
   void store_non_racy(rc_ptr_t desired) noexcept {
+    mm.before_update();
     auto new_ptr = desired.release();
     auto old_ptr = atomic_ptr.load();
     atomic_ptr.store(new_ptr, std::memory_order_release);
@@ -87,6 +94,7 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
   }
 
   void store(const snapshot_ptr_t &desired, std::memory_order order = std::memory_order_seq_cst) noexcept {
+    mm.before_update();
     auto new_ptr = desired.get_counted();
 
     // If desired is protected, a small optimization opportunity is to not
@@ -177,6 +185,7 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
   // while this operation is taking place, since desired is a
   // non-atomic shared pointer!
   void swap(rc_ptr_t &desired) noexcept {
+    mm.before_update();
     auto desired_ptr = desired.release();
     auto current_ptr = atomic_ptr.load();
     desired = rc_ptr_t(current_ptr, rc_ptr_t::AddRef::no);
@@ -184,6 +193,7 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
   }
 
   rc_ptr_t exchange(rc_ptr_t desired) noexcept {
+    mm.before_update();
     auto new_ptr = desired.release();
     auto old_ptr = atomic_ptr.exchange(new_ptr, std::memory_order_seq_cst);
     return rc_ptr_t(old_ptr, rc_ptr_t::AddRef::no);
@@ -207,6 +217,7 @@ class atomic_rc_ptr : public pointer_policy::template arc_ptr_policy<T> {
  protected:
 
   bool compare_and_swap_impl(counted_ptr_t expected_ptr, counted_ptr_t desired_ptr) noexcept {
+    mm.before_update();
     if (atomic_ptr.compare_exchange_strong(expected_ptr, desired_ptr, std::memory_order_seq_cst)) {
       if (expected_ptr != nullptr) {
         mm.delayed_decrement_ref_cnt(expected_ptr);
@@ -29,7 +29,7 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
   // to the corresponding pointer types. See marked_arc_ptr.h for an example.
 
  private:
-  using counted_object_t = internal::counted_object<T>;
+  using counted_object_t = internal::counted_object<T, typename memory_manager::object_policy>;
   using counted_ptr_t = typename pointer_policy::template pointer_type<counted_object_t>;
 
   using atomic_ptr_t = atomic_rc_ptr<T, memory_manager, pointer_policy>;
@@ -52,6 +52,8 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
   /* implicit */ atomic_weak_ptr(weak_ptr_t desired) : atomic_ptr(desired.release()) {}
 
   ~atomic_weak_ptr() {
+    static_assert(memory_manager::object_policy::weak_references,
+      "Weak pointers require an object policy that permits weak references");
     auto ptr = atomic_ptr.load();
     if (ptr != nullptr) mm.delayed_decrement_weak_cnt(ptr);
   }
@@ -69,17 +71,20 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
   static constexpr bool is_always_lock_free = true;
 
   void store(std::nullptr_t) noexcept {
+    mm.before_update();
     auto old_ptr = atomic_ptr.exchange(nullptr, std::memory_order_seq_cst);
     if (old_ptr != nullptr) mm.delayed_decrement_weak_cnt(old_ptr);
   }
 
   void store(weak_ptr_t desired, std::memory_order order = std::memory_order_seq_cst) noexcept {
+    mm.before_update();
     auto new_ptr = desired.release();
     auto old_ptr = atomic_ptr.exchange(new_ptr, order);
     if (old_ptr != nullptr) mm.delayed_decrement_weak_cnt(old_ptr);
   }
 
   void store_non_racy(weak_ptr_t desired) noexcept {
+    mm.before_update();
     auto new_ptr = desired.release();
     auto old_ptr = atomic_ptr.load();
     atomic_ptr.store(new_ptr, std::memory_order_release);
@@ -87,6 +92,7 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
   }
 
   void store(const weak_snapshot_ptr_t &desired, std::memory_order order = std::memory_order_seq_cst) noexcept {
+    mm.before_update();
     auto new_ptr = desired.get_counted();
     if (new_ptr != nullptr) mm.increment_weak_cnt(new_ptr);
     auto old_ptr = atomic_ptr.exchange(new_ptr, order);
@@ -94,6 +100,7 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
   }
 
   void store(const snapshot_ptr_t &desired, std::memory_order order = std::memory_order_seq_cst) noexcept {
+    mm.before_update();
     auto new_ptr = desired.get_counted();
     if (new_ptr != nullptr) mm.increment_weak_cnt(new_ptr);
     auto old_ptr = atomic_ptr.exchange(new_ptr, order);
@@ -169,6 +176,7 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
   }
 
   weak_ptr_t exchange(weak_ptr_t desired) noexcept {
+    mm.before_update();
     auto new_ptr = desired.release();
     auto old_ptr = atomic_ptr.exchange(new_ptr, std::memory_order_seq_cst);
     return weak_ptr_t(old_ptr, weak_ptr_t::AddRef::no);
@@ -188,6 +196,7 @@ class atomic_weak_ptr : public pointer_policy::template arc_ptr_policy<T> {
  protected:
 
   bool compare_and_swap_impl(counted_ptr_t expected_ptr, counted_ptr_t desired_ptr) noexcept {
+    mm.before_update();
     if (atomic_ptr.compare_exchange_strong(expected_ptr, desired_ptr, std::memory_order_seq_cst)) {
       if (expected_ptr != nullptr) {
         mm.delayed_decrement_weak_cnt(expected_ptr);
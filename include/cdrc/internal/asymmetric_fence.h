@@ -0,0 +1,107 @@
+
+#ifndef CDRC_INTERNAL_ASYMMETRIC_FENCE_H
+#define CDRC_INTERNAL_ASYMMETRIC_FENCE_H
+
+#include <cassert>
+
+#include <atomic>
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cdrc {
+namespace internal {
+
+// Asymmetric memory fences.
+//
+// Some protocols pair a frequent operation with a rare one, each of which needs
+// a full fence between a store and a subsequent load, such as the announcement
+// of a hazard pointer, which happens on every read, and the scan of the
+// announcements, which happens once per batch of deferred ejects. On Linux,
+// the membarrier system call executes a full memory barrier on every running
+// thread of the process, so the rare side can pay for both fences with a heavy
+// fence, and the light fence on the frequent side only needs to prevent the
+// compiler from reordering. If the system call is unavailable, both fences are
+// ordinary full fences, which is always correct.
+//
+// Once a light fence has skipped the full fence, every later heavy fence must
+// use membarrier, so a heavy fence whose membarrier fails can not fall back.
+
+// Set once membarrier has been registered for the process, after which every
+// heavy fence uses it. Until then, light fences are full fences.
+inline std::atomic<bool> membarrier_registered{false};
+
+// Whether heavy fences use membarrier. Registers the process on the first call
+inline bool asymmetric_fences_available() {
+  static const bool available = []() {
+#if defined(__linux__) && defined(SYS_membarrier)
+    auto supported = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0);
+    if (supported < 0 || (supported & MEMBARRIER_CMD_PRIVATE_EXPEDITED) == 0) return false;
+    if (syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0) != 0) return false;
+    membarrier_registered.store(true, std::memory_order_release);
+    return true;
+#else
+    return false;
+#endif
+  }();
+  return available;
+}
+
+// A light fence only relies on the heavy fences once membarrier is registered,
+// which it checks with a cheap load, so that the fast path does not need to go
+// through the initialization of asymmetric_fences_available
+inline void asymmetric_light_fence() {
+  if (membarrier_registered.load(std::memory_order_relaxed)) [[likely]] std::atomic_signal_fence(std::memory_order_seq_cst);
+  else std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+inline void asymmetric_heavy_fence() {
+#if defined(__linux__) && defined(SYS_membarrier)
+  if (asymmetric_fences_available()) [[likely]] {
+    [[maybe_unused]] auto result = syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0);
+    assert(result == 0);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    return;
+  }
+#endif
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+// How the hazard-pointer backend orders the announcement of a handle before the
+// load that validates it, against the scans of the announcements that follow
+// the unlinking of a handle.
+//
+// The default uses a sequentially consistent store for every announcement.
+struct symmetric_fence_policy {
+  template<typename U>
+  static void announce(std::atomic<U>& slot, U value) {
+    slot.store(value, std::memory_order_seq_cst);
+  }
+
+  static void before_scan() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+};
+
+// Makes announcements plain stores followed by a light fence, and issues a heavy
+// fence before each scan instead. This speeds up reads at the expense of a
+// system call per scan.
+struct asymmetric_fence_policy {
+  template<typename U>
+  static void announce(std::atomic<U>& slot, U value) {
+    slot.store(value, std::memory_order_relaxed);
+    asymmetric_light_fence();
+  }
+
+  static void before_scan() {
+    asymmetric_heavy_fence();
+  }
+};
+
+}  // namespace internal
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_ASYMMETRIC_FENCE_H
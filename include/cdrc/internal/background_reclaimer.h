@@ -0,0 +1,128 @@
+
+#ifndef CDRC_INTERNAL_BACKGROUND_RECLAIMER_H
+#define CDRC_INTERNAL_BACKGROUND_RECLAIMER_H
+
+#include <cassert>
+#include <cstddef>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cdrc {
+namespace internal {
+
+// A set of dedicated threads that perform the deferred ejects of a memory
+// manager on behalf of the application threads.
+//
+// Rather than scanning the announcements and applying the safe ejects
+// themselves, application threads hand their batches of deferred ejects
+// to the reclaimer with submit. The queue of submitted batches is bounded,
+// and submit fails when it is full, in which case the application thread
+// falls back to processing its batch inline. This keeps the amount of
+// unreclaimed memory bounded even when the reclaimer falls behind.
+//
+// Each reclaimer thread keeps the ejects that it could not perform yet,
+// and retries them along with its next batch, or after a short wait if
+// no new batch arrives.
+//
+// Owner is the memory manager, which must provide a member function
+//
+//   void reclaim_in_background(Batch& batch)
+//
+// that performs every eject in the batch that is safe, and leaves the
+// others, plus any ejects that were deferred by the calling thread while
+// doing so, in the batch. Batch is a vector-like container.
+//
+// Reclaimer threads register thread IDs like any other thread.
+template<typename Owner, typename Batch>
+class background_reclaimer {
+
+ public:
+  constexpr static auto retry_interval = std::chrono::microseconds(200);
+
+  background_reclaimer(Owner& owner_, std::size_t num_workers, std::size_t capacity_) :
+      owner(owner_), capacity(capacity_) {
+    assert(num_workers > 0 && capacity > 0);
+    for (std::size_t i = 0; i < num_workers; i++) {
+      workers.emplace_back([this]() { run(); });
+    }
+  }
+
+  background_reclaimer(const background_reclaimer&) = delete;
+  background_reclaimer& operator=(const background_reclaimer&) = delete;
+
+  ~background_reclaimer() {
+    assert(workers.empty());
+  }
+
+  // Hand over a batch of deferred ejects to the reclaimer. Returns false, leaving
+  // the batch intact, if the queue is full, in which case the caller should
+  // process the batch itself.
+  bool submit(Batch& batch) {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (queue.size() >= capacity) return false;
+      queue.push_back(std::move(batch));
+    }
+    batch.clear();
+    wake.notify_one();
+    return true;
+  }
+
+  // Stop the reclaimer threads, and return every eject that they had not yet performed
+  Batch stop() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+    for (auto& batch : queue) {
+      leftovers.insert(leftovers.end(), batch.begin(), batch.end());
+    }
+    queue.clear();
+    return std::move(leftovers);
+  }
+
+ private:
+  void run() {
+    Batch pending;
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+      if (queue.empty()) {
+        if (stopping) break;
+        if (pending.empty()) wake.wait(guard, [this]() { return stopping || !queue.empty(); });
+        else wake.wait_for(guard, retry_interval, [this]() { return stopping || !queue.empty(); });
+      }
+      if (!queue.empty()) {
+        auto& batch = queue.front();
+        pending.insert(pending.end(), batch.begin(), batch.end());
+        queue.pop_front();
+      }
+      guard.unlock();
+      if (!pending.empty()) owner.reclaim_in_background(pending);
+      guard.lock();
+    }
+    leftovers.insert(leftovers.end(), pending.begin(), pending.end());
+  }
+
+  Owner& owner;
+  const std::size_t capacity;                   // Maximum number of batches waiting in the queue
+  std::mutex lock;
+  std::condition_variable wake;
+  std::deque<Batch> queue;                      // Batches that have been submitted but not yet picked up
+  Batch leftovers;                              // Ejects that had not been performed when the reclaimer stopped
+  bool stopping{false};
+  std::vector<std::thread> workers;
+};
+
+}  // namespace internal
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_BACKGROUND_RECLAIMER_H
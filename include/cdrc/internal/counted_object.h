@@ -4,24 +4,232 @@
 
 
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
 
 #include <atomic>
+#include <memory>
 #include <new>
 #include <type_traits>
 #include <utility>
 
+#include "object_policy.h"
 #include "utils.h"
 
 namespace cdrc {
+
 namespace internal {
 
-// An instance of an object of type T with an atomic reference count.
-template<typename T>
-struct counted_object {
+template<typename T, typename object_policy>
+struct counted_storage;
+
+// Placeholder for a field that is not required by the object policy
+struct empty_field {};
+
+// The reference counts of an object that does not hold its own
+template<typename counter_type, bool weak_references>
+struct reference_counts {
+  utils::StickyCounter<counter_type> ref_cnt{1};
+  utils::StickyCounter<counter_type> weak_cnt{1};
+};
+
+// Objects that can not be weakly referenced only need a strong count
+template<typename counter_type>
+struct reference_counts<counter_type, false> {
+  utils::StickyCounter<counter_type> ref_cnt{1};
+};
+
+}  // namespace internal
+
+// Base class for objects that hold their own reference counts. Objects of a
+// type that derives from rc_base are managed intrusively, i.e., the reference
+// counts are stored inside the object, rather than in a wrapper around it.
+// This allows the counts to be placed next to the fields that are accessed
+// alongside them, e.g., at the front of a node, rather than after the end of
+// the object.
+//
+// The counts are 32 bits wide, so the object policy of the memory manager
+// must use uint32_t counters. Room for a weak count is always reserved, but
+// weak references are only permitted if the object policy enables them.
+//
+// The counts are not members of rc_base, but objects in their own right that
+// occupy storage provided by it, so they remain valid after the object is
+// destroyed until its storage is reclaimed, which may be delayed by weak
+// references. Copying or assigning an object does not copy its counts.
+class rc_base {
+ protected:
+  rc_base() noexcept { new (&counts_storage) counts_t; }
+  rc_base(const rc_base&) noexcept : rc_base() {}
+  rc_base& operator=(const rc_base&) noexcept { return *this; }
+  ~rc_base() = default;
+
+ private:
+  template<typename, typename>
+  friend struct internal::counted_storage;
+
+  using counter_type = uint32_t;
+  using counts_t = internal::reference_counts<counter_type, true>;
+  static_assert(std::is_trivially_destructible_v<counts_t>);
+
+  counts_t* counts() noexcept { return std::launder(reinterpret_cast<counts_t*>(&counts_storage)); }
+
+  alignas(counts_t) unsigned char counts_storage[sizeof(counts_t)];
+};
+
+namespace internal {
+
+// Arrangement of the storage for an object of type T and its reference counts
+template<typename T, typename counts_t, counter_layout layout>
+struct storage_layout;
+
+template<typename T, typename counts_t>
+struct storage_layout<T, counts_t, counter_layout::packed> {
+  alignas(alignof(T)) unsigned char payload[sizeof(T)];
+  counts_t counts;
+};
+
+template<typename T, typename counts_t>
+struct storage_layout<T, counts_t, counter_layout::before_payload> {
+  counts_t counts;
+  alignas(alignof(T)) unsigned char payload[sizeof(T)];
+};
+
+template<typename T, typename counts_t>
+struct storage_layout<T, counts_t, counter_layout::isolated> {
+  alignas(alignof(T)) unsigned char payload[sizeof(T)];
+  utils::Padded<counts_t> counts;
+};
+
+// Storage for an object of type T and its reference counts, which are
+// arranged according to the layout given by the object policy
+template<typename T, typename object_policy>
+struct counted_storage {
+
+  template<typename... Args>
+  explicit counted_storage(Args &&... args) {
+    new (&data.payload) T(std::forward<Args>(args)...);
+  }
+
+  T *get() { return std::launder(reinterpret_cast<T*>(&data.payload)); }
+  const T *get() const { return std::launder(reinterpret_cast<const T*>(&data.payload)); }
+
+  auto& ref_cnt() { return data.counts.ref_cnt; }
+  const auto& ref_cnt() const { return data.counts.ref_cnt; }
+  auto& weak_cnt() requires object_policy::weak_references { return data.counts.weak_cnt; }
+  const auto& weak_cnt() const requires object_policy::weak_references { return data.counts.weak_cnt; }
+
+ private:
+  using counts_t = reference_counts<typename object_policy::counter_type, object_policy::weak_references>;
+  storage_layout<T, counts_t, object_policy::layout> data;
+};
+
+// Storage for an object of a type T that derives from rc_base, and hence
+// contains its own reference counts
+template<typename T, typename object_policy>
+requires std::is_base_of_v<rc_base, T>
+struct counted_storage<T, object_policy> {
+
+  static_assert(std::is_same_v<typename object_policy::counter_type, rc_base::counter_type>,
+                "Objects that derive from rc_base have 32-bit reference counts");
+
+  template<typename... Args>
+  explicit counted_storage(Args &&... args) {
+    T* obj = new (&storage) T(std::forward<Args>(args)...);
+    [[maybe_unused]] static const bool recorded = (counts_offset = counts_offset_of(obj), true);
+    assert(counts_offset == counts_offset_of(obj));
+  }
+
+  T *get() { return std::launder(reinterpret_cast<T*>(&storage)); }
+  const T *get() const { return std::launder(reinterpret_cast<const T*>(&storage)); }
+
+  auto& ref_cnt() { return counts()->ref_cnt; }
+  const auto& ref_cnt() const { return counts()->ref_cnt; }
+  auto& weak_cnt() requires object_policy::weak_references { return counts()->weak_cnt; }
+  const auto& weak_cnt() const requires object_policy::weak_references { return counts()->weak_cnt; }
+
+ private:
+  using counts_t = rc_base::counts_t;
+
+  // The counts are not reached through the rc_base subobject, which can not be
+  // used once the object is destroyed, but through their offset in the storage.
+  // The offset is the same for every object of type T, so it is taken from the
+  // first object that is constructed, and written exactly once, while the
+  // initialization of a static in the constructor holds off any other
+  // constructor. Every object is hence constructed after the write, and its
+  // counts are only accessed after it has been constructed, so the offset
+  // needs no atomic access. A virtual rc_base rules out working it out at
+  // compile time instead.
+  inline static std::ptrdiff_t counts_offset = 0;
+
+  std::ptrdiff_t counts_offset_of(T* obj) {
+    return reinterpret_cast<unsigned char*>(static_cast<rc_base*>(obj)->counts()) - storage;
+  }
+
+  counts_t* counts() { return std::launder(reinterpret_cast<counts_t*>(storage + counts_offset)); }
+  const counts_t* counts() const { return std::launder(reinterpret_cast<const counts_t*>(storage + counts_offset)); }
+
   alignas(alignof(T)) unsigned char storage[sizeof(T)];
-  utils::StickyCounter<uint32_t> ref_cnt;
-  utils::StickyCounter<uint32_t> weak_cnt;
+};
+
+// Passed to the constructor of a counted array to give its length
+struct array_extent {
+  std::size_t length;
+};
+
+template<typename T, typename object_policy>
+struct counted_object;
+
+// Storage for an array of elements of type T and its reference counts. The
+// elements live in the same allocation as the counts, directly after the
+// counted object, at the first address that is suitably aligned for them, so
+// an array costs a single allocation, and finding its elements costs no load.
+// Any fields that the memory manager adds to the counted object must hence
+// precede it. The layout given by the object policy is ignored, since the
+// counts always precede the elements.
+template<typename T, typename object_policy>
+struct counted_storage<T[], object_policy> {
+
+  explicit counted_storage(array_extent extent) : length(extent.length) {
+    std::uninitialized_value_construct_n(elements(), length);
+  }
+
+  counted_storage(array_extent extent, const T& value) : length(extent.length) {
+    std::uninitialized_fill_n(elements(), length, value);
+  }
+
+  T *get() { return std::launder(elements()); }
+  const T *get() const { return std::launder(elements()); }
+
+  std::size_t size() const { return length; }
+
+  auto& ref_cnt() { return counts.ref_cnt; }
+  const auto& ref_cnt() const { return counts.ref_cnt; }
+  auto& weak_cnt() requires object_policy::weak_references { return counts.weak_cnt; }
+  const auto& weak_cnt() const requires object_policy::weak_references { return counts.weak_cnt; }
+
+ private:
+  using object_t = counted_object<T[], object_policy>;
+
+  T* elements() const {
+    auto end = reinterpret_cast<std::uintptr_t>(this) + sizeof(object_t);
+    if constexpr (alignof(T) > alignof(object_t)) end = (end + alignof(T) - 1) / alignof(T) * alignof(T);
+    return reinterpret_cast<T*>(end);
+  }
+
+  reference_counts<typename object_policy::counter_type, object_policy::weak_references> counts;
+  std::size_t length;
+};
+
+// An instance of an object of type T with an atomic reference count.
+template<typename T, typename object_policy = default_object_policy>
+struct counted_object : public counted_storage<T, object_policy> {
+
+  // Destroys and deallocates an object that was created with a user-supplied allocator
+  using deleter_t = void (*)(counted_object*);
+
+  // Only allocator-aware policies pay for a deleter. It is null for objects
+  // that were created by the memory manager's own allocator
+  [[no_unique_address]] std::conditional_t<object_policy::allocator_aware, deleter_t, empty_field> deleter{};
 
 // In debug mode only, keep track of whether the object has been
 // destroyed yet, to ensure that it is correctly destroyed
@@ -30,9 +238,7 @@ struct counted_object {
 #endif
 
   template<typename... Args>
-  explicit counted_object(Args &&... args) : ref_cnt(1), weak_cnt(1) {
-    new (&storage) T(std::forward<Args>(args)...);
-  }
+  explicit counted_object(Args &&... args) : counted_storage<T, object_policy>(std::forward<Args>(args)...) { }
 
   counted_object(const counted_object &) = delete;
   counted_object(counted_object &&) = delete;
@@ -45,66 +251,70 @@ struct counted_object {
   ~counted_object() = default;
 #endif
 
-  T *get() { return std::launder(reinterpret_cast<T*>(&storage)); }
-  const T *get() const { return std::launder(reinterpret_cast<const T*>(&storage)); }
+  using counted_storage<T, object_policy>::get;
+  using counted_storage<T, object_policy>::ref_cnt;
+  using counted_storage<T, object_policy>::weak_cnt;
+
+  constexpr static bool is_array = std::is_unbounded_array_v<T>;
 
   // Destroy the managed object, but keep the control data intact
   void dispose() {
-    get()->~T();
+    if constexpr (is_array) std::destroy_n(get(), this->size());
+    else get()->~T();
 #ifndef NDEBUG
     disposed.store(true);
 #endif
   }
 
-  auto get_use_count() const { return ref_cnt.load(); }
-  auto get_weak_count() const { return weak_cnt.load(); }
+  constexpr static bool weak_references = object_policy::weak_references;
 
-  bool add_refs(uint64_t count) { return ref_cnt.increment(count, std::memory_order_relaxed); }
+  auto get_use_count() const { return ref_cnt().load(); }
+  auto get_weak_count() const requires weak_references { return weak_cnt().load(); }
+
+  bool add_refs(uint64_t count) { return ref_cnt().increment(count, std::memory_order_relaxed); }
 
   enum class EjectAction {
     nothing,
     delay,
-    destroy
+    dispose
   };
 
   // Release strong references to the object. If the strong reference count reaches zero,
-  // the managed object will be destroyed, and the weak reference count will be decremented
-  // by one. If this causes the weak reference count to hit zero, returns true, indicating
-  // that the caller should delete this object.
+  // and no weak references remain, returns dispose, indicating that the caller should
+  // dispose of the managed object and then delete this object. If weak references remain,
+  // returns delay, indicating that the disposal must be deferred.
   EjectAction release_refs(uint64_t count) {
 
     // A decrement-release + an acquire fence is recommended by Boost's documentation:
     // https://www.boost.org/doc/libs/1_57_0/doc/html/atomic/usage_examples.html
     // Alternatively, an acquire-release decrement would work, but might be less efficient since the
     // acquire is only relevant if the decrement zeros the counter.
-    if (ref_cnt.decrement(count, std::memory_order_release)) {
+    if (ref_cnt().decrement(count, std::memory_order_release)) {
       std::atomic_thread_fence(std::memory_order_acquire);
       // If there are no live weak pointers, we can immediately destroy
       // everything. Otherwise, we have to defer the disposal of the
       // managed object since an atomic_weak_ptr might be about to
       // take a snapshot...
-      if (weak_cnt.load(std::memory_order_relaxed) == 1) {
-        // Immediately destroy the managed object and
-        // collect the control data, since no more
-        // live (strong or weak) references exist
-        dispose();
-        return EjectAction::destroy;
-      }
-      else {
-        // At least one weak reference exists, so we have to
-        // delay the destruction of the managed object
-        return EjectAction::delay;
+      if constexpr (weak_references) {
+        if (weak_cnt().load(std::memory_order_relaxed) != 1) {
+          // At least one weak reference exists, so we have to
+          // delay the destruction of the managed object
+          return EjectAction::delay;
+        }
       }
+      // No more live (strong or weak) references exist, so the
+      // managed object and the control data can be collected
+      return EjectAction::dispose;
     }
     return EjectAction::nothing;
   }
 
-  bool add_weak_refs(uint64_t count) { return weak_cnt.increment(count, std::memory_order_relaxed); }
+  bool add_weak_refs(uint64_t count) requires weak_references { return weak_cnt().increment(count, std::memory_order_relaxed); }
 
   // Release weak references to the object. If this causes the weak reference count
   // to hit zero, returns true, indicating that the caller should delete this object.
-  bool release_weak_refs(uint64_t count) {
-    return weak_cnt.decrement(count, std::memory_order_release);
+  bool release_weak_refs(uint64_t count) requires weak_references {
+    return weak_cnt().decrement(count, std::memory_order_release);
   }
 };
 
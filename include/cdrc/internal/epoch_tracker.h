@@ -50,12 +50,36 @@ struct epoch_tracker {
     return global_epoch.fetch_add(1);
   }
 
+  // Increment the global epoch, but only if every thread that is in a critical
+  // section has already announced the current epoch. Returns false, without
+  // advancing, if some thread has not. Nothing that was retired before the
+  // current epoch is then reachable, which is recorded as the safe epoch.
+  bool try_advance_global_epoch() {
+    auto current = global_epoch.load();
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      auto e = local_epoch[i].load();
+      if (e != no_epoch && e < current) return false;
+    }
+    auto safe = safe_epoch.load();
+    while (safe < current && !safe_epoch.compare_exchange_weak(safe, current)) { }
+    global_epoch.compare_exchange_strong(current, current + 1);
+    return true;
+  }
+
+  // Return the safe epoch. Anything that was retired in an earlier epoch can
+  // no longer be reached by any thread in a critical section. Only advances
+  // made with try_advance_global_epoch move the safe epoch forward.
+  epoch_type get_safe_epoch() {
+    return safe_epoch.load(std::memory_order_acquire);
+  }
+
   // Return the value of the earliest announced epoch. Returns
   // numeric_limits<epoch_type>::max() if no threads has an
   // active announcement.
   epoch_type get_min_announced_epoch() {
     epoch_type answer = std::numeric_limits<epoch_type>::max();
-    auto nt = utils::num_threads();
+    auto nt = utils::num_thread_ids();
     for (size_t i = 0; i < nt; i++) {
       answer = std::min(answer, local_epoch[i].load(std::memory_order_acquire));
     }
@@ -66,7 +90,7 @@ struct epoch_tracker {
   template<typename F>
   void scan_announced_epochs(F &&f) {
     std::atomic_thread_fence(std::memory_order_seq_cst); // TODO: is this necessary?
-    auto nt = utils::num_threads();
+    auto nt = utils::num_thread_ids();
     for (size_t i = 0; i < nt; i++) {
       epoch_type e = local_epoch[i].load(std::memory_order_acquire);
       if(e != no_epoch) f(i, e);
@@ -99,11 +123,12 @@ struct epoch_tracker {
   }
 
 private:
-  epoch_tracker() : global_epoch(0), local_epoch(utils::num_threads()), critical_section(utils::num_threads()) {}
+  epoch_tracker() : global_epoch(0), safe_epoch(0) {}
 
   Epoch global_epoch;
-  std::vector <Epoch> local_epoch;
-  std::vector <utils::Padded<bool>> critical_section;
+  Epoch safe_epoch;
+  utils::per_thread<Epoch> local_epoch;
+  utils::per_thread<utils::Padded<bool>> critical_section;
 };
 
 }  // namespace internal
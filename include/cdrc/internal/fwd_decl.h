@@ -4,10 +4,17 @@
 
 #include <type_traits>
 
+#include "object_policy.h"
+
 #include "smr/acquire_retire.h"
 #include "smr/acquire_retire_ebr.h"
+#include "smr/acquire_retire_he.h"
 #include "smr/acquire_retire_ibr.h"
 #include "smr/acquire_retire_hyaline.h"
+#include "smr/acquire_retire_hyaline_s.h"
+#include "smr/acquire_retire_crystalline.h"
+#include "smr/acquire_retire_nbr.h"
+#include "smr/acquire_retire_qsbr.h"
 
 namespace cdrc {
 
@@ -116,6 +123,27 @@ template<typename T>
 using weak_snapshot_ptr_ibr = weak_snapshot_ptr<T, internal::acquire_retire_ibr<T>>;
 
 
+// Explicit tagged IBR version of each type
+
+template<typename T>
+using atomic_rc_ptr_ibr_tagged = atomic_rc_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using rc_ptr_ibr_tagged = rc_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using snapshot_ptr_ibr_tagged = snapshot_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using atomic_weak_ptr_ibr_tagged = atomic_weak_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using weak_ptr_ibr_tagged = weak_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using weak_snapshot_ptr_ibr_tagged = weak_snapshot_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+
 // Explicit Hyaline version of each type
 
 template<typename T>
@@ -137,19 +165,187 @@ template<typename T>
 using weak_snapshot_ptr_hyaline = weak_snapshot_ptr<T, internal::acquire_retire_hyaline<T>>;
 
 
-// Memory management backend aliases
+// Explicit Hyaline-S version of each type
+
+template<typename T>
+using atomic_rc_ptr_hyaline_s = atomic_rc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using rc_ptr_hyaline_s = rc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using snapshot_ptr_hyaline_s = snapshot_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using atomic_weak_ptr_hyaline_s = atomic_weak_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using weak_ptr_hyaline_s = weak_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_hyaline_s = weak_snapshot_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+
+// Explicit Crystalline version of each type
+
+template<typename T>
+using atomic_rc_ptr_crystalline = atomic_rc_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using rc_ptr_crystalline = rc_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using snapshot_ptr_crystalline = snapshot_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using atomic_weak_ptr_crystalline = atomic_weak_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using weak_ptr_crystalline = weak_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_crystalline = weak_snapshot_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+
+// Explicit hazard-pointer with asymmetric fences version of each type
+
+template<typename T>
+using atomic_rc_ptr_hp_asym = atomic_rc_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using rc_ptr_hp_asym = rc_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using snapshot_ptr_hp_asym = snapshot_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using atomic_weak_ptr_hp_asym = atomic_weak_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using weak_ptr_hp_asym = weak_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using weak_snapshot_ptr_hp_asym = weak_snapshot_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+
+// Explicit hazard-eras version of each type
 
 template<typename T>
-using hp_backend = internal::acquire_retire<T>;
+using atomic_rc_ptr_he = atomic_rc_ptr<T, internal::acquire_retire_he<T>>;
 
 template<typename T>
-using ebr_backend = internal::acquire_retire_ebr<T>;
+using rc_ptr_he = rc_ptr<T, internal::acquire_retire_he<T>>;
 
 template<typename T>
-using ibr_backend = internal::acquire_retire_ibr<T>;
+using snapshot_ptr_he = snapshot_ptr<T, internal::acquire_retire_he<T>>;
 
 template<typename T>
-using hyaline_backend = internal::acquire_retire_hyaline<T>;
+using atomic_weak_ptr_he = atomic_weak_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using weak_ptr_he = weak_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_he = weak_snapshot_ptr<T, internal::acquire_retire_he<T>>;
+
+
+// Explicit neutralization-based reclamation version of each type
+
+template<typename T>
+using atomic_rc_ptr_nbr = atomic_rc_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using rc_ptr_nbr = rc_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using snapshot_ptr_nbr = snapshot_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using atomic_weak_ptr_nbr = atomic_weak_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using weak_ptr_nbr = weak_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_nbr = weak_snapshot_ptr<T, internal::acquire_retire_nbr<T>>;
+
+
+// Explicit quiescent-state-based reclamation version of each type
+
+template<typename T>
+using atomic_rc_ptr_qsbr = atomic_rc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using rc_ptr_qsbr = rc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using snapshot_ptr_qsbr = snapshot_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using atomic_weak_ptr_qsbr = atomic_weak_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using weak_ptr_qsbr = weak_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using weak_snapshot_ptr_qsbr = weak_snapshot_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+
+// Object policies for customizing how the managed objects are stored
+
+using default_object_policy = internal::default_object_policy;
+
+using pool_object_policy = internal::pool_object_policy;
+
+using counter_layout = internal::counter_layout;
+
+using counters_before_payload_object_policy = internal::counters_before_payload_object_policy;
+
+using isolated_counters_object_policy = internal::isolated_counters_object_policy;
+
+using compact_counters_object_policy = internal::compact_counters_object_policy;
+
+using wide_counters_object_policy = internal::wide_counters_object_policy;
+
+using no_weak_object_policy = internal::no_weak_object_policy;
+
+using allocator_aware_object_policy = internal::allocator_aware_object_policy;
+
+
+// Memory management backend aliases
+
+template<typename T, typename object_policy = default_object_policy>
+using hp_backend = internal::acquire_retire<T, 7, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using hp_asymmetric_backend = internal::acquire_retire<T, 7, 2, object_policy, internal::asymmetric_fence_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using ebr_backend = internal::acquire_retire_ebr<T, 10, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using ibr_backend = internal::acquire_retire_ibr<T, 40, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using ibr_tagged_backend = internal::acquire_retire_ibr<T, 40, 2, object_policy, internal::ibr_tagged_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using he_backend = internal::acquire_retire_he<T, 7, 40, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using nbr_backend = internal::acquire_retire_nbr<T, 7, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using qsbr_backend = internal::acquire_retire_qsbr<T, 10, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using hyaline_backend = internal::acquire_retire_hyaline<T, 2, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using hyaline_s_backend = internal::acquire_retire_hyaline_s<T, 2, 40, object_policy>;
+
+template<typename T, typename object_policy = default_object_policy>
+using crystalline_backend = internal::acquire_retire_crystalline<T, 2, 40, object_policy>;
 
 }  // namespace cdrc
 
@@ -5,13 +5,17 @@
 #include <cassert>
 #include <cstddef>
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <new>
 #include <type_traits>
 #include <vector>
 
 #include "counted_object.h"
+#include "object_policy.h"
 #include "utils.h"
 
 namespace cdrc {
@@ -60,18 +64,108 @@ struct basic_acquired_pointer {
   U value;
 };
 
-template<typename T, typename Derived>
+template<typename T, typename Derived, typename object_policy_ = default_object_policy>
 struct memory_manager_base {
 
-  using counted_object_t = counted_object<T>;
+  using managed_type = T;
+  using object_policy = object_policy_;
+  using allocator = typename object_policy::allocator;
+
+  using counted_object_t = counted_object<T, object_policy>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
-  explicit memory_manager_base(size_t num_threads) : num_allocated(num_threads) {}
+  // Coalesced decrements that exceed what a single update of the reference
+  // counts can safely apply (see StickyCounter::max_delta) are split up
+  using counter_t = utils::StickyCounter<typename object_policy::counter_type>;
+
+  // Number of kinds of deferred action that can be pending on an object. Without weak
+  // references, decrementing the strong count is the only action that is ever deferred
+  constexpr static size_t num_retire_types = object_policy::weak_references ? internal::num_retire_types : 1;
+
+  memory_manager_base() {
+    allocator::initialize();
+  }
+
+  // Allocate and construct an object of type U, which is either counted_object_t
+  // or a type derived from it that carries additional backend-specific data.
+  // Arrays are given their length by an array_extent among the arguments, and
+  // their elements are placed directly after the object of type U, which must
+  // therefore end with the counted object (see counted_storage<T[]>)
+  template<typename U, typename... Args>
+  U* allocate_object(Args&&... args) {
+    std::size_t length = 0;
+    array_extent* extent = nullptr;
+    if constexpr (U::is_array) {
+      ([&](auto& arg) {
+        if constexpr (std::is_same_v<std::remove_cvref_t<decltype(arg)>, array_extent>) extent = &arg;
+      }(args), ...);
+      assert(extent != nullptr);
+      length = extent->length;
+      if (length > (std::numeric_limits<std::size_t>::max() - elements_offset<U>()) / sizeof(element_type)) {
+        throw std::bad_array_new_length();
+      }
+    }
+    auto size = allocation_size<U>(length);
+    void* storage = allocator::allocate(size, allocation_alignment<U>());
+    U* p;
+    try {
+      p = new (storage) U(std::forward<Args>(args)...);
+    } catch (...) {
+      allocator::deallocate(storage, size, allocation_alignment<U>());
+      throw;
+    }
+    if constexpr (U::is_array) {
+      assert(static_cast<void*>(p->get()) == static_cast<std::byte*>(storage) + elements_offset<U>());
+    }
+    increment_allocations();
+    return p;
+  }
 
-  void dispose(counted_ptr_t ptr) {
+  // Allocate and construct an object of type U using the given allocator instead of
+  // the policy's allocator. A copy of the allocator is kept alongside the object so
+  // that deallocate_object can hand the memory back to it.
+  template<typename U, typename Alloc, typename... Args>
+  U* allocate_object_with(const Alloc& alloc, Args&&... args) {
+    static_assert(object_policy::allocator_aware,
+      "Creating objects with a custom allocator requires an allocator-aware object policy");
+    static_assert(!U::is_array, "Arrays can not be created with a custom allocator");
+    using object_t = object_with_allocator<U, Alloc>;
+    using traits = typename std::allocator_traits<Alloc>::template rebind_traits<object_t>;
+    typename traits::allocator_type a(alloc);
+    object_t* p = traits::allocate(a, 1);
+    try {
+      new (p) object_t(alloc, std::forward<Args>(args)...);
+    } catch (...) {
+      traits::deallocate(a, p, 1);
+      throw;
+    }
+    p->deleter = &delete_with_allocator<U, Alloc>;
+    increment_allocations();
+    return p;
+  }
+
+  // Destroy and deallocate an object that was created by allocate_object<U>
+  // or by allocate_object_with<U>
+  template<typename U>
+  void deallocate_object(U* p) {
+    if constexpr (object_policy::allocator_aware) {
+      if (p->deleter != nullptr) {
+        p->deleter(p);
+        decrement_allocations();
+        return;
+      }
+    }
+    std::size_t size;
+    if constexpr (U::is_array) size = allocation_size<U>(p->size());
+    else size = allocation_size<U>();
+    p->~U();
+    allocator::deallocate(p, size, allocation_alignment<U>());
+    decrement_allocations();
+  }
+
+  void dispose(counted_ptr_t ptr) requires object_policy::weak_references {
     assert(ptr->get_use_count() == 0);
-    ptr->dispose();
-    if (ptr->release_weak_refs(1)) destroy(ptr);
+    dispose_iteratively(ptr);
   }
 
   void destroy(counted_ptr_t ptr) {
@@ -89,7 +183,11 @@ struct memory_manager_base {
   void eject(counted_ptr_t ptr, RetireType type) {
     assert(ptr != nullptr);
 
-    if (type == RetireType::decrement_strong_count) {
+    if constexpr (!object_policy::weak_references) {
+      assert(type == RetireType::decrement_strong_count);
+      decrement_ref_cnt(ptr);
+    }
+    else if (type == RetireType::decrement_strong_count) {
       decrement_ref_cnt(ptr);
     }
     else if (type == RetireType::decrement_weak_count) {
@@ -101,41 +199,93 @@ struct memory_manager_base {
     }
   }
 
+  // Perform the same eject action count times. Decrements of the same reference
+  // count are applied with a single atomic update, or as few as the width of
+  // the counts permits
+  void eject(counted_ptr_t ptr, RetireType type, size_t count) {
+    assert(ptr != nullptr);
+    assert(count >= 1);
+
+    if (count > 1) {
+      auto& coalesced = num_coalesced[utils::threadID.getTID()];
+      coalesced.store(coalesced.load(std::memory_order_relaxed) + count - 1, std::memory_order_relaxed);
+    }
+    if constexpr (!object_policy::weak_references) {
+      assert(type == RetireType::decrement_strong_count);
+      decrement_ref_cnt(ptr, count);
+    }
+    else if (type == RetireType::decrement_strong_count) {
+      decrement_ref_cnt(ptr, count);
+    }
+    else if (type == RetireType::decrement_weak_count) {
+      decrement_weak_cnt(ptr, count);
+    }
+    else {
+      // An object is only ever retired for disposal once
+      assert(type == RetireType::dispose && count == 1);
+      dispose(ptr);
+    }
+  }
+
+  // Perform every eject action in the given list, which is sorted in the process.
+  // Repeated actions on the same object are performed together (see above)
+  template<typename Ejects>
+  void eject_coalesced(Ejects& ejects) {
+    std::sort(ejects.begin(), ejects.end());
+    for (auto it = ejects.begin(); it != ejects.end();) {
+      auto next = std::find_if(it, ejects.end(), [&](const auto& x) { return x != *it; });
+      eject(it->first, it->second, next - it);
+      it = next;
+    }
+  }
+
   bool increment_ref_cnt(counted_ptr_t ptr) {
     assert(ptr != nullptr);
     return ptr->add_refs(1);
   }
 
-  bool increment_weak_cnt(counted_ptr_t ptr) {
+  bool increment_weak_cnt(counted_ptr_t ptr) requires object_policy::weak_references {
     assert(ptr != nullptr);
     return ptr->add_weak_refs(1);
   }
 
-  void decrement_ref_cnt(counted_ptr_t ptr) {
+  void decrement_ref_cnt(counted_ptr_t ptr, size_t count = 1) {
     assert(ptr != nullptr);
-    assert(ptr->get_use_count() >= 1);
-    auto result = ptr->release_refs(1);
-    if (result == counted_object_t::EjectAction::destroy) {
-      destroy(ptr);
-    } else if (result == counted_object_t::EjectAction::delay) {
-      retire(ptr, RetireType::dispose);
+    assert(counter_t::is_saturating || ptr->get_use_count() >= count);
+    for (; count > counter_t::max_delta; count -= counter_t::max_delta) {
+      [[maybe_unused]] auto result = ptr->release_refs(counter_t::max_delta);
+      assert(result == counted_object_t::EjectAction::nothing);
+    }
+    auto result = ptr->release_refs(count);
+    if (result == counted_object_t::EjectAction::dispose) {
+      dispose_iteratively(ptr);
+    } else if constexpr (object_policy::weak_references) {
+      if (result == counted_object_t::EjectAction::delay) retire(ptr, RetireType::dispose);
     }
   }
 
-  void decrement_weak_cnt(counted_ptr_t ptr) {
+  void decrement_weak_cnt(counted_ptr_t ptr, size_t count = 1) requires object_policy::weak_references {
     assert(ptr != nullptr);
-    assert(ptr->get_weak_count() >= 1);
-    if (ptr->release_weak_refs(1)) {
+    assert(counter_t::is_saturating || ptr->get_weak_count() >= count);
+    for (; count > counter_t::max_delta; count -= counter_t::max_delta) {
+      [[maybe_unused]] bool released = ptr->release_weak_refs(counter_t::max_delta);
+      assert(!released);
+    }
+    if (ptr->release_weak_refs(count)) {
       destroy(ptr);
     }
   }
 
+  // Called by the pointer types before they modify an atomic pointer. Backends
+  // whose reads may be rolled back and retried hide it to stop that first
+  void before_update() {}
+
   void delayed_decrement_ref_cnt(counted_ptr_t ptr) {
     assert(ptr->get_use_count() >= 1);
     retire(ptr, RetireType::decrement_strong_count);
   }
 
-  void delayed_decrement_weak_cnt(counted_ptr_t ptr) {
+  void delayed_decrement_weak_cnt(counted_ptr_t ptr) requires object_policy::weak_references {
     assert(ptr->get_weak_count() >= 1);
     retire(ptr, RetireType::decrement_weak_count);
   }
@@ -150,15 +300,154 @@ struct memory_manager_base {
     num_allocated[tid].store(num_allocated[tid].load(std::memory_order_seq_cst) + 1, std::memory_order_seq_cst);
   }
 
+  // Set the maximum number of queued objects that a single disposal disposes
+  // of (see dispose_iteratively). Defaults to unlimited. With a finite budget,
+  // any objects still queued on a thread are disposed of by its next disposal,
+  // when the thread exits, or when the memory manager is destroyed.
+  void set_destruction_budget(size_t budget) {
+    assert(budget > 0);
+    destruction_budget.store(budget, std::memory_order_relaxed);
+  }
+
+  // Dispose of every object that is queued for disposal on the calling thread.
+  // Returns whether there were any.
+  bool flush_destructions() {
+    auto& queue = destruction_queues[utils::threadID.getTID()];
+    if (queue.active || queue.pending.empty()) return false;
+    queue.active = true;
+    while (!queue.pending.empty()) {
+      auto ptr = queue.pending.back();
+      queue.pending.pop_back();
+      dispose_and_destroy(ptr);
+    }
+    queue.active = false;
+    return true;
+  }
+
   size_t currently_allocated() {
     size_t total = 0;
-    for (size_t t = 0; t < utils::num_threads(); t++) {
+    for (size_t t = 0; t < utils::num_thread_ids(); t++) {
       total += num_allocated[t].load(std::memory_order_acquire);
     }
     return total;
   }
 
-  std::vector<utils::Padded<std::atomic<std::ptrdiff_t>>> num_allocated;
+  // The number of atomic reference count updates that were saved by performing
+  // repeated deferred decrements of the same object together
+  size_t coalesced_decrements() {
+    size_t total = 0;
+    for (size_t t = 0; t < utils::num_thread_ids(); t++) {
+      total += num_coalesced[t].load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  utils::per_thread<utils::Padded<std::atomic<std::ptrdiff_t>>> num_allocated;
+  utils::per_thread<utils::Padded<std::atomic<size_t>>> num_coalesced;
+
+ protected:
+
+  // Dispose of the managed object of ptr, whose counts have hit zero, and then destroy it.
+  //
+  // Disposing of an object can drop the last reference to another object, such as
+  // the next node of a linked list, whose disposal would in turn drop the last
+  // reference to the one after, and so on, so a long chain would be destroyed by
+  // a chain of recursive calls deep enough to overflow the call stack. Instead,
+  // a disposal that happens during another disposal on the same thread is only
+  // queued, and the outermost disposal works through the queue afterwards, which
+  // keeps the stack depth constant. The outermost disposal handles at most
+  // destruction_budget objects, leaving the remainder of the queue to subsequent
+  // disposals, which spreads the teardown of large structures across operations.
+  void dispose_iteratively(counted_ptr_t ptr) {
+    auto& queue = destruction_queues[utils::threadID.getTID()];
+    queue.pending.push_back(ptr);
+    if (queue.active) return;
+    queue.active = true;
+    auto budget = destruction_budget.load(std::memory_order_relaxed);
+    for (size_t n = 0; n < budget && !queue.pending.empty(); n++) {
+      auto next = queue.pending.back();
+      queue.pending.pop_back();
+      dispose_and_destroy(next);
+    }
+    queue.active = false;
+  }
+
+  // Whether any thread has objects left queued for disposal
+  bool destructions_pending() {
+    return destruction_queues.any_of([](const auto& queue) { return !queue.pending.empty(); });
+  }
+
+  // Dispose of the objects queued for disposal by every thread, regardless of
+  // the destruction budget. Only for use by the destructors of the memory
+  // managers, when no other thread can be using the queues
+  void drain_destruction_queues() {
+    auto& own = destruction_queues[utils::threadID.getTID()];
+    destruction_queues.for_each([&](auto& queue) {
+      if (&queue == &own) return;
+      own.pending.insert(own.pending.end(), queue.pending.begin(), queue.pending.end());
+      queue.pending.clear();
+    });
+    flush_destructions();
+  }
+
+ private:
+
+  using element_type = std::remove_extent_t<T>;
+
+  // Objects whose disposal has been queued by a thread
+  struct destruction_queue {
+    std::vector<counted_ptr_t> pending;
+    bool active{false};                         // Whether the thread is currently disposing of an object
+  };
+
+  void dispose_and_destroy(counted_ptr_t ptr) {
+    ptr->dispose();
+    if constexpr (object_policy::weak_references) {
+      if (ptr->release_weak_refs(1)) destroy(ptr);
+    } else {
+      destroy(ptr);
+    }
+  }
+
+  utils::per_thread<utils::Padded<destruction_queue>> destruction_queues;
+  std::atomic<size_t> destruction_budget{std::numeric_limits<size_t>::max()};
+
+  // Offset of the first element of an array from the start of an object of type U
+  template<typename U>
+  constexpr static std::size_t elements_offset() {
+    return (sizeof(U) + alignof(element_type) - 1) / alignof(element_type) * alignof(element_type);
+  }
+
+  // Size of the storage for an object of type U, including the elements of an array of the given length
+  template<typename U>
+  constexpr static std::size_t allocation_size([[maybe_unused]] std::size_t length = 0) {
+    if constexpr (U::is_array) return elements_offset<U>() + length * sizeof(element_type);
+    else return sizeof(U);
+  }
+
+  template<typename U>
+  constexpr static std::size_t allocation_alignment() {
+    if constexpr (U::is_array) return std::max(alignof(U), alignof(element_type));
+    else return alignof(U);
+  }
+
+  // An object of type U followed by the allocator that it was allocated with
+  template<typename U, typename Alloc>
+  struct object_with_allocator : public U {
+    template<typename... Args>
+    explicit object_with_allocator(const Alloc& alloc_, Args&&... args) : U(std::forward<Args>(args)...), alloc(alloc_) {}
+    Alloc alloc;
+  };
+
+  template<typename U, typename Alloc>
+  static void delete_with_allocator(counted_ptr_t ptr) {
+    using object_t = object_with_allocator<U, Alloc>;
+    using traits = typename std::allocator_traits<Alloc>::template rebind_traits<object_t>;
+    auto p = static_cast<object_t*>(static_cast<U*>(ptr));
+    typename traits::allocator_type a(std::move(p->alloc));
+    p->~object_t();
+    traits::deallocate(a, p, 1);
+  }
 };
 
 }  // namespace internal
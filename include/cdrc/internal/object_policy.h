@@ -0,0 +1,90 @@
+
+#ifndef CDRC_INTERNAL_OBJECT_POLICY_H
+#define CDRC_INTERNAL_OBJECT_POLICY_H
+
+#include <cstdint>
+
+#include "pool_allocator.h"
+
+namespace cdrc {
+namespace internal {
+
+// Where the reference counts of an object are placed relative to the object.
+// Types that hold their own counts (see rc_base) ignore the layout of the
+// policy, and require its counter type to be uint32_t.
+enum class counter_layout {
+  packed,             // Directly after the object, without any padding
+  before_payload,     // Directly before the object, so that they share a cache line with its first fields
+  isolated            // On a cache line of their own, so that updating them never false-shares with reads of the object
+};
+
+// Object policies customize how the reference-counted objects that are created
+// by a memory manager are stored. Every memory management backend takes an
+// object policy as its final template argument. An object policy should define
+//  - allocator : The allocator that provides the storage for each object. See
+//                pool_allocator.h for the interface that allocators satisfy.
+//  - layout : The counter_layout of the reference counts of each object
+//  - counter_type : The unsigned integer type of the reference counts. Counts
+//                   narrower than 32 bits saturate rather than overflow (see
+//                   utils::StickyCounter), leaking the object
+//  - weak_references : Whether objects can be referred to by weak pointers.
+//                      Without them, objects carry no weak count, and are
+//                      always destroyed as soon as their strong count hits zero
+//  - allocator_aware : Whether objects may also be created with a user-supplied
+//                      allocator (see allocate_rc). Such objects remember how
+//                      to deallocate themselves, which costs a pointer each.
+//
+// Custom policies can be written by deriving from default_object_policy and
+// overriding only the members of interest.
+
+// Allocate objects with the global operator new
+struct default_object_policy {
+  using allocator = system_allocator;
+  constexpr static counter_layout layout = counter_layout::packed;
+  using counter_type = uint32_t;
+  constexpr static bool weak_references = true;
+  constexpr static bool allocator_aware = false;
+};
+
+// Allocate objects from a per-thread slab pool, which takes the global
+// allocator off the critical path of allocation-heavy workloads
+struct pool_object_policy : public default_object_policy {
+  using allocator = pool_allocator;
+};
+
+// Place the reference counts in front of each object
+struct counters_before_payload_object_policy : public default_object_policy {
+  constexpr static counter_layout layout = counter_layout::before_payload;
+};
+
+// Place the reference counts of each object on a cache line of their own
+struct isolated_counters_object_policy : public default_object_policy {
+  constexpr static counter_layout layout = counter_layout::isolated;
+};
+
+// Use 16-bit reference counts to shrink the footprint of small objects
+struct compact_counters_object_policy : public default_object_policy {
+  using counter_type = uint16_t;
+};
+
+// Use 64-bit reference counts for objects that are extremely widely shared
+struct wide_counters_object_policy : public default_object_policy {
+  using counter_type = uint64_t;
+};
+
+// Disallow weak pointers, which saves the weak count of every object
+// and the bookkeeping for the deferred disposal of weakly-referenced objects
+struct no_weak_object_policy : public default_object_policy {
+  constexpr static bool weak_references = false;
+};
+
+// Additionally permit objects to be created with user-supplied allocators,
+// such as std::pmr allocators that draw from an arena or a monotonic buffer
+struct allocator_aware_object_policy : public default_object_policy {
+  constexpr static bool allocator_aware = true;
+};
+
+}  // namespace internal
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_OBJECT_POLICY_H
@@ -0,0 +1,71 @@
+
+#ifndef CDRC_INTERNAL_ORPHAN_LIST_H
+#define CDRC_INTERNAL_ORPHAN_LIST_H
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace cdrc {
+namespace internal {
+
+// The deferred ejects that threads were still holding when they exited.
+//
+// An exiting thread performs whatever deferred ejects it safely can, and
+// pushes the remainder onto the list, rather than leaving them in its
+// thread-local storage, where they would sit until some later thread
+// happened to be given the same thread ID. Surviving threads adopt the
+// whole list when they next process their own deferred ejects, so the
+// orphaned ejects are retried as part of their amortized work.
+//
+// Pushing and adopting are lock free. Since adopting always takes the
+// entire list, the list is not subject to ABA.
+template<typename Entry>
+class orphan_list {
+
+  struct node {
+    std::vector<Entry> entries;
+    node* next;
+  };
+
+ public:
+  orphan_list() = default;
+
+  orphan_list(const orphan_list&) = delete;
+  orphan_list& operator=(const orphan_list&) = delete;
+
+  ~orphan_list() {
+    adopt([](const Entry&) {});
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == nullptr;
+  }
+
+  void push(std::vector<Entry>&& entries) {
+    if (entries.empty()) return;
+    auto n = new node{std::move(entries), head.load(std::memory_order_relaxed)};
+    while (!head.compare_exchange_weak(n->next, n, std::memory_order_acq_rel)) { }
+  }
+
+  // Take every entry off the list, and apply f to each of them
+  template<typename F>
+  void adopt(F&& f) {
+    if (empty()) return;
+    auto n = head.exchange(nullptr, std::memory_order_acq_rel);
+    while (n != nullptr) {
+      for (const auto& entry : n->entries) f(entry);
+      auto next = n->next;
+      delete n;
+      n = next;
+    }
+  }
+
+ private:
+  alignas(128) std::atomic<node*> head{nullptr};
+};
+
+}  // namespace internal
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_ORPHAN_LIST_H
@@ -0,0 +1,279 @@
+
+#ifndef CDRC_INTERNAL_POOL_ALLOCATOR_H
+#define CDRC_INTERNAL_POOL_ALLOCATOR_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <array>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "utils.h"
+
+namespace cdrc {
+namespace internal {
+
+// Allocators provide the storage for the objects created by a memory manager.
+// An allocator is a type with the static member functions
+//
+//   void* allocate(size_t size, size_t alignment)
+//   void deallocate(void* p, size_t size, size_t alignment)
+//   void initialize()
+//
+// deallocate is always called with the same size and alignment that were
+// given to the allocate call that produced p. initialize is called by every
+// memory manager on construction, and must ensure that any global state used
+// by the allocator is constructed before, and hence destroyed after, it.
+
+// Allocator that forwards to the global operator new and operator delete
+struct system_allocator {
+  static void* allocate(std::size_t size, std::size_t alignment) {
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return ::operator new(size, std::align_val_t{alignment});
+    else return ::operator new(size);
+  }
+
+  static void deallocate(void* p, std::size_t size, std::size_t alignment) {
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(p, size, std::align_val_t{alignment});
+    else ::operator delete(p, size);
+  }
+
+  static void initialize() { }
+};
+
+// A per-thread, size-class slab allocator for small objects.
+//
+// Blocks are carved out of large slabs and handed out from thread-local free
+// lists, one per size class, so that allocating and freeing an object usually
+// touches only memory that is local to the calling thread. A freed block is
+// always pushed onto the free list of the thread that frees it, regardless of
+// which thread allocated it. When a local free list grows too long, a batch of
+// its blocks is handed over to a global list for that size class, from which
+// threads whose local lists run dry can adopt an entire batch at once. Slabs
+// are only returned to the system when the pool itself is destroyed.
+//
+// Requests that are larger than max_block_size or that require an alignment
+// larger than max_alignment are forwarded to the system allocator.
+class slab_pool {
+
+  // A free block. Every block is at least granularity bytes, which leaves room
+  // to link batches of blocks together while they sit on the global lists
+  struct Block {
+    Block* next;
+    Block* next_batch;
+  };
+
+ public:
+  constexpr static std::size_t granularity = 16;
+  constexpr static std::size_t max_block_size = 1024;
+  constexpr static std::size_t max_alignment = 128;
+  constexpr static std::size_t num_size_classes = max_block_size / granularity;
+  constexpr static std::size_t batch_size = 64;           // Number of blocks moved to or from a global list at once
+  constexpr static std::size_t slab_size = 64 * 1024;     // Number of bytes requested from the system per slab
+
+  static_assert(sizeof(Block) <= granularity);
+  static_assert(slab_size >= max_block_size * batch_size);
+
+  // A snapshot of the occupancy of the pool
+  struct statistics {
+    std::size_t reserved_bytes;       // Bytes obtained from the system to carve blocks out of
+    std::size_t used_bytes;           // Bytes of the blocks that are currently allocated
+    std::size_t used_blocks;          // Number of blocks that are currently allocated
+
+    // The fraction of the reserved memory that is currently allocated
+    [[nodiscard]] double occupancy() const {
+      return reserved_bytes == 0 ? 0.0 : static_cast<double>(used_bytes) / static_cast<double>(reserved_bytes);
+    }
+  };
+
+  static slab_pool& instance() {
+    static slab_pool pool;
+    return pool;
+  }
+
+  void* allocate(std::size_t size, std::size_t alignment) {
+    if (!is_pooled(size, alignment)) return system_allocator::allocate(size, alignment);
+    auto sc = size_class(size, alignment);
+    auto id = utils::threadID.getTID();
+    auto& cache = local_caches[id];
+    auto& list = cache.free_lists[sc];
+
+    if (list.head == nullptr) adopt_batch(sc, list);
+
+    void* result;
+    if (list.head != nullptr) {
+      result = list.head;
+      list.head = list.head->next;
+      list.count--;
+    }
+    else {
+      result = carve(sc, cache);
+    }
+
+    record_usage(cache, static_cast<std::ptrdiff_t>(block_size(sc)));
+    return result;
+  }
+
+  void deallocate(void* p, std::size_t size, std::size_t alignment) {
+    if (!is_pooled(size, alignment)) return system_allocator::deallocate(p, size, alignment);
+    auto sc = size_class(size, alignment);
+    auto id = utils::threadID.getTID();
+    auto& cache = local_caches[id];
+    auto& list = cache.free_lists[sc];
+
+    auto block = static_cast<Block*>(p);
+    block->next = list.head;
+    list.head = block;
+    list.count++;
+
+    record_usage(cache, -static_cast<std::ptrdiff_t>(block_size(sc)));
+    if (list.count >= 2 * batch_size) release_batch(sc, list);
+  }
+
+  statistics get_statistics() const {
+    std::ptrdiff_t used_bytes = 0, used_blocks = 0;
+    local_caches.for_each([&](const auto& cache) {
+      used_bytes += cache.used_bytes.load(std::memory_order_relaxed);
+      used_blocks += cache.used_blocks.load(std::memory_order_relaxed);
+    });
+    return {reserved_bytes.load(std::memory_order_relaxed),
+            static_cast<std::size_t>(std::max<std::ptrdiff_t>(0, used_bytes)),
+            static_cast<std::size_t>(std::max<std::ptrdiff_t>(0, used_blocks))};
+  }
+
+  slab_pool(const slab_pool&) = delete;
+  slab_pool& operator=(const slab_pool&) = delete;
+
+  ~slab_pool() {
+    for (auto slab : slabs) {
+      system_allocator::deallocate(slab, slab_size, max_alignment);
+    }
+  }
+
+ private:
+  slab_pool() : reserved_bytes(0) {}
+
+  struct FreeList {
+    Block* head{nullptr};
+    std::size_t count{0};
+  };
+
+  // Align to cache line boundary to avoid false sharing
+  struct alignas(128) LocalCache {
+    std::array<FreeList, num_size_classes> free_lists{};
+    std::array<std::byte*, num_size_classes> bump{};        // Next unused byte of the current slab of each size class
+    std::array<std::byte*, num_size_classes> bump_end{};    // End of the current slab of each size class
+    std::atomic<std::ptrdiff_t> used_bytes{0};
+    std::atomic<std::ptrdiff_t> used_blocks{0};
+  };
+
+  struct alignas(128) GlobalList {
+    std::mutex lock;
+    Block* batches{nullptr};                                // Batches are linked through their first block
+  };
+
+  static bool is_pooled(std::size_t size, std::size_t alignment) {
+    return size <= max_block_size && alignment <= max_alignment;
+  }
+
+  // Blocks of a size class are a multiple of the alignment that they were requested with,
+  // which, together with slabs being aligned to max_alignment, ensures that every block
+  // carved out of a slab is correctly aligned.
+  static std::size_t size_class(std::size_t size, std::size_t alignment) {
+    auto unit = std::max(alignment, granularity);
+    auto rounded = (std::max<std::size_t>(size, 1) + unit - 1) / unit * unit;
+    assert(rounded <= max_block_size);
+    return rounded / granularity - 1;
+  }
+
+  static std::size_t block_size(std::size_t sc) {
+    return (sc + 1) * granularity;
+  }
+
+  static void record_usage(LocalCache& cache, std::ptrdiff_t bytes) {
+    cache.used_bytes.store(cache.used_bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+    cache.used_blocks.store(cache.used_blocks.load(std::memory_order_relaxed) + (bytes > 0 ? 1 : -1), std::memory_order_relaxed);
+  }
+
+  // Take a batch of free blocks from the global list of the given size class
+  void adopt_batch(std::size_t sc, FreeList& list) {
+    auto& global = global_lists[sc];
+    std::lock_guard<std::mutex> guard(global.lock);
+    if (global.batches != nullptr) {
+      list.head = global.batches;
+      list.count = batch_size;
+      global.batches = global.batches->next_batch;
+    }
+  }
+
+  // Hand a batch of blocks from the given local free list over to the global list
+  void release_batch(std::size_t sc, FreeList& list) {
+    assert(list.count >= batch_size);
+    Block* first = list.head;
+    Block* last = first;
+    for (std::size_t i = 1; i < batch_size; i++) last = last->next;
+    list.head = last->next;
+    list.count -= batch_size;
+    last->next = nullptr;
+
+    auto& global = global_lists[sc];
+    std::lock_guard<std::mutex> guard(global.lock);
+    first->next_batch = global.batches;
+    global.batches = first;
+  }
+
+  // Carve a fresh block out of the calling thread's current slab for the size class
+  void* carve(std::size_t sc, LocalCache& cache) {
+    auto size = block_size(sc);
+    if (cache.bump[sc] == nullptr || cache.bump[sc] + size > cache.bump_end[sc]) {
+      auto slab = static_cast<std::byte*>(system_allocator::allocate(slab_size, max_alignment));
+      {
+        std::lock_guard<std::mutex> guard(slabs_lock);
+        slabs.push_back(slab);
+      }
+      reserved_bytes.fetch_add(slab_size, std::memory_order_relaxed);
+      // Any leftover space at the end of the previous slab is simply abandoned
+      cache.bump[sc] = slab;
+      cache.bump_end[sc] = slab + slab_size / size * size;
+    }
+    void* result = cache.bump[sc];
+    cache.bump[sc] += size;
+    return result;
+  }
+
+  utils::per_thread<LocalCache> local_caches;
+  std::array<GlobalList, num_size_classes> global_lists;
+  std::mutex slabs_lock;
+  std::vector<std::byte*> slabs;
+  std::atomic<std::size_t> reserved_bytes;
+};
+
+// Allocator that serves small objects out of a per-thread slab pool
+struct pool_allocator {
+  using statistics = slab_pool::statistics;
+
+  static void* allocate(std::size_t size, std::size_t alignment) {
+    return slab_pool::instance().allocate(size, alignment);
+  }
+
+  static void deallocate(void* p, std::size_t size, std::size_t alignment) {
+    slab_pool::instance().deallocate(p, size, alignment);
+  }
+
+  static statistics get_statistics() {
+    return slab_pool::instance().get_statistics();
+  }
+
+  static void initialize() {
+    slab_pool::instance();
+  }
+};
+
+}  // namespace internal
+}  // namespace cdrc
+
+#endif  // CDRC_INTERNAL_POOL_ALLOCATOR_H
@@ -10,12 +10,15 @@
 #include <atomic>
 #include <memory>
 #include <type_traits>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "../asymmetric_fence.h"
+#include "../background_reclaimer.h"
 #include "../counted_object.h"
 #include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -37,23 +40,85 @@ namespace internal {
 //                  at a time, but makes reclamation slower
 // eject_delay =    The maximum number of deferred ejects that will be held by
 //                  any one worker thread is at most eject_delay * #threads.
+// object_policy =  Customizes the representation and allocation of the managed
+//                  objects. See object_policy.h
+// fence_policy =   How announcements are ordered against scans. Either
+//                  symmetric_fence_policy or asymmetric_fence_policy, which
+//                  makes reads cheaper and scans more expensive. See
+//                  asymmetric_fence.h
 //
-template<typename T, size_t snapshot_slots = 7, size_t eject_delay = 2>
-struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay>> {
+template<typename T, size_t snapshot_slots = 7, size_t eject_delay = 2, typename object_policy = default_object_policy,
+         typename fence_policy = symmetric_fence_policy>
+struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay, object_policy, fence_policy>, object_policy> {
 
-  using base = memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay>>;
+  using base = memory_manager_base<T, acquire_retire<T, snapshot_slots, eject_delay, object_policy, fence_policy>, object_policy>;
 
-  using base::increment_allocations;
-  using base::decrement_allocations;
   using base::increment_ref_cnt;
   using base::decrement_weak_cnt;
   using base::eject;
 
  private:
 
-  using counted_object_t = counted_object<T>;
+  using counted_object_t = counted_object<T, object_policy>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
+  using retired_batch = std::vector<std::pair<counted_ptr_t, RetireType>>;
+  using reclaimer_t = background_reclaimer<acquire_retire, retired_batch>;
+  friend reclaimer_t;
+  friend utils::thread_exit_hook<acquire_retire>;
+
+  // A flat index of the handles that are announced at the time of a scan, and of how
+  // many more deferred ejects of each kind their announcements can protect. Each
+  // thread keeps its own, so that the storage is reused from one scan to the next.
+  //
+  // Since there can be multiple kinds of deferred actions (delayed ejects), each announcement
+  // needs to be able to protect each kind of action, since announcements do not specify which
+  // actions they wish to protect against. Without weak references, only strong decrements
+  // are ever deferred, so each announcement protects just one kind of action.
+  struct announcement_index {
+    std::vector<counted_ptr_t> handles;           // The distinct announced handles, in sorted order
+    std::vector<unsigned int> protections;        // The remaining protections of each kind of action, for each handle
+
+    void build(acquire_retire& ar) {
+      clear();
+      ar.scan_slots([this](auto reserved) { add(reserved); });
+      finish();
+    }
+
+    void clear() {
+      handles.clear();
+      protections.clear();
+    }
+
+    void add(counted_ptr_t reserved) {
+      handles.push_back(reserved);
+    }
+
+    // Build the index from the handles added since it was last cleared
+    void finish() {
+      std::sort(handles.begin(), handles.end());
+      size_t num_distinct = 0;
+      for (size_t i = 0, j = 0; i < handles.size(); i = j) {
+        while (j < handles.size() && handles[j] == handles[i]) j++;
+        handles[num_distinct++] = handles[i];
+        // The first announcement needs to protect up to two actions
+        protections.insert(protections.end(), base::num_retire_types, static_cast<unsigned int>(j - i + 1));
+      }
+      handles.resize(num_distinct);
+    }
+
+    // Use up to count protections of the given action on the given handle. Returns
+    // the number used, i.e., how many of count copies of the action must be deferred
+    size_t consume_protections(counted_ptr_t ptr, RetireType type, size_t count) {
+      auto it = std::lower_bound(handles.begin(), handles.end(), ptr);
+      if (it == handles.end() || *it != ptr) return 0;
+      auto& remaining = protections[(it - handles.begin()) * base::num_retire_types + static_cast<size_t>(type)];
+      auto consumed = std::min<size_t>(remaining, count);
+      remaining -= consumed;
+      return consumed;
+    }
+  };
+
   // Align to cache line boundary to avoid false sharing
   struct alignas(128) LocalSlot {
     std::atomic<counted_ptr_t> announcement;
@@ -67,22 +132,37 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     }
   };
 
+  // The progress of a thread through an incremental reclamation pass, which
+  // applies the unprotected ejects of a batch of deferred ejects in bounded
+  // steps spread across the thread's subsequent retires (see set_reclamation_budget)
+  struct alignas(128) incremental_pass {
+    AlignedVector<std::pair<counted_ptr_t, RetireType>> batch;   // The deferred ejects that were retired before the pass started
+    size_t next_thread{0};         // The next thread whose announcements are to be scanned
+    size_t next_eject{0};          // The next deferred eject in the batch to be applied
+    size_t num_kept{0};            // The number of protected ejects, which are moved to the front of the batch
+    bool active{false};
+    bool scanned{false};           // Whether every announcement has been scanned and indexed
+  };
+
  public:
 
   static acquire_retire& instance() {
-    static acquire_retire ar{utils::num_threads()};
+    static acquire_retire ar;
     return ar;
   }
 
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
-    increment_allocations();
-    return new counted_object_t(std::forward<Args>(args)...);
+    return this->template allocate_object<counted_object_t>(std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    return this->template allocate_object_with<counted_object_t>(alloc, std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete p;
-    decrement_allocations();
+    this->deallocate_object(p);
   }
 
   // An RAII wrapper around an acquired handle. Automatically
@@ -144,12 +224,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     std::atomic<counted_ptr_t> *slot;
   };
 
-  explicit acquire_retire(size_t num_threads) :
-      base(num_threads),
-      announcement_slots(num_threads),
-      in_progress(num_threads),
-      deferred_destructs(num_threads),
-      amortized_work(num_threads) {}
+  acquire_retire() = default;
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
@@ -157,7 +232,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     U result;
     do {
       result = p->load(std::memory_order_seq_cst);
-      announcement_slots[id].announcement.store(static_cast<counted_ptr_t>(result), std::memory_order_seq_cst);
+      fence_policy::announce(announcement_slots[id].announcement, static_cast<counted_ptr_t>(result));
     } while (p->load(std::memory_order_seq_cst) != result);
     return acquired_pointer<U>(result, &announcement_slots[id].announcement);
   }
@@ -167,8 +242,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
   template<typename U>
   [[nodiscard]] acquired_pointer<U> reserve(U p) {
     auto id = utils::threadID.getTID();
-    announcement_slots[id].announcement.store(static_cast<counted_ptr_t>(p),
-                                              std::memory_order_seq_cst); // TODO: memory_order_release could be sufficient here
+    fence_policy::announce(announcement_slots[id].announcement, static_cast<counted_ptr_t>(p)); // TODO: memory_order_release could be sufficient here
     return acquired_pointer<U>(p, &announcement_slots[id].announcement);
   }
 
@@ -200,7 +274,7 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
         slot->store(nullptr, std::memory_order_release);
         return acquired_pointer<U>(result, nullptr);
       }
-      slot->store(static_cast<counted_ptr_t>(result), std::memory_order_seq_cst);
+      fence_policy::announce(*slot, static_cast<counted_ptr_t>(result));
     } while (p->load(std::memory_order_seq_cst) != result);
     return acquired_pointer<U>(result, slot);
   }
@@ -228,17 +302,55 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
     work_toward_deferred_decrements(1);
   }
 
+  // Start performing deferred ejects on num_workers dedicated background threads.
+  // Application threads then hand their deferred ejects over to the background
+  // threads, unless more than queue_capacity batches are already waiting, in
+  // which case they perform them inline as usual. The background threads need
+  // thread IDs of their own. Must not be called concurrently with other operations.
+  void start_background_reclamation(size_t num_workers = 1, size_t queue_capacity = 64) {
+    assert(reclaimer == nullptr);
+    abandon_incremental_passes();
+    reclaimer = std::make_unique<reclaimer_t>(*this, num_workers, queue_capacity);
+  }
+
+  // Perform deferred ejects incrementally, with at most budget units of work per
+  // retire, instead of applying the whole deferred list of a thread at once. A
+  // unit of work is the scan of one thread's announcements, or a single eject.
+  // Each retire adds one deferred eject, so with a budget of at least two, a pass
+  // over a batch finishes before as many new ejects have been deferred as the
+  // batch and the announcements together contain, and the number of deferred
+  // ejects remains bounded. A budget of zero, the default, disables incremental
+  // reclamation. Not used while background reclamation is running. Must not be
+  // called concurrently with other operations.
+  void set_reclamation_budget(size_t budget) {
+    assert(budget == 0 || budget >= 2);
+    reclamation_budget = budget;
+    if (budget == 0) abandon_incremental_passes();
+  }
+
+  // Stop the background threads. Any ejects that they had not yet performed are
+  // taken over by the calling thread. Must not be called concurrently with other operations.
+  void stop_background_reclamation() {
+    assert(reclaimer != nullptr);
+    auto leftovers = reclaimer->stop();
+    reclaimer.reset();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].insert(deferred_destructs[id].end(), leftovers.begin(), leftovers.end());
+  }
+
   // Perform any remaining deferred destruction. Need to be very careful
   // about additional objects being queued for deferred destruction by
   // an object that was just destructed.
   ~acquire_retire() {
-    in_progress.assign(in_progress.size(), true);
+    if (reclaimer != nullptr) stop_background_reclamation();
+    abandon_incremental_passes();
+    in_progress.for_each([](auto& flag) { flag = true; });
 
     // Loop because the destruction of one object could trigger the deferred
     // destruction of another object (possibly even in another thread), and
     // so on recursively.
-    while (std::any_of(deferred_destructs.begin(), deferred_destructs.end(),
-                       [](const auto &v) { return !v.empty(); })) {
+    while (!orphans.empty() || deferred_destructs.any_of([](const auto &v) { return !v.empty(); }) ||
+           this->destructions_pending()) {
 
       // Move all of the contents from the deferred destruction lists
       // into a single local list. We don't want to just iterate the
@@ -246,15 +358,17 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
       // deferred destruction to be added to one of the lists, which
       // would invalidate its iterators
       std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
-      for (auto &v : deferred_destructs) {
+      orphans.adopt([&](const auto& x) { destructs.push_back(x); });
+      deferred_destructs.for_each([&](auto &v) {
         destructs.insert(destructs.end(), v.begin(), v.end());
         v.clear();
-      }
+      });
 
       // Perform all of the pending deferred destructions
-      for (const auto& x : destructs) {
-        eject(x.first, x.second);
-      }
+      this->eject_coalesced(destructs);
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
     }
   }
 
@@ -262,74 +376,168 @@ struct acquire_retire : public memory_manager_base<T, acquire_retire<T, snapshot
   // Apply the function f to every currently announced handle
   template<typename F>
   void scan_slots(F &&f) {
-    std::atomic_thread_fence(std::memory_order_seq_cst);
-    for (const auto &announcement_slot : announcement_slots) {
-      auto x = announcement_slot.announcement.load(std::memory_order_seq_cst);
-      if (x != nullptr) f(x);
-      for (const auto &free_slot : announcement_slot.snapshot_announcements) {
-        auto y = free_slot.load(std::memory_order_seq_cst);
-        if (y != nullptr) f(y);
-      }
+    fence_policy::before_scan();
+    announcement_slots.for_each([&](const auto &announcement_slot) { scan_slot(announcement_slot, f); });
+  }
+
+  // Apply the function f to every handle announced in the given thread's slots
+  template<typename F>
+  static void scan_slot(const LocalSlot& announcement_slot, F &&f) {
+    auto x = announcement_slot.announcement.load(std::memory_order_seq_cst);
+    if (x != nullptr) f(x);
+    for (const auto &free_slot : announcement_slot.snapshot_announcements) {
+      auto y = free_slot.load(std::memory_order_seq_cst);
+      if (y != nullptr) f(y);
     }
   }
 
   void work_toward_deferred_decrements(size_t work = 1) {
     auto id = utils::threadID.getTID();
     amortized_work[id] = amortized_work[id] + work;
-    auto threshold = std::max<size_t>(30, eject_delay * amortized_work.size());  // Always attempt at least 30 ejects
+    auto threshold = std::max<size_t>(30, eject_delay * utils::num_thread_ids());  // Always attempt at least 30 ejects
+    if (reclamation_budget != 0 && reclaimer == nullptr) {
+      if (!in_progress[id]) work_incrementally(id, reclamation_budget * work, threshold);
+      return;
+    }
     while (!in_progress[id] && amortized_work[id] >= threshold) {
       amortized_work[id] = 0;
+      orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); });  // take over those of exited threads
       if (deferred_destructs[id].size() == 0) break; // nothing to collect
+      if (reclaimer != nullptr && reclaimer->submit(deferred_destructs[id])) break; // handed off to the background threads
       in_progress[id] = true;
       auto deferred = AlignedVector<std::pair<counted_ptr_t,RetireType>>(std::move(deferred_destructs[id]));
-
-      // We need a custom hash because the standard doesn't know how to hash enum types...
-      struct Hash {
-        std::size_t operator()(std::pair<counted_ptr_t, RetireType> t) const {
-          return std::hash<counted_ptr_t>{}(t.first) ^ std::hash<std::size_t>{}(static_cast<std::size_t>(t.second));
-        }
-      };
-
-      // Since there can be multiple kinds of deferred actions (delayed ejects), each announcement
-      // needs to be able to protect each kind of action, since announcements do not specify which
-      // actions they wish to protect against.
-      std::unordered_map<std::pair<counted_ptr_t, RetireType>, unsigned int, Hash> announced;
-      scan_slots([&](auto reserved) {
-        for (size_t i = 0; i < num_retire_types; i++) {
-          // The first announcement needs to protect up to two actions
-          auto& cnt = announced[std::make_pair(reserved, static_cast<RetireType>(i))];
-          if (cnt) cnt++;
-          else cnt = 2;
-        }
-      });
-
-      // For a given deferred decrement, we first check if it is announced, and, if so,
-      // we defer it again. If it is not announced, it can be safely applied. If an
-      // object is deferred / announced multiple times, each announcement only protects
-      // against one of the deferred decrements, so for each object, the amount of
-      // decrements applied in total will be #deferred - #announced
-      auto f = [this, &announced](const auto& x) {
-        auto it = announced.find(x);
-        if (it == announced.end()) {
-          eject(x.first, x.second);
-          return true;
-        } else {
-          if (--(it->second) == 0) announced.erase(it);
-          return false;
-        }
-      };
-
-      // Remove the deferred decrements that are successfully applied
-      deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
+      eject_unprotected(deferred);
       deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
       in_progress[id] = false;
     }
   }
 
-  std::vector<LocalSlot> announcement_slots;          // Announcement array slots
-  std::vector<AlignedBool> in_progress;               // Local flags to prevent reentrancy while destructing
-  std::vector<AlignedVector<std::pair<counted_ptr_t, RetireType>>> deferred_destructs;   // Thread-local lists of pending deferred destructs
-  std::vector<AlignedInt> amortized_work;             // Amortized work to pay for ejecting deferred destructs
+  // Perform up to budget units of work toward the calling thread's incremental
+  // pass, starting a new pass whenever enough deferred ejects have built up
+  void work_incrementally(size_t id, size_t budget, size_t threshold) {
+    auto& pass = incremental_passes[id];
+    auto& announced = announcement_indices[id];
+    in_progress[id] = true;
+    while (budget > 0) {
+      if (!pass.active) {
+        orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); });  // take over those of exited threads
+        if (deferred_destructs[id].size() < threshold) break;
+        // Only the ejects that were retired before the fence are covered by the scan
+        std::swap(pass.batch, deferred_destructs[id]);
+        pass.next_thread = pass.next_eject = pass.num_kept = 0;
+        pass.active = true;
+        pass.scanned = false;
+        announced.clear();
+        fence_policy::before_scan();
+      }
+      else if (pass.next_thread < utils::num_thread_ids()) {
+        scan_slot(announcement_slots[pass.next_thread++], [&](auto reserved) { announced.add(reserved); });
+      }
+      else if (!pass.scanned) {
+        announced.finish();
+        pass.scanned = true;
+      }
+      else if (pass.next_eject < pass.batch.size()) {
+        auto [ptr, type] = pass.batch[pass.next_eject++];
+        if (announced.consume_protections(ptr, type, 1) == 1) pass.batch[pass.num_kept++] = std::make_pair(ptr, type);
+        else eject(ptr, type);
+      }
+      else {
+        // The ejects that were protected are retried by the next pass
+        deferred_destructs[id].insert(deferred_destructs[id].end(), pass.batch.begin(), pass.batch.begin() + pass.num_kept);
+        pass.batch.clear();
+        pass.active = false;
+        continue;
+      }
+      budget--;
+    }
+    in_progress[id] = false;
+  }
+
+  // Return the ejects of every unfinished incremental pass to the deferred
+  // list of its thread. Must not be called concurrently with other operations.
+  void abandon_incremental_passes() {
+    for (size_t id = 0; id < utils::num_thread_ids(); id++) abandon_incremental_pass(id);
+  }
+
+  void abandon_incremental_pass(size_t id) {
+    auto& pass = incremental_passes[id];
+    if (!pass.active) return;
+    auto& deferred = deferred_destructs[id];
+    deferred.insert(deferred.end(), pass.batch.begin(), pass.batch.begin() + pass.num_kept);
+    deferred.insert(deferred.end(), pass.batch.begin() + pass.next_eject, pass.batch.end());
+    pass.batch.clear();
+    pass.active = false;
+  }
+
+  // Perform the deferred ejects in the batch on a background thread
+  void reclaim_in_background(retired_batch& batch) {
+    auto id = utils::threadID.getTID();
+    in_progress[id] = true;
+    eject_unprotected(batch);
+    // Ejects may cause further ejects to be deferred by this thread, which are kept for the next pass
+    batch.insert(batch.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    in_progress[id] = false;
+  }
+
+  // Called by each thread as it exits. Performs the deferred ejects of the thread
+  // that are safe, and leaves the rest on the orphan list for other threads to adopt
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    if (in_progress[id]) return found_work;
+    abandon_incremental_pass(id);
+    if (deferred_destructs[id].empty()) return found_work;
+    in_progress[id] = true;
+    auto deferred = retired_batch(std::move(deferred_destructs[id]));
+    deferred_destructs[id].clear();
+    eject_unprotected(deferred);
+    deferred.insert(deferred.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    amortized_work[id] = 0;
+    in_progress[id] = false;
+    orphans.push(std::move(deferred));
+    return true;
+  }
+
+  // Perform every deferred eject in the given list whose object is not currently
+  // announced, and remove it from the list
+  void eject_unprotected(retired_batch& deferred) {
+    auto& announced = announcement_indices[utils::threadID.getTID()];
+    announced.build(*this);
+
+    // For a given deferred decrement, we first check if it is announced, and, if so,
+    // we defer it again. If it is not announced, it can be safely applied. If an
+    // object is deferred / announced multiple times, each announcement only protects
+    // against one of the deferred decrements, so for each object, the amount of
+    // decrements applied in total will be #deferred - #announced. Sorting the list
+    // groups these together, so that they are applied with a single decrement
+    std::sort(deferred.begin(), deferred.end());
+    auto kept = deferred.begin();
+    for (auto it = deferred.begin(); it != deferred.end();) {
+      auto [ptr, type] = *it;
+      auto next = std::find_if(it, deferred.end(), [&](const auto& x) { return x != *it; });
+      size_t count = next - it;
+      size_t num_protected = announced.consume_protections(ptr, type, count);
+      if (num_protected < count) this->eject(ptr, type, count - num_protected);
+      kept = std::fill_n(kept, num_protected, std::make_pair(ptr, type));
+      it = next;
+    }
+
+    // Remove the deferred decrements that are successfully applied
+    deferred.erase(kept, deferred.end());
+  }
+
+  utils::per_thread<LocalSlot> announcement_slots;          // Announcement array slots
+  utils::per_thread<AlignedBool> in_progress;               // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedVector<std::pair<counted_ptr_t, RetireType>>> deferred_destructs;   // Thread-local lists of pending deferred destructs
+  utils::per_thread<AlignedInt> amortized_work;             // Amortized work to pay for ejecting deferred destructs
+  utils::per_thread<utils::Padded<announcement_index>> announcement_indices;   // Thread-local indices of the announced handles
+  utils::per_thread<incremental_pass> incremental_passes;   // Thread-local progress of incremental reclamation
+  size_t reclamation_budget{0};                       // Units of work per retire of incremental reclamation, or zero if disabled
+  std::unique_ptr<reclaimer_t> reclaimer;             // Background threads that perform deferred ejects, if enabled
+  orphan_list<std::pair<counted_ptr_t, RetireType>> orphans;      // Deferred ejects left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire> exit_hook{*this};
 };
 
 }  // namespace internal
@@ -0,0 +1,495 @@
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_CRYSTALLINE_H
+#define CDRC_SMR_ACQUIRE_RETIRE_CRYSTALLINE_H
+
+#include <cassert>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../counted_object.h"
+#include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
+#include "../utils.h"
+
+#include "acquire_retire_hyaline.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// Keeps track of the threads that are inside of a guard for Crystalline, a
+// wait-free variant of Hyaline-S. Batches of retired objects are handed to the
+// reservation lists of the threads inside of a guard, using the same nodes and
+// batches as Hyaline, and each read announces the era in which it took place.
+//
+// Hyaline retries the CAS that inserts a batch into a reservation list whenever
+// another thread changes the list, and Hyaline-S retries its reads for as long
+// as the era keeps moving. Here, a batch is inserted into each list with a single
+// exchange, after which the node is linked to the rest of the list. If the owner
+// of the list leaves its guard in the meantime, it abandons the rest of the list
+// to the inserting thread, which then traverses it instead. A read that keeps
+// failing to announce the current era asks for help, and the threads that advance
+// the era announce the next era on its behalf before doing so, so that a read
+// completes after at most one attempt per thread that is advancing the era.
+struct crystalline_tracker {
+
+  using Node = hyaline_tracker::Node;
+  using Batch = hyaline_tracker::Batch;
+
+  // Left in the link of a node that has been inserted into a list, until the
+  // node is linked to the rest of the list
+  inline static Node* const pending = reinterpret_cast<Node*>(0x1);
+
+  // Left in the link of a pending node by the owner of the list, to hand the
+  // rest of the list over to the thread that inserted the node
+  inline static Node* const abandoned = reinterpret_cast<Node*>(0x2);
+
+  struct alignas(128) Reservation {
+    std::atomic<Node*> list;
+    std::atomic<bool> active;       // Whether the thread is inside of a guard
+    std::atomic<uint64_t> era;      // The latest era in which the thread read a handle
+    std::atomic<bool> needs_help;   // Whether the thread is waiting for help to announce an era
+    Reservation() : list(nullptr), active(false), era(0), needs_help(false) {}
+  };
+
+  static crystalline_tracker &instance() {
+    static crystalline_tracker tracker;
+    return tracker;
+  }
+
+  bool begin_critical_section() {
+    auto id = utils::threadID.getTID();
+    if (critical_section[id]) {
+      return false;
+    } else {
+      rsrv[id].active.store(true);
+      critical_section[id] = true;
+      return true;
+    }
+  }
+
+  void end_critical_section() {
+    auto id = utils::threadID.getTID();
+    assert(critical_section[id]);
+    rsrv[id].active.store(false);
+    traverse(rsrv[id].list.exchange(nullptr));
+    critical_section[id] = false;
+  }
+
+  bool in_critical_section() {
+    auto id = utils::threadID.getTID();
+    return critical_section[id];
+  }
+
+  uint64_t get_current_era() {
+    return global_era.load();
+  }
+
+  // Advance the global era, first announcing the next era for every thread that
+  // asked for help, so that their reads succeed while it is current
+  void advance_era() {
+    auto e = global_era.load();
+    if (pending_help.load() > 0) {
+      for (size_t i = 0; i < utils::num_thread_ids(); i++) {
+        if (rsrv[i].needs_help.load()) raise_era(rsrv[i].era, e + 1);
+      }
+    }
+    global_era.compare_exchange_strong(e, e + 1);
+  }
+
+  // Read the handle in p, making sure that the calling thread's reservation
+  // announces an era no earlier than the one in which it was read
+  template<typename U>
+  U protect(const std::atomic<U> *p) {
+    auto& r = rsrv[utils::threadID.getTID()];
+    U result;
+    for (int i = 0; i < fast_path_attempts; i++) {
+      if (try_protect(r, p, result)) return result;
+    }
+    r.needs_help.store(true);
+    pending_help.fetch_add(1);
+    while (!try_protect(r, p, result)) {}
+    r.needs_help.store(false);
+    pending_help.fetch_sub(1);
+    return result;
+  }
+
+  // Insert the batch into the reservation lists of the first num_slots thread IDs.
+  // The batch must contain more than num_slots nodes. Threads whose IDs are handed
+  // out after num_slots was read can not reach the objects in the batch, and nor
+  // can threads that are outside of a guard, or whose announced era is earlier
+  // than every birth era in the batch
+  void add_batch(const Batch& batch, size_t num_slots) {
+    assert(batch.counter > num_slots);
+    hyaline_tracker::set_link(batch.refs, batch.first, hyaline_tracker::get_type(batch.refs));
+    Node* curr = batch.first;
+    int64_t cnt = -hyaline_tracker::REFC_PROTECT;
+    for(size_t i = 0; i < num_slots; i++) {
+      if(rsrv[i].active.load() && rsrv[i].era.load() >= batch.min_birth) {
+        std::atomic_ref<Node*> link(curr->next);
+        link.store(pending, std::memory_order_relaxed);
+        Node* prev = rsrv[i].list.exchange(curr);
+        Node* expected = pending;
+        if(!link.compare_exchange_strong(expected, prev)) {
+          assert(expected == abandoned);
+          traverse(prev);
+        }
+        cnt++;
+      }
+      curr = curr->bnext;
+    }
+    if(batch.refs->refc.fetch_add(cnt) == -cnt) // Finish
+      free_batch(batch.refs);
+  }
+
+  crystalline_tracker() {
+    hyaline_tracker::instance();  // touch the tracker whose node pools we use, since it must be destructed after this
+  }
+
+  crystalline_tracker(const crystalline_tracker&) = delete;
+  crystalline_tracker& operator=(const crystalline_tracker&) = delete;
+
+  utils::per_thread<utils::Padded<bool>> critical_section;
+  utils::per_thread<Reservation> rsrv;
+
+private:
+  friend utils::thread_exit_hook<crystalline_tracker>;
+
+  constexpr static int fast_path_attempts = 16;     // Number of attempts to announce an era before asking for help
+
+  // Make one attempt to read the handle in p in an era that is announced. The
+  // announcement is read before the handle, so that it was visible to any
+  // thread that retires the object after it was read
+  template<typename U>
+  bool try_protect(Reservation& r, const std::atomic<U> *p, U& result) {
+    auto announced = r.era.load();
+    result = p->load(std::memory_order_seq_cst);
+    auto current = global_era.load();
+    if (announced >= current) return true;
+    raise_era(r.era, current);
+    return false;
+  }
+
+  static void raise_era(std::atomic<uint64_t>& era, uint64_t e) {
+    auto announced = era.load();
+    while (announced < e && !era.compare_exchange_weak(announced, e)) {}
+  }
+
+  void traverse(Node* next) {
+    while(next != nullptr) {
+      Node* curr = next;
+      std::atomic_ref<Node*> link(curr->next);
+      next = link.load();
+      if(next == pending && link.compare_exchange_strong(next, abandoned)) next = nullptr;
+      assert(next != pending && next != abandoned);
+      Node* refs = hyaline_tracker::get_link(curr);
+      if(refs->refc.fetch_add(-1) == 1) free_batch(refs);
+    }
+  }
+
+  void free_batch(Node* refs) {
+    auto eject = refs->eject;
+    Node* n = hyaline_tracker::get_link(refs);
+    do {
+      Node* node = n;
+      n = n->bnext;
+      eject(node->obj, hyaline_tracker::get_type(node));
+      hyaline_tracker::instance().deallocate_node(node);
+    } while(n != nullptr);
+  }
+
+  // A batch can be inserted into the list of a thread that has just left its
+  // guard, after the thread emptied it. The thread empties it again when it next
+  // leaves a guard, or here, when it exits
+  bool on_thread_exit(size_t id) {
+    Node* list = rsrv[id].list.exchange(nullptr);
+    traverse(list);
+    return list != nullptr;
+  }
+
+  std::atomic<uint64_t> global_era{1};
+  std::atomic<int> pending_help{0};                 // Number of threads that are waiting for help
+  utils::thread_exit_hook<crystalline_tracker> exit_hook{*this};
+};
+
+}  // namespace internal
+
+struct crystalline_guard {
+  crystalline_guard() : engaged(internal::crystalline_tracker::instance().begin_critical_section()) {}
+
+  ~crystalline_guard() {
+    if (engaged) { internal::crystalline_tracker::instance().end_critical_section(); }
+  }
+
+  crystalline_guard(const crystalline_guard &) = delete;
+
+  crystalline_guard(crystalline_guard &&) = delete;
+
+  crystalline_guard &operator=(const crystalline_guard &) = delete;
+
+  crystalline_guard &operator=(crystalline_guard &&) = delete;
+
+private:
+  bool engaged;
+};
+
+template<typename F>
+std::invoke_result_t<F> with_crystalline_guard(F&& f) {
+  crystalline_guard g;
+  return std::invoke(std::forward<F>(f));
+}
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses Crystalline, a wait-free variant of Hyaline-S.
+// As with Hyaline, the user is responsible for acquiring a "crystalline_guard"
+// before performing any reads or writes to the shared pointer, like so
+//
+//   {
+//     cdrc::crystalline_guard g;
+//     // critical code
+//   }
+//
+// As with Hyaline-S, every object is stamped with the era in which it was
+// created, and a batch is only handed to the threads whose announced era is no
+// earlier than the earliest birth era in the batch, so a thread that stalls
+// inside of a guard only holds back the batches of objects that existed when it
+// last read. Unlike Hyaline-S, reads and retires both complete in a bounded
+// number of steps, however the other threads are scheduled.
+// See crystalline_tracker for how.
+//
+// T =               The underlying type of the object being protected
+// batch_size        accumulate (batch_size*#threads)+1 nodes before announcing batch
+// epoch_frequency = How often to advance the global era. More often (lower value)
+//                   will reduce memory usage, but makes announcements more frequent
+// object_policy =   Customizes the representation and allocation of the managed
+//                   objects. See object_policy.h
+//
+template<typename T, size_t batch_size = 2, size_t epoch_frequency = 40, typename object_policy = default_object_policy>
+struct acquire_retire_crystalline : public memory_manager_base<T, acquire_retire_crystalline<T, batch_size, epoch_frequency, object_policy>, object_policy> {
+
+  using base = memory_manager_base<T, acquire_retire_crystalline<T, batch_size, epoch_frequency, object_policy>, object_policy>;
+
+  using Node = hyaline_tracker::Node;
+  using Batch = hyaline_tracker::Batch;
+
+private:
+  using counted_object_t = counted_object<T, object_policy>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+
+public:
+
+  static acquire_retire_crystalline& instance() {
+    static acquire_retire_crystalline ar;
+    return ar;
+  }
+
+  struct birth_stamp {
+    uint64_t birthTS;
+  };
+
+  // Augments a reference-counted object with a birth timestamp field that is
+  // initialized with the value of the current era when the object is created.
+  // The timestamp precedes the object, so that the elements of an array still
+  // directly follow it
+  struct stamped_counted_object : public birth_stamp, public counted_object_t {
+    template<typename... Args>
+    explicit stamped_counted_object(uint64_t t, Args&&... args)
+      : birth_stamp{t}, counted_object_t(std::forward<Args>(args)...) {}
+  };
+
+  uint64_t get_birth_timestamp(counted_ptr_t p) {
+    return static_cast<stamped_counted_object*>(p)->birthTS;
+  }
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object<stamped_counted_object>(crystalline_tracker::instance().get_current_era(), std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object_with<stamped_counted_object>(alloc, crystalline_tracker::instance().get_current_era(), std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    this->deallocate_object(static_cast<stamped_counted_object*>(p));
+  }
+
+  template<typename U>
+  using acquired_pointer = basic_acquired_pointer<U>;
+
+  acquire_retire_crystalline()
+    {
+      crystalline_tracker::instance();  // touch the tracker to force it to initialize before this object,
+                                        // since it must be destructed after it (see acquire_retire_hyaline)
+    }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    return acquired_pointer<U>(crystalline_tracker::instance().protect(p));
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    return acquired_pointer<U>(p);
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return acquired_pointer<U>();
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    auto ptr = crystalline_tracker::instance().protect(p);
+    if (ptr != nullptr && ptr->get_use_count() == 0) ptr = nullptr;
+    return {ptr};
+  }
+
+  void release() {}
+
+  void retire(counted_ptr_t p, RetireType type) {
+    auto id = utils::threadID.getTID();
+    if(p == nullptr) {return;}
+
+    Batch& batch = local_batch[id];
+    add_to_batch(batch, p, type);
+    // Must have num_slots+1 nodes to insert to
+    // num_slots lists, exit if do not have enough
+    while(!in_progress[id]) {
+      auto num_slots = utils::num_thread_ids();
+      if (batch.counter <= batch_size*num_slots) break;
+      const Batch batch_copy = batch;
+      batch.first = nullptr;
+      batch.counter = 0;
+      in_progress[id] = true;
+      crystalline_tracker::instance().add_batch(batch_copy, num_slots);
+      in_progress[id] = false;
+      // Take over the partial batches of threads that have exited
+      orphans.adopt([&](const auto& x) { add_to_batch(batch, x.first, x.second); });
+    }
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_crystalline() {
+    auto id = utils::threadID.getTID();
+    do {
+      orphans.adopt([&](const auto& x) { add_to_batch(local_batch[id], x.first, x.second); });
+      for (size_t i = 0; i < utils::num_thread_ids(); i++) {
+        assert(!crystalline_tracker::instance().rsrv[i].active.load());
+        while(local_batch[i].first != nullptr) {
+          Batch& batch = local_batch[i];
+          const Batch batch_copy = batch;
+          batch.first = nullptr;
+          batch.counter = 0;
+          Node* node = batch_copy.first;
+          while(node != nullptr) {
+            Node* next = node->bnext;
+            void* obj = node->obj;
+            auto type = hyaline_tracker::get_type(node);
+            in_progress[id] = true;
+            this->eject(static_cast<counted_ptr_t>(obj), type);
+            in_progress[id] = false;
+            hyaline_tracker::instance().deallocate_node(node);
+            if(node == batch_copy.refs) break;
+            node = next;
+          }
+        }
+      }
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
+    } while(local_batch[id].first != nullptr || !orphans.empty() || this->destructions_pending());
+  }
+
+private:
+  friend utils::thread_exit_hook<acquire_retire_crystalline>;
+
+  // Performs a deferred eject on behalf of the tracker, which only knows the object by its address
+  static void eject_retired(void* obj, RetireType type) {
+    instance().eject(static_cast<counted_ptr_t>(obj), type);
+  }
+
+  void add_to_batch(Batch& batch, counted_ptr_t p, RetireType type) {
+    Node* node = hyaline_tracker::instance().allocate_node(static_cast<void*>(p));
+    auto birth = get_birth_timestamp(p);
+    if(!batch.first) { // the REFS node
+      batch.refs = node;
+      batch.min_birth = birth;
+      node->refc.store(hyaline_tracker::REFC_PROTECT, std::memory_order_release);
+      node->eject = &eject_retired;
+      hyaline_tracker::set_link(node, nullptr, type);
+    } else { // SLOT nodes
+      batch.min_birth = std::min(batch.min_birth, birth);
+      hyaline_tracker::set_link(node, batch.refs, type); // points to REFS
+      node->bnext = batch.first;
+    }
+    batch.first = node;
+    batch.counter++;
+  }
+
+  void work_toward_advancing_epoch(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    epoch_work[id] = epoch_work[id] + work;
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
+      epoch_work[id] = 0;
+      crystalline_tracker::instance().advance_era();
+    }
+  }
+
+  // Called by each thread as it exits. The thread's partial batch is too small to
+  // be inserted into the reservation lists, so it is left on the orphan list, from
+  // which other threads add its objects to their own batches
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    Batch& batch = local_batch[id];
+    if (in_progress[id] || batch.first == nullptr) return found_work;
+    std::vector<std::pair<counted_ptr_t, RetireType>> orphaned;
+    Node* node = batch.first;
+    while(node != nullptr) {
+      Node* next = node->bnext;
+      orphaned.emplace_back(static_cast<counted_ptr_t>(node->obj), hyaline_tracker::get_type(node));
+      bool last = (node == batch.refs);
+      hyaline_tracker::instance().deallocate_node(node);
+      if(last) break;
+      node = next;
+    }
+    batch.first = nullptr;
+    batch.counter = 0;
+    orphans.push(std::move(orphaned));
+    return true;
+  }
+
+  alignas(128) utils::per_thread<Batch> local_batch;
+  utils::per_thread<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedInt> epoch_work;                           // Amortized work to pay for advancing the era
+  orphan_list<std::pair<counted_ptr_t, RetireType>> orphans;          // Partial batches left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_crystalline> exit_hook{*this};
+};
+
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif // CDRC_SMR_ACQUIRE_RETIRE_CRYSTALLINE_H
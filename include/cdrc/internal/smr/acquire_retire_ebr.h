@@ -2,19 +2,24 @@
 #ifndef CDRC_SMR_ACQUIRE_RETIRE_EBR_H
 #define CDRC_SMR_ACQUIRE_RETIRE_EBR_H
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <memory>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "../background_reclaimer.h"
 #include "../counted_object.h"
 #include "../epoch_tracker.h"
 #include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -35,44 +40,55 @@ namespace internal {
 //     // critical code
 //   }
 //
+// Each thread keeps its deferred ejects in a small ring of limbo bags, one
+// for each epoch in which it recently retired something. The global epoch is
+// only advanced once every thread in a critical section has announced the
+// current epoch, at which point everything retired in earlier epochs becomes
+// safe, so a whole bag is found to be safe with a single comparison rather
+// than by checking each of its ejects against the announcements.
+//
 // T =               The underlying type of the object being protected
-// epoch_frequency = How often to update the global epoch. More often (lower value)
-//                   will reduce performance but decrease memory usage.
+// epoch_frequency = How often to attempt to advance the global epoch. More often
+//                   (lower value) will reduce performance but decrease memory usage.
 // eject_delay =     The maximum number of deferred ejects that will be held by
 //                   any one worker thread is at most eject_delay * #threads.
+// object_policy =   Customizes the representation and allocation of the managed
+//                   objects. See object_policy.h
 //
-template<typename T, size_t epoch_frequency = 10, size_t eject_delay = 2>
-struct acquire_retire_ebr : public memory_manager_base<T, acquire_retire_ebr<T>> {
+template<typename T, size_t epoch_frequency = 10, size_t eject_delay = 2, typename object_policy = default_object_policy>
+struct acquire_retire_ebr : public memory_manager_base<T, acquire_retire_ebr<T, epoch_frequency, eject_delay, object_policy>, object_policy> {
 
-  using base = memory_manager_base<T, acquire_retire_ebr<T>>;
+  using base = memory_manager_base<T, acquire_retire_ebr<T, epoch_frequency, eject_delay, object_policy>, object_policy>;
 
-  using base::increment_allocations;
-  using base::decrement_allocations;
   using base::increment_ref_cnt;
   using base::eject;
   using base::decrement_weak_cnt;
 
 private:
-  using counted_object_t = counted_object<T>;
+  using counted_object_t = counted_object<T, object_policy>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
 public:
 
   static acquire_retire_ebr& instance() {
-    static acquire_retire_ebr ar{utils::num_threads()};
+    static acquire_retire_ebr ar;
     return ar;
   }
 
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
-    increment_allocations();
     work_toward_advancing_epoch(1);
-    return new counted_object_t(std::forward<Args>(args)...);
+    return this->template allocate_object<counted_object_t>(std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object_with<counted_object_t>(alloc, std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete p;
-    decrement_allocations();
+    this->deallocate_object(p);
   }
 
   struct RetiredObj {
@@ -83,13 +99,7 @@ public:
   template<typename U>
   using acquired_pointer = basic_acquired_pointer<U>;
 
-  explicit acquire_retire_ebr(size_t num_threads_) :
-    base(num_threads_),
-    num_threads(num_threads_),
-    in_progress(num_threads),
-    deferred_destructs(num_threads),
-    eject_work(num_threads),
-    epoch_work(num_threads) {}
+  acquire_retire_ebr() = default;
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
@@ -121,21 +131,53 @@ public:
 
   void retire(counted_ptr_t p, RetireType type) {
     auto id = utils::threadID.getTID();
-    deferred_destructs[id].emplace_back(p, epoch_tracker::instance().get_current_epoch(), type);
+    auto epoch = epoch_tracker::instance().get_current_epoch();
+    auto& bag = limbo[id][epoch % num_bags];
+    if (bag.epoch != epoch) {
+      // The bag was filled at least num_bags epochs ago, so its ejects are normally safe
+      // by now. If they are not, they stay in the bag, which is then reused for this epoch
+      if (bag.epoch < epoch_tracker::instance().get_safe_epoch()) drain(id, bag);
+      bag.epoch = epoch;
+    }
+    bag.ejects.emplace_back(p, epoch, type);
     work_toward_ejects(1);
   }
 
+  // Start performing deferred ejects on num_workers dedicated background threads.
+  // Application threads then hand their deferred ejects over to the background
+  // threads, unless more than queue_capacity batches are already waiting, in
+  // which case they perform them inline as usual. The background threads need
+  // thread IDs of their own. Must not be called concurrently with other operations.
+  void start_background_reclamation(size_t num_workers = 1, size_t queue_capacity = 64) {
+    assert(reclaimer == nullptr);
+    reclaimer = std::make_unique<reclaimer_t>(*this, num_workers, queue_capacity);
+  }
+
+  // Stop the background threads. Any ejects that they had not yet performed are
+  // taken over by the calling thread. Must not be called concurrently with other operations.
+  void stop_background_reclamation() {
+    assert(reclaimer != nullptr);
+    auto leftovers = reclaimer->stop();
+    reclaimer.reset();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].insert(deferred_destructs[id].end(), leftovers.begin(), leftovers.end());
+  }
+
   // Perform any remaining deferred destruction. Need to be very careful
   // about additional objects being queued for deferred destruction by
   // an object that was just destructed.
   ~acquire_retire_ebr() {
-    in_progress.assign(in_progress.size(), true);
+    if (reclaimer != nullptr) stop_background_reclamation();
+    in_progress.for_each([](auto& flag) { flag = true; });
 
     // Loop because the destruction of one object could trigger the deferred
     // destruction of another object (possibly even in another thread), and
     // so on recursively.
-    while (std::any_of(deferred_destructs.begin(), deferred_destructs.end(),
-                       [](const auto &v) { return !v.empty(); })) {
+    auto in_limbo = [](const auto& bags) {
+      return std::any_of(bags.begin(), bags.end(), [](const auto& bag) { return !bag.ejects.empty(); });
+    };
+    while (!orphans.empty() || deferred_destructs.any_of([](const auto &v) { return !v.empty(); }) || limbo.any_of(in_limbo) ||
+           this->destructions_pending()) {
 
       // Move all of the contents from the deferred destruction lists
       // into a single local list. We don't want to just iterate the
@@ -143,62 +185,149 @@ public:
       // deferred destruction to be added to one of the lists, which
       // would invalidate its iterators
       std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
-      for (auto &v : deferred_destructs) {
+      orphans.adopt([&](const auto& x) { destructs.emplace_back(x.obj, x.type); });
+      deferred_destructs.for_each([&](auto &v) {
         for (const auto& x : v) {
           destructs.emplace_back(x.obj, x.type);
         }
         v.clear();
-      }
+      });
+      limbo.for_each([&](auto& bags) {
+        for (auto& bag : bags) {
+          for (const auto& x : bag.ejects) {
+            destructs.emplace_back(x.obj, x.type);
+          }
+          bag.ejects.clear();
+        }
+      });
 
       // Perform all of the pending deferred ejects
-      for (auto [x,type] : destructs) {
-        eject(x,type);
-      }
+      this->eject_coalesced(destructs);
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
     }
   }
 
 private:
 
+  // The deferred ejects that a thread retired during one epoch
+  struct limbo_bag {
+    uint64_t epoch{0};
+    std::vector<RetiredObj> ejects;
+  };
+
+  constexpr static size_t num_bags = 3;
+  struct alignas(128) limbo_bags : public std::array<limbo_bag, num_bags> { };
+
   void work_toward_advancing_epoch(size_t work = 1) {
     auto id = utils::threadID.getTID();
     epoch_work[id] = epoch_work[id] + work;
-    if(epoch_work[id] >= epoch_frequency * num_threads) {
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
       epoch_work[id] = 0;
-      epoch_tracker::instance().advance_global_epoch();
+      epoch_tracker::instance().try_advance_global_epoch();
     }
   }
 
+  // Move the ejects in the bag to the thread's list of deferred ejects
+  void drain(size_t id, limbo_bag& bag) {
+    deferred_destructs[id].insert(deferred_destructs[id].end(), bag.ejects.begin(), bag.ejects.end());
+    bag.ejects.clear();
+  }
+
   void work_toward_ejects(size_t work = 1) {
     auto id = utils::threadID.getTID();
     eject_work[id] = eject_work[id] + work;
-    auto threshold = std::max<size_t>(30, eject_delay * num_threads);  // Always attempt at least 30 ejects
+    auto threshold = std::max<size_t>(30, eject_delay * utils::num_thread_ids());  // Always attempt at least 30 ejects
     while (!in_progress[id] && eject_work[id] >= threshold) {
       eject_work[id] = 0;
+      orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); });  // take over those of exited threads
+      auto safe_epoch = epoch_tracker::instance().get_safe_epoch();
+      for (auto& bag : limbo[id]) {
+        if (bag.epoch < safe_epoch) drain(id, bag);
+      }
       if (deferred_destructs[id].size() == 0) break; // nothing to collect
+      if (reclaimer != nullptr && reclaimer->submit(deferred_destructs[id])) break; // handed off to the background threads
       in_progress[id] = true;
       auto deferred = std::vector<RetiredObj>(std::move(deferred_destructs[id]));
-      auto min_epoch = epoch_tracker::instance().get_min_announced_epoch();
-
-      auto f = [this, min_epoch](const auto& x) {
-        if (x.retireTS < min_epoch) {
-          eject(x.obj, x.type);
-          return true;
-        }
-        return false;
-      };
-
-      // Remove the deferred decrements that are successfully applied
-      deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
+      eject_unprotected(deferred);
       deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
       in_progress[id] = false;
     }
   }
 
-  size_t num_threads;
-  std::vector<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
-  std::vector<AlignedVector<RetiredObj>> deferred_destructs;    // Thread-local lists of pending deferred destructs
-  std::vector<AlignedInt> eject_work;                           // Amortized work to pay for ejecting deferred destructs
-  std::vector<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  using retired_batch = std::vector<RetiredObj>;
+  using reclaimer_t = background_reclaimer<acquire_retire_ebr, retired_batch>;
+  friend reclaimer_t;
+  friend utils::thread_exit_hook<acquire_retire_ebr>;
+
+  // Perform the deferred ejects in the batch on a background thread
+  void reclaim_in_background(retired_batch& batch) {
+    auto id = utils::threadID.getTID();
+    in_progress[id] = true;
+    eject_unprotected(batch);
+    // Ejects may cause further ejects to be deferred by this thread, which are kept for the next pass
+    for (auto& bag : limbo[id]) drain(id, bag);
+    batch.insert(batch.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    in_progress[id] = false;
+  }
+
+  // Called by each thread as it exits. Performs the deferred ejects of the thread
+  // that are safe, and leaves the rest on the orphan list for other threads to adopt
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    if (in_progress[id]) return found_work;
+    for (auto& bag : limbo[id]) drain(id, bag);
+    if (deferred_destructs[id].empty()) return found_work;
+    in_progress[id] = true;
+    auto deferred = retired_batch(std::move(deferred_destructs[id]));
+    deferred_destructs[id].clear();
+    eject_unprotected(deferred);
+    for (auto& bag : limbo[id]) drain(id, bag);
+    deferred.insert(deferred.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    eject_work[id] = 0;
+    in_progress[id] = false;
+    orphans.push(std::move(deferred));
+    return true;
+  }
+
+  // Perform every deferred eject in the given list that is no longer protected,
+  // and remove it from the list. The announcements are only scanned if some
+  // eject is not known to be safe from the safe epoch alone
+  void eject_unprotected(retired_batch& deferred) {
+    auto min_epoch = epoch_tracker::instance().get_safe_epoch();
+    bool scanned = false;
+
+    // Collect the deferred decrements that are safe to apply, so that repeated
+    // decrements of the same object can be applied together
+    std::vector<std::pair<counted_ptr_t, RetireType>> ejects;
+    auto f = [&ejects, &min_epoch, &scanned](const auto& x) {
+      if (x.retireTS >= min_epoch && !scanned) {
+        scanned = true;
+        min_epoch = std::max(min_epoch, epoch_tracker::instance().get_min_announced_epoch());
+      }
+      if (x.retireTS < min_epoch) {
+        ejects.emplace_back(x.obj, x.type);
+        return true;
+      }
+      return false;
+    };
+
+    // Remove the deferred decrements that are successfully applied
+    deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
+    this->eject_coalesced(ejects);
+  }
+
+  utils::per_thread<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  utils::per_thread<limbo_bags> limbo;                                // Thread-local bags of deferred destructs by epoch
+  utils::per_thread<AlignedVector<RetiredObj>> deferred_destructs;    // Thread-local lists of deferred destructs that are due to be ejected
+  utils::per_thread<AlignedInt> eject_work;                           // Amortized work to pay for ejecting deferred destructs
+  utils::per_thread<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  std::unique_ptr<reclaimer_t> reclaimer;                       // Background threads that perform deferred ejects, if enabled
+  orphan_list<RetiredObj> orphans;                              // Deferred ejects left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_ebr> exit_hook{*this};
 };
 
 
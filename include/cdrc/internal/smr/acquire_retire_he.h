@@ -0,0 +1,464 @@
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_HE_H
+#define CDRC_SMR_ACQUIRE_RETIRE_HE_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../background_reclaimer.h"
+#include "../counted_object.h"
+#include "../epoch_tracker.h"
+#include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
+#include "../utils.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses hazard eras. Like hazard pointers, each thread
+// protects what it reads with a bounded number of announcement slots, and
+// no guard is needed, but the slots hold the global epoch (the era) in which
+// the read took place rather than the handle itself. Every object is stamped
+// with the era in which it was created, and every deferred eject with the era
+// in which it was retired, and an eject is only applied once no slot holds
+// an era between the two. Since a slot only has to be updated when the era
+// changes, most reads do not write to shared memory, as with EBR, while a
+// stalled thread only holds back the objects that existed in the eras that
+// it has announced, as with hazard pointers.
+//
+// A slot keeps its era when the protection is released, so that further reads
+// in the same era need not announce it again. A thread withdraws the eras of
+// its unused slots whenever it performs its deferred ejects, but a thread that
+// stops reading and writing holds back the objects of its last eras, like a
+// stalled thread would, until it resumes, or exits.
+//
+// T =               The underlying type of the object being protected
+// snapshot_slots =  The number of additional announcement slots available for
+//                   snapshot pointers. More allows more snapshots to be alive
+//                   at a time, but makes reclamation slower
+// epoch_frequency = How often to update the global epoch. More often (lower value)
+//                   will reduce memory usage, but makes announcements more frequent
+// eject_delay =     The maximum number of deferred ejects that will be held by
+//                   any one worker thread is at most eject_delay * #threads.
+// object_policy =   Customizes the representation and allocation of the managed
+//                   objects. See object_policy.h
+//
+template<typename T, size_t snapshot_slots = 7, size_t epoch_frequency = 40, size_t eject_delay = 2, typename object_policy = default_object_policy>
+struct acquire_retire_he : public memory_manager_base<T, acquire_retire_he<T, snapshot_slots, epoch_frequency, eject_delay, object_policy>, object_policy> {
+
+  using base = memory_manager_base<T, acquire_retire_he<T, snapshot_slots, epoch_frequency, eject_delay, object_policy>, object_policy>;
+
+  using base::increment_ref_cnt;
+  using base::eject;
+
+  inline static const uint64_t no_era = epoch_tracker::no_epoch;
+
+ private:
+  using counted_object_t = counted_object<T, object_policy>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+
+  struct EraSlot {
+    std::atomic<uint64_t> era{no_era};
+    std::atomic<bool> in_use{false};           // Whether the slot currently protects a handle
+  };
+
+  // Align to cache line boundary to avoid false sharing
+  struct alignas(128) LocalSlot {
+    EraSlot announcement;
+    std::array<EraSlot, snapshot_slots> snapshot_announcements{};
+  };
+
+ public:
+
+  static acquire_retire_he& instance() {
+    static acquire_retire_he ar;
+    return ar;
+  }
+
+  struct birth_stamp {
+    uint64_t birthTS;
+  };
+
+  // Augments a reference-counted object with a birth timestamp field that is
+  // initialized with the value of the current epoch when the object is created.
+  // The timestamp precedes the object, so that the elements of an array still
+  // directly follow it
+  struct stamped_counted_object : public birth_stamp, public counted_object_t {
+    template<typename... Args>
+    explicit stamped_counted_object(uint64_t t, Args&&... args)
+      : birth_stamp{t}, counted_object_t(std::forward<Args>(args)...) {}
+  };
+
+  uint64_t get_birth_timestamp(counted_ptr_t p) {
+    return static_cast<stamped_counted_object*>(p)->birthTS;
+  }
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object<stamped_counted_object>(epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object_with<stamped_counted_object>(alloc, epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    this->deallocate_object(static_cast<stamped_counted_object*>(p));
+  }
+
+  struct RetiredObj {
+    counted_ptr_t obj; uint64_t birthTS; uint64_t retireTS; RetireType type;
+    RetiredObj(counted_ptr_t obj, uint64_t birthTS, uint64_t retireTS, RetireType type) :
+        obj(obj), birthTS(birthTS), retireTS(retireTS), type(type) {}
+  };
+
+  // An RAII wrapper around an acquired handle. Automatically
+  // releases the slot when the wrapper goes out of scope.
+  template<typename U>
+  struct acquired_pointer {
+   public:
+    friend struct acquire_retire_he;
+
+    acquired_pointer() : value(nullptr), slot(nullptr) {}
+
+    acquired_pointer(U value_, EraSlot* slot_) : value(value_), slot(slot_) {}
+
+    acquired_pointer(acquired_pointer&& other) noexcept : value(other.value), slot(other.slot) {
+      other.value = nullptr;
+      other.slot = nullptr;
+    }
+
+    ~acquired_pointer() { clear_protection(); }
+
+    acquired_pointer& operator=(acquired_pointer&& other) noexcept {
+      value = other.value;
+      slot = other.slot;
+      other.value = nullptr;
+      other.slot = nullptr;
+      return *this;
+    }
+
+    void swap(acquired_pointer &other) {
+      std::swap(value, other.value);
+      std::swap(slot, other.slot);
+    }
+
+    U& get() {
+      return value;
+    }
+
+    U get() const {
+      return value;
+    }
+
+    bool is_protected() const {
+      return slot != nullptr && value != nullptr;
+    }
+
+    // The era stays announced, see above
+    void clear_protection() {
+      if (slot != nullptr) {
+        slot->in_use.store(false, std::memory_order_release);
+      }
+    }
+
+    void clear() {
+      clear_protection();
+      value = nullptr;
+      slot = nullptr;
+    }
+
+   private:
+    U value;
+    EraSlot *slot;
+  };
+
+  acquire_retire_he() = default;
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    auto id = utils::threadID.getTID();
+    auto& slot = announcement_slots[id].announcement;
+    slot.in_use.store(true, std::memory_order_relaxed);
+    return acquired_pointer<U>(protect_in(p, slot), &slot);
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    auto id = utils::threadID.getTID();
+    auto& slot = announcement_slots[id].announcement;
+    slot.in_use.store(true, std::memory_order_relaxed);
+    announce(slot, epoch_tracker::instance().get_current_epoch());
+    return acquired_pointer<U>(p, &slot);
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return {};
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    auto *slot = get_free_slot();
+
+    // If no snapshot slot is available, just increment the reference count
+    if (slot == nullptr) {
+      while (true) {
+        auto a = acquire(p);
+        if (a.get() && increment_ref_cnt(a.get())) return acquired_pointer<U>(a.get(), nullptr);
+        else if (a.get() == nullptr || p->load() == a.get()) return acquired_pointer<U>(nullptr, nullptr);
+      }
+    }
+
+    U result = protect_in(p, *slot);
+    if (result == nullptr) return acquired_pointer<U>(nullptr, nullptr);
+    slot->in_use.store(true, std::memory_order_relaxed);
+    return acquired_pointer<U>(result, slot);
+  }
+
+  [[nodiscard]] EraSlot *get_free_slot() {
+    assert(snapshot_slots != 0);
+    auto id = utils::threadID.getTID();
+    for (auto& slot : announcement_slots[id].snapshot_announcements) {
+      if (!slot.in_use.load(std::memory_order_acquire)) return std::addressof(slot);
+    }
+    return nullptr;
+  }
+
+  void release() {}
+
+  void retire(counted_ptr_t p, RetireType type) {
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].push_back(RetiredObj(p, get_birth_timestamp(p), epoch_tracker::instance().get_current_epoch(), type));
+    work_toward_ejects(1);
+  }
+
+  // Start performing deferred ejects on num_workers dedicated background threads.
+  // Application threads then hand their deferred ejects over to the background
+  // threads, unless more than queue_capacity batches are already waiting, in
+  // which case they perform them inline as usual. The background threads need
+  // thread IDs of their own. Must not be called concurrently with other operations.
+  void start_background_reclamation(size_t num_workers = 1, size_t queue_capacity = 64) {
+    assert(reclaimer == nullptr);
+    reclaimer = std::make_unique<reclaimer_t>(*this, num_workers, queue_capacity);
+  }
+
+  // Stop the background threads. Any ejects that they had not yet performed are
+  // taken over by the calling thread. Must not be called concurrently with other operations.
+  void stop_background_reclamation() {
+    assert(reclaimer != nullptr);
+    auto leftovers = reclaimer->stop();
+    reclaimer.reset();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].insert(deferred_destructs[id].end(), leftovers.begin(), leftovers.end());
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_he() {
+    if (reclaimer != nullptr) stop_background_reclamation();
+    in_progress.for_each([](auto& flag) { flag = true; });
+
+    // Loop because the destruction of one object could trigger the deferred
+    // destruction of another object (possibly even in another thread), and
+    // so on recursively.
+    while (!orphans.empty() || deferred_destructs.any_of([](const auto &v) { return !v.empty(); }) ||
+           this->destructions_pending()) {
+
+      // Move all of the contents from the deferred destruction lists
+      // into a single local list. We don't want to just iterate the
+      // deferred lists because a destruction may trigger another
+      // deferred destruction to be added to one of the lists, which
+      // would invalidate its iterators
+      std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
+      orphans.adopt([&](const auto& x) { destructs.emplace_back(x.obj, x.type); });
+      deferred_destructs.for_each([&](auto &v) {
+        for (const auto& x : v) {
+          destructs.emplace_back(x.obj, x.type);
+        }
+        v.clear();
+      });
+
+      // Perform all of the pending deferred ejects
+      this->eject_coalesced(destructs);
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
+    }
+  }
+
+ private:
+
+  // Announce the given era in the slot, unless it is already there
+  static void announce(EraSlot& slot, uint64_t era) {
+    if (slot.era.load(std::memory_order_relaxed) != era) {
+      slot.era.store(era, std::memory_order_seq_cst);
+    }
+  }
+
+  // Read the handle in p, making sure that the era in which it was read is
+  // announced in the given slot
+  template<typename U>
+  static U protect_in(const std::atomic<U> *p, EraSlot& slot) {
+    auto era = slot.era.load(std::memory_order_relaxed);
+    while (true) {
+      U result = p->load(std::memory_order_seq_cst);
+      auto current = epoch_tracker::instance().get_current_epoch();
+      if (era == current) return result;
+      slot.era.store(current, std::memory_order_seq_cst);
+      era = current;
+    }
+  }
+
+  // Apply the function f to every currently announced era
+  template<typename F>
+  void scan_slots(F &&f) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    announcement_slots.for_each([&](const auto &announcement_slot) {
+      auto x = announcement_slot.announcement.era.load(std::memory_order_seq_cst);
+      if (x != no_era) f(x);
+      for (const auto &free_slot : announcement_slot.snapshot_announcements) {
+        auto y = free_slot.era.load(std::memory_order_seq_cst);
+        if (y != no_era) f(y);
+      }
+    });
+  }
+
+  void work_toward_advancing_epoch(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    epoch_work[id] = epoch_work[id] + work;
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
+      epoch_work[id] = 0;
+      epoch_tracker::instance().advance_global_epoch();
+    }
+  }
+
+  void work_toward_ejects(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    eject_work[id] = eject_work[id] + work;
+    auto threshold = std::max<size_t>(30, eject_delay * utils::num_thread_ids());  // Always attempt at least 30 ejects
+    while (!in_progress[id] && eject_work[id] >= threshold) {
+      eject_work[id] = 0;
+      orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); });  // take over those of exited threads
+      if (deferred_destructs[id].size() == 0) break; // nothing to collect
+      if (reclaimer != nullptr && reclaimer->submit(deferred_destructs[id])) break; // handed off to the background threads
+      in_progress[id] = true;
+      auto deferred = AlignedVector<RetiredObj>(std::move(deferred_destructs[id]));
+      eject_unprotected(deferred);
+      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
+      in_progress[id] = false;
+    }
+  }
+
+  using retired_batch = std::vector<RetiredObj>;
+  using reclaimer_t = background_reclaimer<acquire_retire_he, retired_batch>;
+  friend reclaimer_t;
+  friend utils::thread_exit_hook<acquire_retire_he>;
+
+  // Perform the deferred ejects in the batch on a background thread
+  void reclaim_in_background(retired_batch& batch) {
+    auto id = utils::threadID.getTID();
+    in_progress[id] = true;
+    eject_unprotected(batch);
+    // Ejects may cause further ejects to be deferred by this thread, which are kept for the next pass
+    batch.insert(batch.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    in_progress[id] = false;
+  }
+
+  // Withdraw the eras announced in the calling thread's slots that no longer protect anything
+  void withdraw_unused_eras(size_t id) {
+    auto withdraw = [](EraSlot& slot) {
+      if (!slot.in_use.load(std::memory_order_relaxed)) slot.era.store(no_era, std::memory_order_relaxed);
+    };
+    withdraw(announcement_slots[id].announcement);
+    for (auto& slot : announcement_slots[id].snapshot_announcements) withdraw(slot);
+  }
+
+  // Called by each thread as it exits. Withdraws the eras announced by the
+  // thread, performs its deferred ejects that are safe, and leaves the rest
+  // on the orphan list for other threads to adopt
+  bool on_thread_exit(size_t id) {
+    auto& slots = announcement_slots[id];
+    slots.announcement.era.store(no_era, std::memory_order_release);
+    for (auto& slot : slots.snapshot_announcements) slot.era.store(no_era, std::memory_order_release);
+
+    bool found_work = this->flush_destructions();
+    if (in_progress[id] || deferred_destructs[id].empty()) return found_work;
+    in_progress[id] = true;
+    auto deferred = retired_batch(std::move(deferred_destructs[id]));
+    deferred_destructs[id].clear();
+    eject_unprotected(deferred);
+    deferred.insert(deferred.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    eject_work[id] = 0;
+    in_progress[id] = false;
+    orphans.push(std::move(deferred));
+    return true;
+  }
+
+  // Perform every deferred eject in the given list that is no longer protected,
+  // i.e., for which no era between its birth and its retirement is announced,
+  // and remove it from the list
+  void eject_unprotected(retired_batch& deferred) {
+    auto id = utils::threadID.getTID();
+    withdraw_unused_eras(id);
+    auto& announced = announced_eras[id];
+    announced.clear();
+    scan_slots([&](auto era) { announced.push_back(era); });
+    std::sort(announced.begin(), announced.end());
+
+    // Collect the deferred decrements that are safe to apply, so that repeated
+    // decrements of the same object can be applied together
+    std::vector<std::pair<counted_ptr_t, RetireType>> ejects;
+    auto f = [&](const auto& x) {
+      auto it = std::lower_bound(announced.begin(), announced.end(), x.birthTS);
+      if (it != announced.end() && *it <= x.retireTS) return false;
+      ejects.emplace_back(x.obj, x.type);
+      return true;
+    };
+
+    // Remove the deferred decrements that are successfully applied
+    deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
+    this->eject_coalesced(ejects);
+  }
+
+  utils::per_thread<LocalSlot> announcement_slots;                      // Announcement array slots
+  utils::per_thread<AlignedBool> in_progress;                           // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedVector<RetiredObj>> deferred_destructs;      // Thread-local lists of pending deferred destructs
+  utils::per_thread<AlignedInt> eject_work;                             // Amortized work to pay for ejecting deferred destructs
+  utils::per_thread<AlignedInt> epoch_work;                             // Amortized work to pay for incrementing the epoch
+  utils::per_thread<AlignedVector<uint64_t>> announced_eras;            // Thread-local storage for the eras found by a scan
+  std::unique_ptr<reclaimer_t> reclaimer;                         // Background threads that perform deferred ejects, if enabled
+  orphan_list<RetiredObj> orphans;                                // Deferred ejects left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_he> exit_hook{*this};
+};
+
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif  // CDRC_SMR_ACQUIRE_RETIRE_HE_H
@@ -8,12 +8,17 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "../counted_object.h"
+#include "../epoch_tracker.h"
 #include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
 #include "../utils.h"
 
 namespace cdrc {
@@ -24,21 +29,41 @@ struct hyaline_tracker {
 
   struct alignas(128) Reservation;
 
+  // Performs a deferred eject of the given object, which was retired with the given type
+  using eject_fn = void (*)(void*, RetireType);
+
   struct Node { // TODO: unclear if this should be aligned
     void* obj;
-    union {      // Each node takes 3 memory words
+    union {      // Each node takes 4 memory words
       std::atomic<int64_t> refc;  // REFS: Refer. counter
       Node* bnext;    // SLOT: Next node
     };
     union {
       Node* next;           // SLOT: After retiring
-      std::function<void(void*)>* decrement;
+      eject_fn eject;       // REFS: Ejects the objects of the batch
     };
-    Node* blink;    // REFS: First SLOT node,
+    Node* blink;    // REFS: First SLOT node, SLOT: REFS node. Tagged with the node's RetireType
 
     Node(void* obj) : obj(obj), bnext(nullptr), next(nullptr), blink(nullptr) {}
   };
 
+  static_assert(alignof(Node) >= 4, "The low bits of the links between nodes hold their retire type");
+  inline static const uintptr_t type_mask = 3;
+
+  // Set the link from the node to the REFS node or the first SLOT node, and the
+  // type with which the node's object was retired
+  static void set_link(Node* node, Node* link, RetireType type) {
+    node->blink = reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(link) | static_cast<uintptr_t>(type));
+  }
+
+  static Node* get_link(const Node* node) {
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(node->blink) & ~type_mask);
+  }
+
+  static RetireType get_type(const Node* node) {
+    return static_cast<RetireType>(reinterpret_cast<uintptr_t>(node->blink) & type_mask);
+  }
+
   inline static Node* invptr = reinterpret_cast<Node*>(0x1);
   inline static const int64_t REFC_PROTECT = (1ull << 62);
 
@@ -46,12 +71,14 @@ struct hyaline_tracker {
     Node* first;
     Node* refs;
     size_t counter;
-    Batch() : first(nullptr), refs(nullptr), counter(0) {}
+    uint64_t min_birth;   // The earliest birth era of the objects in the batch, if they are stamped
+    Batch() : first(nullptr), refs(nullptr), counter(0), min_birth(0) {}
   };
 
   struct alignas(128) Reservation {
     std::atomic<Node*> list;
-    Reservation() : list(invptr) {}
+    std::atomic<uint64_t> era;  // The latest era in which the thread read a handle, if it announces eras
+    Reservation() : list(invptr), era(0) {}
   };
 
   static hyaline_tracker &instance() {
@@ -84,14 +111,35 @@ struct hyaline_tracker {
     return critical_section[id];
   }
 
-  void add_batch(const Batch& batch) {
-    batch.refs->blink = batch.first;
+  // Read the handle in p, making sure that the calling thread's reservation
+  // announces an era no earlier than the one in which it was read
+  template<typename U>
+  U protect(const std::atomic<U> *p) {
+    auto& era = rsrv[utils::threadID.getTID()].era;
+    auto announced = era.load(std::memory_order_relaxed);
+    while (true) {
+      U result = p->load(std::memory_order_seq_cst);
+      auto current = epoch_tracker::instance().get_current_epoch();
+      if (announced == current) return result;
+      era.store(current, std::memory_order_seq_cst);
+      announced = current;
+    }
+  }
+
+  // Insert the batch into the reservation lists of the first num_slots thread IDs.
+  // The batch must contain more than num_slots nodes. Threads whose IDs are handed
+  // out after num_slots was read can not reach the objects in the batch, and nor
+  // can threads whose announced era is earlier than every birth era in the batch
+  void add_batch(const Batch& batch, size_t num_slots) {
+    assert(batch.counter > num_slots);
+    set_link(batch.refs, batch.first, get_type(batch.refs));
     Node* curr = batch.first;
     int64_t cnt = -REFC_PROTECT;
-    for(size_t i = 0; i < utils::num_threads(); i++) {
+    for(size_t i = 0; i < num_slots; i++) {
       while(true) {
         Node* prev = rsrv[i].list.load();
         if(prev == invptr) break;
+        if(batch.min_birth != 0 && rsrv[i].era.load() < batch.min_birth) break;
         curr->next = prev;
         if(rsrv[i].list.compare_exchange_strong(prev, curr)) {
           cnt++;
@@ -110,31 +158,108 @@ private:
       Node* curr = next;
       assert(curr != invptr);
       next = curr->next;
-      Node* refs = curr->blink;
+      Node* refs = get_link(curr);
       if(refs->refc.fetch_add(-1) == 1) free_batch(refs);
     }
   }
 
   void free_batch(Node* refs) {
-    std::function<void(void*)>& decrement = *(refs->decrement);
-    Node* n = refs->blink;
+    eject_fn eject = refs->eject;
+    Node* n = get_link(refs);
     do {
       Node* node = n;
       // refc and bnext overlap and are 0
       // (nullptr) for the last REFS node
       assert(n != invptr);
       n = n->bnext;
-      decrement(node->obj);
-      delete node;
+      eject(node->obj, get_type(node));
+      deallocate_node(node);
     } while(n != nullptr);
   }
 
 public:
-  hyaline_tracker() : critical_section(utils::num_threads()),
-                      rsrv(utils::num_threads()) {}
+  // Take a node for the given object from the calling thread's node pool
+  Node* allocate_node(void* obj) {
+    auto& pool = node_pools[utils::threadID.getTID()];
+    if (pool.head == nullptr) adopt_nodes(pool);
+    Node* node = pool.head;
+    pool.head = node->bnext;
+    pool.count--;
+    return new (node) Node(obj);
+  }
+
+  // Return the node to the calling thread's node pool, regardless of which thread took it
+  void deallocate_node(Node* node) {
+    auto& pool = node_pools[utils::threadID.getTID()];
+    node->bnext = pool.head;
+    pool.head = node;
+    pool.count++;
+    if (pool.count >= 2 * node_block_size) release_nodes(pool);
+  }
+
+  hyaline_tracker() = default;
+
+  hyaline_tracker(const hyaline_tracker&) = delete;
+  hyaline_tracker& operator=(const hyaline_tracker&) = delete;
+
+  ~hyaline_tracker() {
+    for (auto block : node_blocks) ::operator delete(block);
+  }
+
+  utils::per_thread<utils::Padded<bool>> critical_section;
+  utils::per_thread<Reservation> rsrv;
+
+private:
+  // Nodes are recycled through per-thread pools, like the blocks of slab_pool. A
+  // pool that grows too long hands a block of its nodes over to a global list,
+  // from which pools that run dry adopt a whole block at once
+  constexpr static size_t node_block_size = 64;     // Number of nodes moved to or from the global list at once
+
+  // Align to cache line boundary to avoid false sharing
+  struct alignas(128) NodePool {
+    Node* head{nullptr};      // Free nodes, linked through bnext
+    size_t count{0};
+  };
+
+  // Take a block of free nodes from the global list, or allocate a new one
+  void adopt_nodes(NodePool& pool) {
+    std::lock_guard<std::mutex> guard(free_nodes_lock);
+    if (free_blocks != nullptr) {
+      pool.head = free_blocks;
+      pool.count = node_block_size;
+      free_blocks = free_blocks->blink;
+    }
+    else {
+      auto block = static_cast<Node*>(::operator new(node_block_size * sizeof(Node)));
+      node_blocks.push_back(block);
+      for (size_t i = 0; i < node_block_size; i++) {
+        new (&block[i]) Node(nullptr);
+        block[i].bnext = (i + 1 < node_block_size) ? &block[i + 1] : nullptr;
+      }
+      pool.head = block;
+      pool.count = node_block_size;
+    }
+  }
+
+  // Hand a block of nodes from the given pool over to the global list
+  void release_nodes(NodePool& pool) {
+    assert(pool.count >= node_block_size);
+    Node* first = pool.head;
+    Node* last = first;
+    for (size_t i = 1; i < node_block_size; i++) last = last->bnext;
+    pool.head = last->bnext;
+    pool.count -= node_block_size;
+    last->bnext = nullptr;
+
+    std::lock_guard<std::mutex> guard(free_nodes_lock);
+    first->blink = free_blocks;     // Blocks are linked through their first node
+    free_blocks = first;
+  }
 
-  std::vector<utils::Padded<bool>> critical_section;
-  std::vector<Reservation> rsrv;
+  utils::per_thread<NodePool> node_pools;
+  std::mutex free_nodes_lock;
+  Node* free_blocks{nullptr};
+  std::vector<void*> node_blocks;
 };
 
 }  // namespace internal
@@ -181,67 +306,55 @@ namespace internal {
 //   }
 //
 // T =              The underlying type of the object being protected
-// batch_size       accumulate (batch_size*num_threads)+1 nodes before announcing batch
+// batch_size       accumulate (batch_size*#threads)+1 nodes before announcing batch
+// object_policy =  Customizes the representation and allocation of the managed
+//                  objects. See object_policy.h
 //
 // NOTE: handling recursion was tricky
 // Note: Hyaline doesn't suffer as much from the recursive destruct problem. No maybe it
 // still does because batching. But it might be easier to fix.
-template<typename T, size_t batch_size = 2>
-struct acquire_retire_hyaline : public memory_manager_base<T, acquire_retire_hyaline<T>> {
+template<typename T, size_t batch_size = 2, typename object_policy = default_object_policy>
+struct acquire_retire_hyaline : public memory_manager_base<T, acquire_retire_hyaline<T, batch_size, object_policy>, object_policy> {
 
-  using base = memory_manager_base<T, acquire_retire_hyaline<T>>;
-
-  using base::increment_allocations;
-  using base::decrement_allocations;
+  using base = memory_manager_base<T, acquire_retire_hyaline<T, batch_size, object_policy>, object_policy>;
 
   using Node = hyaline_tracker::Node;
   using Batch = hyaline_tracker::Batch;
 
 private:
-  using counted_object_t = counted_object<T>;
+  using counted_object_t = counted_object<T, object_policy>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
 public:
 
   static acquire_retire_hyaline& instance() {
-    static acquire_retire_hyaline ar{utils::num_threads()};
+    static acquire_retire_hyaline ar;
     return ar;
   }
 
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
-    increment_allocations();
-    return new counted_object_t(std::forward<Args>(args)...);
+    return this->template allocate_object<counted_object_t>(std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    return this->template allocate_object_with<counted_object_t>(alloc, std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete p;
-    decrement_allocations();
+    this->deallocate_object(p);
   }
 
   template<typename U>
   using acquired_pointer = basic_acquired_pointer<U>;
 
-  explicit acquire_retire_hyaline(size_t num_threads_) :
-    base(num_threads_),
-    num_threads(num_threads_),
-    local_batch(num_threads),
-    in_progress(num_threads, false)
+  acquire_retire_hyaline()
     {
       hyaline_tracker::instance();  // touch the tracker to force it to initialize before this object,
                                     // otherwise, destruction order may be wrong since acquire_retire_hyaline
                                     // refers to hyaline_tracker in its destructor, and hence hyaline tracker
                                     // MUST be destructed after (and hence constructed before!)
-
-      strong_eject = [this](void* obj) {
-        this->eject(reinterpret_cast<counted_ptr_t>(obj), RetireType::decrement_strong_count);
-      };
-      weak_eject = [this](void* obj) {
-        this->eject(reinterpret_cast<counted_ptr_t>(obj), RetireType::decrement_weak_count);
-      };
-      dispose_eject = [this](void* obj) {
-        this->eject(reinterpret_cast<counted_ptr_t>(obj), RetireType::dispose);
-      };
     }
 
   template<typename U>
@@ -277,29 +390,21 @@ public:
     if(p == nullptr) {return;}
 
     Batch& batch = local_batch[id];
-    Node* node = new Node(reinterpret_cast<void*>(p));
-    if(!batch.first) { // the REFS node
-      batch.refs = node;
-      node->refc.store(hyaline_tracker::REFC_PROTECT, std::memory_order_release);
-      if (type == RetireType::decrement_strong_count) node->decrement = &strong_eject;
-      else if (type == RetireType::decrement_weak_count) node->decrement = &weak_eject;
-      else node->decrement = &dispose_eject;
-    } else { // SLOT nodes
-      node->blink = batch.refs; // points to REFS
-      node->bnext = batch.first;
-    }
-    batch.first = node;
-    batch.counter++;
-    // Must have MAX_THREADS+1 nodes to insert to
-    // MAX_THREADS lists, exit if do not have enough
-    while(!in_progress[id] && batch.counter > batch_size*num_threads) {
+    add_to_batch(batch, p, type);
+    // Must have num_slots+1 nodes to insert to
+    // num_slots lists, exit if do not have enough
+    while(!in_progress[id]) {
+      auto num_slots = utils::num_thread_ids();
+      if (batch.counter <= batch_size*num_slots) break;
       const Batch batch_copy = batch;
       batch.first = nullptr;
       batch.counter = 0;
       // if(in_progress) std::cout << "recursive call to retire" << std::endl;
       in_progress[id] = true;
-      hyaline_tracker::instance().add_batch(batch_copy);
+      hyaline_tracker::instance().add_batch(batch_copy, num_slots);
       in_progress[id] = false;
+      // Take over the partial batches of threads that have exited
+      orphans.adopt([&](const auto& x) { add_to_batch(batch, x.first, x.second); });
     }
   }
 
@@ -309,7 +414,8 @@ public:
   ~acquire_retire_hyaline() {
     auto id = utils::threadID.getTID();
     do {
-      for (size_t i = 0; i < num_threads; i++) {
+      orphans.adopt([&](const auto& x) { add_to_batch(local_batch[id], x.first, x.second); });
+      for (size_t i = 0; i < utils::num_thread_ids(); i++) {
         assert(hyaline_tracker::instance().rsrv[i].list.load() == hyaline_tracker::invptr);
         while(local_batch[i].first != nullptr) {
           Batch& batch = local_batch[i];
@@ -320,23 +426,72 @@ public:
           while(node != nullptr) {
             Node* next = node->bnext;
             void* obj = node->obj;
+            auto type = hyaline_tracker::get_type(node);
             in_progress[id] = true;
-            (*batch_copy.refs->decrement)(obj);
+            this->eject(static_cast<counted_ptr_t>(obj), type);
             in_progress[id] = false;
-            delete node;
+            hyaline_tracker::instance().deallocate_node(node);
             if(node == batch_copy.refs) break;
             node = next;
           }
         }
       }
-    } while(local_batch[id].first != nullptr);
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
+    } while(local_batch[id].first != nullptr || !orphans.empty() || this->destructions_pending());
   }
 
 private:
-  alignas(128) size_t num_threads;
-  alignas(128) std::vector<Batch> local_batch;
-  alignas(128) std::function<void(void*)> strong_eject, weak_eject, dispose_eject;
-  std::vector<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  friend utils::thread_exit_hook<acquire_retire_hyaline>;
+
+  // Performs a deferred eject on behalf of the tracker, which only knows the object by its address
+  static void eject_retired(void* obj, RetireType type) {
+    instance().eject(static_cast<counted_ptr_t>(obj), type);
+  }
+
+  void add_to_batch(Batch& batch, counted_ptr_t p, RetireType type) {
+    Node* node = hyaline_tracker::instance().allocate_node(static_cast<void*>(p));
+    if(!batch.first) { // the REFS node
+      batch.refs = node;
+      node->refc.store(hyaline_tracker::REFC_PROTECT, std::memory_order_release);
+      node->eject = &eject_retired;
+      hyaline_tracker::set_link(node, nullptr, type);
+    } else { // SLOT nodes
+      hyaline_tracker::set_link(node, batch.refs, type); // points to REFS
+      node->bnext = batch.first;
+    }
+    batch.first = node;
+    batch.counter++;
+  }
+
+  // Called by each thread as it exits. The thread's partial batch is too small to
+  // be inserted into the reservation lists, so it is left on the orphan list, from
+  // which other threads add its objects to their own batches
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    Batch& batch = local_batch[id];
+    if (in_progress[id] || batch.first == nullptr) return found_work;
+    std::vector<std::pair<counted_ptr_t, RetireType>> orphaned;
+    Node* node = batch.first;
+    while(node != nullptr) {
+      Node* next = node->bnext;
+      orphaned.emplace_back(static_cast<counted_ptr_t>(node->obj), hyaline_tracker::get_type(node));
+      bool last = (node == batch.refs);
+      hyaline_tracker::instance().deallocate_node(node);
+      if(last) break;
+      node = next;
+    }
+    batch.first = nullptr;
+    batch.counter = 0;
+    orphans.push(std::move(orphaned));
+    return true;
+  }
+
+  alignas(128) utils::per_thread<Batch> local_batch;
+  utils::per_thread<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  orphan_list<std::pair<counted_ptr_t, RetireType>> orphans;          // Partial batches left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_hyaline> exit_hook{*this};
 };
 
 
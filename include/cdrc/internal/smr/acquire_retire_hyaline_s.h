@@ -0,0 +1,270 @@
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_HYALINE_S_H
+#define CDRC_SMR_ACQUIRE_RETIRE_HYALINE_S_H
+
+#include <cassert>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../counted_object.h"
+#include "../epoch_tracker.h"
+#include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
+#include "../utils.h"
+
+#include "acquire_retire_hyaline.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses Hyaline-S, the robust variant of Hyaline. As with
+// Hyaline, the user is responsible for acquiring a "hyaline_guard" before
+// performing any reads or writes to the shared pointer, and retired batches
+// are handed to the threads that are inside of a guard, using the same batch
+// machinery. In addition, every object is stamped with the global epoch (its
+// birth era) in which it was created, and every read announces the epoch in
+// which it took place in the reading thread's reservation, like hazard eras.
+// A batch is then only handed to the threads whose announced era is no earlier
+// than the earliest birth era in the batch, since the others can not have
+// read any of its objects. A thread that stalls inside of a guard therefore
+// only holds back the batches of objects that existed when it last read,
+// rather than every batch retired after it entered the guard.
+//
+// An era stays announced after the guard is released, so that later reads in
+// the same era need not announce it again.
+//
+// T =               The underlying type of the object being protected
+// batch_size        accumulate (batch_size*#threads)+1 nodes before announcing batch
+// epoch_frequency = How often to update the global epoch. More often (lower value)
+//                   will reduce memory usage, but makes announcements more frequent
+// object_policy =   Customizes the representation and allocation of the managed
+//                   objects. See object_policy.h
+//
+template<typename T, size_t batch_size = 2, size_t epoch_frequency = 40, typename object_policy = default_object_policy>
+struct acquire_retire_hyaline_s : public memory_manager_base<T, acquire_retire_hyaline_s<T, batch_size, epoch_frequency, object_policy>, object_policy> {
+
+  using base = memory_manager_base<T, acquire_retire_hyaline_s<T, batch_size, epoch_frequency, object_policy>, object_policy>;
+
+  using Node = hyaline_tracker::Node;
+  using Batch = hyaline_tracker::Batch;
+
+private:
+  using counted_object_t = counted_object<T, object_policy>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+
+public:
+
+  static acquire_retire_hyaline_s& instance() {
+    static acquire_retire_hyaline_s ar;
+    return ar;
+  }
+
+  struct birth_stamp {
+    uint64_t birthTS;
+  };
+
+  // Augments a reference-counted object with a birth timestamp field that is
+  // initialized with the value of the current epoch when the object is created.
+  // The timestamp precedes the object, so that the elements of an array still
+  // directly follow it
+  struct stamped_counted_object : public birth_stamp, public counted_object_t {
+    template<typename... Args>
+    explicit stamped_counted_object(uint64_t t, Args&&... args)
+      : birth_stamp{t}, counted_object_t(std::forward<Args>(args)...) {}
+  };
+
+  uint64_t get_birth_timestamp(counted_ptr_t p) {
+    return static_cast<stamped_counted_object*>(p)->birthTS;
+  }
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object<stamped_counted_object>(epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object_with<stamped_counted_object>(alloc, epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    this->deallocate_object(static_cast<stamped_counted_object*>(p));
+  }
+
+  template<typename U>
+  using acquired_pointer = basic_acquired_pointer<U>;
+
+  acquire_retire_hyaline_s()
+    {
+      hyaline_tracker::instance();  // touch the trackers to force them to initialize before this object,
+      epoch_tracker::instance();    // since they must be destructed after it (see acquire_retire_hyaline)
+    }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    return acquired_pointer<U>(hyaline_tracker::instance().protect(p));
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    return acquired_pointer<U>(p);
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return acquired_pointer<U>();
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    auto ptr = hyaline_tracker::instance().protect(p);
+    if (ptr != nullptr && ptr->get_use_count() == 0) ptr = nullptr;
+    return {ptr};
+  }
+
+  void release() {}
+
+  void retire(counted_ptr_t p, RetireType type) {
+    auto id = utils::threadID.getTID();
+    if(p == nullptr) {return;}
+
+    Batch& batch = local_batch[id];
+    add_to_batch(batch, p, type);
+    // Must have num_slots+1 nodes to insert to
+    // num_slots lists, exit if do not have enough
+    while(!in_progress[id]) {
+      auto num_slots = utils::num_thread_ids();
+      if (batch.counter <= batch_size*num_slots) break;
+      const Batch batch_copy = batch;
+      batch.first = nullptr;
+      batch.counter = 0;
+      in_progress[id] = true;
+      hyaline_tracker::instance().add_batch(batch_copy, num_slots);
+      in_progress[id] = false;
+      // Take over the partial batches of threads that have exited
+      orphans.adopt([&](const auto& x) { add_to_batch(batch, x.first, x.second); });
+    }
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_hyaline_s() {
+    auto id = utils::threadID.getTID();
+    do {
+      orphans.adopt([&](const auto& x) { add_to_batch(local_batch[id], x.first, x.second); });
+      for (size_t i = 0; i < utils::num_thread_ids(); i++) {
+        assert(hyaline_tracker::instance().rsrv[i].list.load() == hyaline_tracker::invptr);
+        while(local_batch[i].first != nullptr) {
+          Batch& batch = local_batch[i];
+          const Batch batch_copy = batch;
+          batch.first = nullptr;
+          batch.counter = 0;
+          Node* node = batch_copy.first;
+          while(node != nullptr) {
+            Node* next = node->bnext;
+            void* obj = node->obj;
+            auto type = hyaline_tracker::get_type(node);
+            in_progress[id] = true;
+            this->eject(static_cast<counted_ptr_t>(obj), type);
+            in_progress[id] = false;
+            hyaline_tracker::instance().deallocate_node(node);
+            if(node == batch_copy.refs) break;
+            node = next;
+          }
+        }
+      }
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
+    } while(local_batch[id].first != nullptr || !orphans.empty() || this->destructions_pending());
+  }
+
+private:
+  friend utils::thread_exit_hook<acquire_retire_hyaline_s>;
+
+  // Performs a deferred eject on behalf of the tracker, which only knows the object by its address
+  static void eject_retired(void* obj, RetireType type) {
+    instance().eject(static_cast<counted_ptr_t>(obj), type);
+  }
+
+  void add_to_batch(Batch& batch, counted_ptr_t p, RetireType type) {
+    Node* node = hyaline_tracker::instance().allocate_node(static_cast<void*>(p));
+    auto birth = get_birth_timestamp(p);
+    if(!batch.first) { // the REFS node
+      batch.refs = node;
+      batch.min_birth = birth;
+      node->refc.store(hyaline_tracker::REFC_PROTECT, std::memory_order_release);
+      node->eject = &eject_retired;
+      hyaline_tracker::set_link(node, nullptr, type);
+    } else { // SLOT nodes
+      batch.min_birth = std::min(batch.min_birth, birth);
+      hyaline_tracker::set_link(node, batch.refs, type); // points to REFS
+      node->bnext = batch.first;
+    }
+    batch.first = node;
+    batch.counter++;
+  }
+
+  void work_toward_advancing_epoch(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    epoch_work[id] = epoch_work[id] + work;
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
+      epoch_work[id] = 0;
+      epoch_tracker::instance().advance_global_epoch();
+    }
+  }
+
+  // Called by each thread as it exits. The thread's partial batch is too small to
+  // be inserted into the reservation lists, so it is left on the orphan list, from
+  // which other threads add its objects to their own batches
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    Batch& batch = local_batch[id];
+    if (in_progress[id] || batch.first == nullptr) return found_work;
+    std::vector<std::pair<counted_ptr_t, RetireType>> orphaned;
+    Node* node = batch.first;
+    while(node != nullptr) {
+      Node* next = node->bnext;
+      orphaned.emplace_back(static_cast<counted_ptr_t>(node->obj), hyaline_tracker::get_type(node));
+      bool last = (node == batch.refs);
+      hyaline_tracker::instance().deallocate_node(node);
+      if(last) break;
+      node = next;
+    }
+    batch.first = nullptr;
+    batch.counter = 0;
+    orphans.push(std::move(orphaned));
+    return true;
+  }
+
+  alignas(128) utils::per_thread<Batch> local_batch;
+  utils::per_thread<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  orphan_list<std::pair<counted_ptr_t, RetireType>> orphans;          // Partial batches left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_hyaline_s> exit_hook{*this};
+};
+
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif // CDRC_SMR_ACQUIRE_RETIRE_HYALINE_S_H
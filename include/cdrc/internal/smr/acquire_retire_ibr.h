@@ -1,6 +1,7 @@
 #ifndef CDRC_SMR_ACQUIRE_RETIRE_IBR_H
 #define CDRC_SMR_ACQUIRE_RETIRE_IBR_H
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
 
@@ -11,15 +12,85 @@
 #include <utility>
 #include <vector>
 
+#include "../background_reclaimer.h"
 #include "../counted_object.h"
 #include "../epoch_tracker.h"
 #include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
 #include "../utils.h"
 
 namespace cdrc {
 
 namespace internal {
 
+// How a thread in the interval-based reclamation backend extends the upper end
+// of its reservation to cover the objects that it reads. The lower end is the
+// epoch in which its guard was acquired.
+//
+// The default, 2GE-IBR (two global epochs), extends the reservation to the
+// current global epoch whenever the epoch has moved since the last read, so a
+// read only announces something once per epoch.
+struct ibr_2ge_policy {
+  // Load the pointer, and extend the reservation so that it covers the loaded object
+  template<typename U, typename F>
+  static U protect(std::atomic<uint64_t>& upper, const std::atomic<U>* p, F&&) {
+    auto p_epoch = upper.load();
+    while(true) {
+      U result = p->load(std::memory_order_seq_cst);
+      uint64_t curTS = epoch_tracker::instance().get_current_epoch();
+      if(p_epoch == curTS) return result;
+      upper.exchange(curTS);
+      p_epoch = curTS;
+    }
+  }
+
+  // Extend the reservation to cover an object that is already protected
+  template<typename U, typename F>
+  static void reserve(std::atomic<uint64_t>& upper, U, F&&) {
+    uint64_t curTS = epoch_tracker::instance().get_current_epoch();
+    if(upper.load() != curTS) upper.store(curTS, std::memory_order_release);
+  }
+};
+
+// Tagged IBR, in which the reservation only extends to the latest birth epoch
+// of the objects that have been read, rather than to the current epoch, so it
+// holds back fewer of the objects that were created during a long operation.
+// Since the shared pointers do not carry the birth epochs of their targets as
+// tags, the birth epoch of the loaded object is read from the object, once the
+// reservation has been extended to the current epoch to make that safe, after
+// which the reservation is pulled back to the birth epoch. Reads therefore make
+// two announcements whenever the epoch is ahead of the reservation, rather than
+// one per epoch.
+struct ibr_tagged_policy {
+  template<typename U, typename F>
+  static U protect(std::atomic<uint64_t>& upper, const std::atomic<U>* p, F&& get_birth) {
+    auto reserved = upper.load();
+    auto p_epoch = reserved;
+    while(true) {
+      U result = p->load(std::memory_order_seq_cst);
+      uint64_t curTS = epoch_tracker::instance().get_current_epoch();
+      if(p_epoch == curTS) {
+        if(p_epoch != reserved) {
+          // Only the loaded object was read under the extended reservation
+          auto birthTS = (result == nullptr) ? reserved : std::max(reserved, get_birth(result));
+          if(birthTS < p_epoch) upper.store(birthTS, std::memory_order_release);
+        }
+        return result;
+      }
+      upper.exchange(curTS);
+      p_epoch = curTS;
+    }
+  }
+
+  template<typename U, typename F>
+  static void reserve(std::atomic<uint64_t>& upper, U p, F&& get_birth) {
+    if(p == nullptr) return;
+    auto birthTS = get_birth(p);
+    if(upper.load() < birthTS) upper.store(birthTS, std::memory_order_release);
+  }
+};
+
 // An interface for safe memory reclamation that protects reference-counted
 // resources by deferring their reference count decrements until no thread
 // is still reading them.
@@ -39,21 +110,25 @@ namespace internal {
 //                   will reduce performance but decrease memory usage.
 // eject_delay =     The maximum number of deferred ejects that will be held by
 //                   any one worker thread is at most eject_delay * #threads.
+// object_policy =   Customizes the representation and allocation of the managed
+//                   objects. See object_policy.h
+// interval_policy = How reads extend the reservation. Either ibr_2ge_policy, or
+//                   ibr_tagged_policy, which holds back fewer objects in exchange
+//                   for more announcements.
 //
-template<typename T, size_t epoch_frequency = 40, size_t eject_delay = 2>
-struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T, eject_delay>> {
+template<typename T, size_t epoch_frequency = 40, size_t eject_delay = 2, typename object_policy = default_object_policy,
+         typename interval_policy = ibr_2ge_policy>
+struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T, epoch_frequency, eject_delay, object_policy, interval_policy>, object_policy> {
 
-  using base = memory_manager_base<T, acquire_retire_ibr<T, eject_delay>>;
+  using base = memory_manager_base<T, acquire_retire_ibr<T, epoch_frequency, eject_delay, object_policy, interval_policy>, object_policy>;
 
-  using base::increment_allocations;
-  using base::decrement_allocations;
   using base::increment_ref_cnt;
   using base::eject;
 
   inline static const uint64_t INVALID_TS = 0;
 
  private:
-  using counted_object_t = counted_object<T>;
+  using counted_object_t = counted_object<T, object_policy>;
   using counted_ptr_t = std::add_pointer_t<counted_object_t>;
 
   // Align to cache line boundary to avoid false sharing
@@ -66,17 +141,22 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
  public:
 
   static acquire_retire_ibr& instance() {
-    static acquire_retire_ibr ar{utils::num_threads()};
+    static acquire_retire_ibr ar;
     return ar;
   }
 
+  struct birth_stamp {
+    uint64_t birthTS;
+  };
+
   // Augments a reference-counted object with a birth timestamp field that is
-  // initialized with the value of the current epoch when the object is created
-  struct stamped_counted_object : public counted_object<T> {
+  // initialized with the value of the current epoch when the object is created.
+  // The timestamp precedes the object, so that the elements of an array still
+  // directly follow it
+  struct stamped_counted_object : public birth_stamp, public counted_object_t {
     template<typename... Args>
     explicit stamped_counted_object(uint64_t t, Args&&... args)
-      : counted_object<T>(std::forward<Args>(args)...), birthTS(t) {}
-    uint64_t birthTS;
+      : birth_stamp{t}, counted_object_t(std::forward<Args>(args)...) {}
   };
 
   uint64_t get_birth_timestamp(counted_ptr_t p) {
@@ -85,14 +165,18 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
 
   template<typename... Args>
   counted_ptr_t create_object(Args &&... args) {
-    increment_allocations();
     work_toward_advancing_epoch(1);
-    return new stamped_counted_object(epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+    return this->template allocate_object<stamped_counted_object>(epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object_with<stamped_counted_object>(alloc, epoch_tracker::instance().get_current_epoch(), std::forward<Args>(args)...);
   }
 
   void delete_object(counted_ptr_t p) {
-    delete static_cast<stamped_counted_object*>(p);
-    decrement_allocations();
+    this->deallocate_object(static_cast<stamped_counted_object*>(p));
   }
 
   struct RetiredObj {
@@ -105,14 +189,7 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
   using acquired_pointer = basic_acquired_pointer<U>;
 
 
-  explicit acquire_retire_ibr(size_t num_threads_) :
-      base(num_threads_),
-      num_threads(num_threads_),
-      announcement_slots(num_threads),
-      in_progress(num_threads),
-      deferred_destructs(num_threads),
-      eject_work(num_threads),
-      epoch_work(num_threads) {}
+  acquire_retire_ibr() = default;
 
   template<typename U>
   [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
@@ -123,12 +200,8 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
   // copy of the handle and knows that it is protected
   template<typename U>
   [[nodiscard]] acquired_pointer<U> reserve(U p) {
-    //if(p == nullptr) return {p, nullptr};
     auto id = utils::threadID.getTID();
-    LocalSlot& slot = announcement_slots[id];
-    uint64_t curTS = epoch_tracker::instance().get_current_epoch();
-    if(slot.endTS_ann.load() != curTS)
-      slot.endTS_ann.store(curTS, std::memory_order_release);
+    interval_policy::reserve(announcement_slots[id].endTS_ann, p, birth_of<U>);
     return {p};
   }
 
@@ -142,19 +215,9 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
   template<typename U>
   [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
     auto id = utils::threadID.tid;
-    auto p_epoch = announcement_slots[id].endTS_ann.load();
-    while(true) {
-      U result = p->load(std::memory_order_seq_cst);
-      uint64_t curTS = epoch_tracker::instance().get_current_epoch();
-      if(p_epoch == curTS) {
-        if (result != nullptr && result->get_use_count() == 0) return {nullptr};
-        return {result};
-      }
-      else {
-        announcement_slots[id].endTS_ann.exchange(curTS);
-        p_epoch = curTS;
-      }
-    }
+    U result = interval_policy::protect(announcement_slots[id].endTS_ann, p, birth_of<U>);
+    if (result != nullptr && result->get_use_count() == 0) return {nullptr};
+    return {result};
   }
 
   void release() {}
@@ -165,17 +228,38 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
     work_toward_ejects(1);
   }
 
+  // Start performing deferred ejects on num_workers dedicated background threads.
+  // Application threads then hand their deferred ejects over to the background
+  // threads, unless more than queue_capacity batches are already waiting, in
+  // which case they perform them inline as usual. The background threads need
+  // thread IDs of their own. Must not be called concurrently with other operations.
+  void start_background_reclamation(size_t num_workers = 1, size_t queue_capacity = 64) {
+    assert(reclaimer == nullptr);
+    reclaimer = std::make_unique<reclaimer_t>(*this, num_workers, queue_capacity);
+  }
+
+  // Stop the background threads. Any ejects that they had not yet performed are
+  // taken over by the calling thread. Must not be called concurrently with other operations.
+  void stop_background_reclamation() {
+    assert(reclaimer != nullptr);
+    auto leftovers = reclaimer->stop();
+    reclaimer.reset();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].insert(deferred_destructs[id].end(), leftovers.begin(), leftovers.end());
+  }
+
   // Perform any remaining deferred destruction. Need to be very careful
   // about additional objects being queued for deferred destruction by
   // an object that was just destructed.
   ~acquire_retire_ibr() {
-    in_progress.assign(in_progress.size(), true);
+    if (reclaimer != nullptr) stop_background_reclamation();
+    in_progress.for_each([](auto& flag) { flag = true; });
 
     // Loop because the destruction of one object could trigger the deferred
     // destruction of another object (possibly even in another thread), and
     // so on recursively.
-    while (std::any_of(deferred_destructs.begin(), deferred_destructs.end(),
-                       [](const auto &v) { return !v.empty(); })) {
+    while (!orphans.empty() || deferred_destructs.any_of([](const auto &v) { return !v.empty(); }) ||
+           this->destructions_pending()) {
 
       // Move all of the contents from the deferred destruction lists
       // into a single local list. We don't want to just iterate the
@@ -183,27 +267,33 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
       // deferred destruction to be added to one of the lists, which
       // would invalidate its iterators
       std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
-      for (auto &v : deferred_destructs) {
+      orphans.adopt([&](const auto& x) { destructs.emplace_back(x.obj, x.type); });
+      deferred_destructs.for_each([&](auto &v) {
         for (const auto& x : v) {
             destructs.emplace_back(x.obj, x.type);
         }
         v.clear();
-      }
+      });
 
       // Perform all of the pending deferred ejects
-      for (auto [x,type] : destructs) {
-        eject(x,type);
-      }
+      this->eject_coalesced(destructs);
 
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
     }
   }
 
  private:
 
+  template<typename U>
+  static uint64_t birth_of(U p) {
+    return static_cast<stamped_counted_object*>(static_cast<counted_ptr_t>(p))->birthTS;
+  }
+
   void work_toward_advancing_epoch(size_t work = 1) {
     auto id = utils::threadID.getTID();
     epoch_work[id] = epoch_work[id] + work;
-    if(epoch_work[id] >= epoch_frequency * num_threads) {
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
         epoch_work[id] = 0;
         epoch_tracker::instance().advance_global_epoch();
     }
@@ -212,48 +302,130 @@ struct acquire_retire_ibr : public memory_manager_base<T, acquire_retire_ibr<T,
   void work_toward_ejects(size_t work = 1) {
     auto id = utils::threadID.getTID();
     eject_work[id] = eject_work[id] + work;
-    auto threshold = std::max<size_t>(30, eject_delay * eject_work.size());  // Always attempt at least 30 ejects
+    auto threshold = std::max<size_t>(30, eject_delay * utils::num_thread_ids());  // Always attempt at least 30 ejects
     while (!in_progress[id] && eject_work[id] >= threshold) {
       eject_work[id] = 0;
+      orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); });  // take over those of exited threads
       if (deferred_destructs[id].size() == 0) break; // nothing to collect
+      if (reclaimer != nullptr && reclaimer->submit(deferred_destructs[id])) break; // handed off to the background threads
       in_progress[id] = true;
       auto deferred = AlignedVector<RetiredObj>(std::move(deferred_destructs[id]));
+      eject_unprotected(deferred);
+      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
+      in_progress[id] = false;
+    }
+  }
 
-      std::vector<std::pair<uint64_t, uint64_t>> announced;
-      epoch_tracker::instance().scan_announced_epochs([&](auto index, auto startTS) { 
-        uint64_t endTS = announcement_slots[index].endTS_ann.load();
-        if(startTS <= endTS) announced.push_back(std::make_pair(startTS, endTS)); 
-      });
+  using retired_batch = std::vector<RetiredObj>;
+  using reclaimer_t = background_reclaimer<acquire_retire_ibr, retired_batch>;
+  friend reclaimer_t;
+  friend utils::thread_exit_hook<acquire_retire_ibr>;
 
-      auto f = [&, this](auto x) {
-        bool reserved = false;
-        for(auto& ann : announced) {
-          if(x.retireTS < ann.first || x.birthTS > ann.second) continue;
-          reserved = true;
-          break;
-        }
+  // Perform the deferred ejects in the batch on a background thread
+  void reclaim_in_background(retired_batch& batch) {
+    auto id = utils::threadID.getTID();
+    in_progress[id] = true;
+    eject_unprotected(batch);
+    // Ejects may cause further ejects to be deferred by this thread, which are kept for the next pass
+    batch.insert(batch.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    in_progress[id] = false;
+  }
+
+  // Called by each thread as it exits. Performs the deferred ejects of the thread
+  // that are safe, and leaves the rest on the orphan list for other threads to adopt
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    if (in_progress[id] || deferred_destructs[id].empty()) return found_work;
+    in_progress[id] = true;
+    auto deferred = retired_batch(std::move(deferred_destructs[id]));
+    deferred_destructs[id].clear();
+    eject_unprotected(deferred);
+    deferred.insert(deferred.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    eject_work[id] = 0;
+    in_progress[id] = false;
+    orphans.push(std::move(deferred));
+    return true;
+  }
+
+  // The union of the announced reservation intervals, kept as disjoint intervals
+  // sorted by their start (and hence also by their end), so that whether the
+  // lifetime of a retired object overlaps any reservation is found by binary
+  // search rather than by testing every announcement
+  struct reservation_index {
+    std::vector<std::pair<uint64_t, uint64_t>> intervals;
+
+    void clear() {
+      intervals.clear();
+    }
+
+    void add(uint64_t startTS, uint64_t endTS) {
+      intervals.emplace_back(startTS, endTS);
+    }
 
-        if (!reserved) {
-          eject(x.obj, x.type);
-          return true;
+    // Sort and merge the intervals. Must be called after adding them and before querying
+    void build() {
+      std::sort(intervals.begin(), intervals.end());
+      size_t n = 0;
+      for (const auto& ann : intervals) {
+        if (n > 0 && ann.first <= intervals[n - 1].second) {
+          intervals[n - 1].second = std::max(intervals[n - 1].second, ann.second);
         } else {
-          return false;
+          intervals[n++] = ann;
         }
-      };
+      }
+      intervals.resize(n);
+    }
 
-      // Remove the deferred decrements that are successfully applied
-      deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
-      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
-      in_progress[id] = false;
+    // Whether any reservation intersects the interval [birthTS, retireTS]
+    bool intersects(uint64_t birthTS, uint64_t retireTS) const {
+      // The first interval that does not end before the object was born
+      auto it = std::lower_bound(intervals.begin(), intervals.end(), birthTS,
+                                 [](const auto& ann, uint64_t t) { return ann.second < t; });
+      return it != intervals.end() && it->first <= retireTS;
     }
+  };
+
+  // Perform every deferred eject in the given list that is no longer protected,
+  // and remove it from the list
+  void eject_unprotected(retired_batch& deferred) {
+    // A reservation always covers the epoch in which its guard was acquired, even if the
+    // upper end was left behind by an earlier guard, or tagged IBR pulled it back further
+    auto& announced = reservation_indices[utils::threadID.getTID()];
+    announced.clear();
+    epoch_tracker::instance().scan_announced_epochs([&](auto index, auto startTS) {
+      uint64_t endTS = announcement_slots[index].endTS_ann.load();
+      announced.add(startTS, std::max(startTS, endTS));
+    });
+    announced.build();
+
+    // Collect the deferred decrements that are safe to apply, so that repeated
+    // decrements of the same object can be applied together
+    std::vector<std::pair<counted_ptr_t, RetireType>> ejects;
+    auto f = [&](const auto& x) {
+      if (!announced.intersects(x.birthTS, x.retireTS)) {
+        ejects.emplace_back(x.obj, x.type);
+        return true;
+      } else {
+        return false;
+      }
+    };
+
+    // Remove the deferred decrements that are successfully applied
+    deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
+    this->eject_coalesced(ejects);
   }
 
-  size_t num_threads;
-  std::vector<LocalSlot> announcement_slots;                      // Announcement array slots
-  std::vector<AlignedBool> in_progress;                           // Local flags to prevent reentrancy while destructing
-  std::vector<AlignedVector<RetiredObj>> deferred_destructs;      // Thread-local lists of pending deferred destructs
-  std::vector<AlignedInt> eject_work;                             // Amortized work to pay for ejecting deferred destructs
-  std::vector<AlignedInt> epoch_work;                             // Amortized work to pay for incrementing the epoch
+  utils::per_thread<LocalSlot> announcement_slots;                      // Announcement array slots
+  utils::per_thread<AlignedBool> in_progress;                           // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedVector<RetiredObj>> deferred_destructs;      // Thread-local lists of pending deferred destructs
+  utils::per_thread<AlignedInt> eject_work;                             // Amortized work to pay for ejecting deferred destructs
+  utils::per_thread<AlignedInt> epoch_work;                             // Amortized work to pay for incrementing the epoch
+  utils::per_thread<utils::Padded<reservation_index>> reservation_indices;  // Thread-local indices of the announced reservations
+  std::unique_ptr<reclaimer_t> reclaimer;                         // Background threads that perform deferred ejects, if enabled
+  orphan_list<RetiredObj> orphans;                                // Deferred ejects left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_ibr> exit_hook{*this};
 };
 
 
@@ -0,0 +1,757 @@
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_NBR_H
+#define CDRC_SMR_ACQUIRE_RETIRE_NBR_H
+
+#include <cassert>
+#include <csetjmp>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../background_reclaimer.h"
+#include "../counted_object.h"
+#include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
+#include "../utils.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// Keeps track of the read phases of every thread for neutralization-based
+// reclamation (NBR), and neutralizes them with signals.
+//
+// A read phase is a section of code that only reads shared memory, so that it
+// can be abandoned at any point and run again from the start. While a thread
+// is in a read phase, a reclaimer can neutralize it by sending it a signal,
+// whose handler jumps back to the start of the read phase. A thread leaves its
+// read phase as soon as it is about to do anything that can not be undone, such
+// as writing to shared memory or allocating memory, after which it can no longer
+// be neutralized until its next read phase. Each thread counts the read phases
+// that it has left or has been neutralized in, so that a reclaimer knows when
+// every thread that it signalled is done with the handles that it read.
+//
+// The snapshots that a thread takes in a read phase may outlive the phase if it
+// ends early, and are still announced. A thread that holds such snapshots does
+// not start another read phase until they are released, so that whenever a
+// phase is neutralized, every snapshot that the thread took in read phases was
+// taken in the neutralized phase, and is abandoned along with it.
+//
+// Neutralization requires POSIX signals and the tgkill system call, so it is only
+// available on Linux. Elsewhere, read phases are never entered, and the backend
+// behaves like hazard pointers.
+struct nbr_tracker {
+
+  // The signal that neutralizes read phases. Applications that use this backend
+  // must not install their own handler for it
+  constexpr static int neutralization_signal = SIGUSR1;
+
+  struct alignas(128) thread_state {
+    std::atomic<bool> restartable{false};       // Whether the thread is in a read phase
+    std::atomic<uint64_t> phases_ended{0};      // The number of read phases that the thread has left or been neutralized in
+    std::atomic<uint64_t> neutralizations{0};   // The number of read phases that the thread has been neutralized in
+    std::atomic<size_t> read_phase_snapshots{0};  // The number of snapshots that the thread took in read phases and still holds
+    std::atomic<int64_t> os_thread{0};          // The kernel's ID of the thread that holds the thread ID
+    sigjmp_buf* checkpoint{nullptr};            // Where the current read phase restarts from
+  };
+
+  static nbr_tracker& instance() {
+    static nbr_tracker tracker;
+    return tracker;
+  }
+
+  // Whether read phases can be neutralized, i.e., whether they are used at all
+  bool neutralization_available() const { return available; }
+
+  // Whether the calling thread is in a read phase
+  bool in_read_phase() const {
+    auto state = current_state;
+    return state != nullptr && state->restartable.load(std::memory_order_relaxed);
+  }
+
+  // The number of read phases that the calling thread has been neutralized in. The
+  // snapshots that it took in read phases before the last one was neutralized have
+  // all been abandoned
+  uint64_t neutralizations() const {
+    assert(current_state != nullptr);
+    return current_state->neutralizations.load(std::memory_order_relaxed);
+  }
+
+  // Whether the calling thread holds snapshots that it took in read phases, in which
+  // case it must not start another read phase
+  bool holds_read_phase_snapshots() const {
+    auto state = current_state;
+    return state != nullptr && state->read_phase_snapshots.load(std::memory_order_relaxed) != 0;
+  }
+
+  // Count a snapshot taken by the calling thread in its current read phase
+  void add_read_phase_snapshot() {
+    assert(in_read_phase());
+    current_state->read_phase_snapshots.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Count the release of a snapshot taken by the calling thread in a read phase
+  void remove_read_phase_snapshot() {
+    assert(holds_read_phase_snapshots());
+    current_state->read_phase_snapshots.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // Enter a read phase, which restarts from the given checkpoint when neutralized.
+  // Anything that might allocate is done before the phase begins
+  void begin_read_phase(sigjmp_buf* checkpoint) {
+    assert(available && !in_read_phase());
+    auto& state = states[utils::threadID.getTID()];
+    current_state = &state;
+    state.checkpoint = checkpoint;
+    state.os_thread.store(os_thread_id(), std::memory_order_relaxed);
+    state.restartable.store(true, std::memory_order_seq_cst);
+  }
+
+  // Leave the read phase of the calling thread, if it is in one. Everything that
+  // the thread announced during the phase is visible to a reclaimer that sees
+  // the phase end
+  void end_read_phase() {
+    auto state = current_state;
+    if (state == nullptr || !state->restartable.load(std::memory_order_relaxed)) return;
+    state->restartable.store(false, std::memory_order_seq_cst);
+    state->phases_ended.fetch_add(1, std::memory_order_release);
+  }
+
+  // Signal every other thread that is in a read phase, and record the phases
+  // that they were in, to be checked by readers_neutralized
+  void neutralize_readers(std::vector<std::pair<size_t, uint64_t>>& readers) {
+    readers.clear();
+    if (!available) return;
+    size_t self = utils::threadID.getTID();
+    for (size_t id = 0; id < utils::num_thread_ids(); id++) {
+      if (id == self) continue;
+      auto& state = states[id];
+      auto phase = state.phases_ended.load(std::memory_order_seq_cst);
+      if (!state.restartable.load(std::memory_order_seq_cst)) continue;
+      readers.emplace_back(id, phase);
+      send_signal(state.os_thread.load(std::memory_order_relaxed));
+    }
+  }
+
+  // Whether every thread recorded by neutralize_readers has since left or been
+  // neutralized in the read phase that it was in. Removes those that have
+  bool readers_neutralized(std::vector<std::pair<size_t, uint64_t>>& readers) {
+    std::erase_if(readers, [this](const auto& reader) {
+      return states[reader.first].phases_ended.load(std::memory_order_acquire) != reader.second;
+    });
+    return readers.empty();
+  }
+
+ private:
+
+  nbr_tracker() {
+#if defined(__linux__) && defined(SYS_tgkill) && defined(SYS_gettid)
+    struct sigaction action{};
+    action.sa_handler = &handle_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    available = sigaction(neutralization_signal, &action, nullptr) == 0;
+#endif
+  }
+
+  // Neutralize the read phase of the signalled thread, if it is still in one.
+  // Signals that arrive after the phase has ended, or that were meant for a
+  // thread that has since exited, are ignored
+  static void handle_signal(int) {
+    auto state = current_state;
+    if (state == nullptr || !state->restartable.load(std::memory_order_relaxed)) return;
+    state->restartable.store(false, std::memory_order_relaxed);
+    state->neutralizations.fetch_add(1, std::memory_order_relaxed);
+    state->read_phase_snapshots.store(0, std::memory_order_relaxed);
+    state->phases_ended.fetch_add(1, std::memory_order_release);
+    siglongjmp(*state->checkpoint, 1);
+  }
+
+  static int64_t os_thread_id() {
+#if defined(__linux__) && defined(SYS_gettid)
+    thread_local int64_t id = syscall(SYS_gettid);
+    return id;
+#else
+    return 0;
+#endif
+  }
+
+  static void send_signal([[maybe_unused]] int64_t os_thread) {
+#if defined(__linux__) && defined(SYS_tgkill)
+    syscall(SYS_tgkill, getpid(), os_thread, neutralization_signal);
+#endif
+  }
+
+  inline static thread_local thread_state* current_state = nullptr;
+
+  bool available{false};
+  utils::per_thread<thread_state> states;
+};
+
+}  // namespace internal
+
+// Run f as a read phase of neutralization-based reclamation. If a reclaimer
+// neutralizes the read phase, f is abandoned wherever it is and run again from
+// the start, so f must be safe to run any number of times, and must not hold
+// any resources that need to be released, such as locks or allocated memory,
+// while it only reads. Snapshots taken by f must not outlive f. Any operation
+// of an NBR-managed pointer that writes to shared memory, allocates, or changes
+// a reference count ends the read phase first, after which the rest of f runs
+// as usual and is not restarted. Writes to shared memory by any other means
+// must be preceded by a call to cdrc::end_read_phase(). Calls nested in another
+// read phase run as part of the outer one. Calls made while holding snapshots
+// from a read phase that has ended, e.g., by a nested call after the outer read
+// phase wrote, run outside of a read phase.
+template<typename F>
+std::invoke_result_t<F> with_nbr_read_phase(F&& f) {
+  auto& tracker = internal::nbr_tracker::instance();
+  if (!tracker.neutralization_available() || tracker.in_read_phase() || tracker.holds_read_phase_snapshots()) return std::invoke(f);
+  // End the read phase however f exits, including by throwing, so that no
+  // neutralization jumps back into this frame once it is gone. Constructed
+  // before the checkpoint, so that restarting does not construct it again
+  struct read_phase_scope {
+    internal::nbr_tracker& tracker;
+    ~read_phase_scope() { tracker.end_read_phase(); }
+  } scope{tracker};
+  sigjmp_buf checkpoint;
+  sigsetjmp(checkpoint, 1);  // A neutralized read phase restarts from here
+  tracker.begin_read_phase(&checkpoint);
+  return std::invoke(f);
+}
+
+// End the read phase of the calling thread, if it is in one, so that it can
+// safely perform actions that can not be undone
+inline void end_read_phase() {
+  internal::nbr_tracker::instance().end_read_phase();
+}
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses neutralization-based reclamation (NBR). Outside of
+// read phases (see with_nbr_read_phase), it works like hazard pointers. Inside
+// a read phase, reads announce the handles that they read without waiting for
+// the announcement to become visible, or validating that the handle is still
+// there, since a reclaimer first neutralizes every thread that is in a read
+// phase, and only then scans the announcements. A thread that is neutralized
+// discards what it read, while one that leaves its read phase makes its
+// announcements visible as it does so. A reclaimer does not wait for the
+// threads that it signals, but keeps its batch of deferred ejects aside until
+// they have all responded, so a stalled thread delays reclamation only until
+// it is next scheduled, and holds back no more than its announced handles.
+//
+// T =              The underlying type of the object being protected
+// snapshot_slots = The number of additional announcement slots available for
+//                  snapshot pointers, both inside and outside of read phases.
+//                  More allows more snapshots to be alive at a time, but makes
+//                  reclamation slower
+// eject_delay =    The maximum number of deferred ejects that will be held by
+//                  any one worker thread is at most eject_delay * #threads.
+// object_policy =  Customizes the representation and allocation of the managed
+//                  objects. See object_policy.h
+//
+template<typename T, size_t snapshot_slots = 7, size_t eject_delay = 2, typename object_policy = default_object_policy>
+struct acquire_retire_nbr : public memory_manager_base<T, acquire_retire_nbr<T, snapshot_slots, eject_delay, object_policy>, object_policy> {
+
+  using base = memory_manager_base<T, acquire_retire_nbr<T, snapshot_slots, eject_delay, object_policy>, object_policy>;
+
+  using base::eject;
+
+ private:
+
+  using counted_object_t = counted_object<T, object_policy>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+
+  using retired_batch = std::vector<std::pair<counted_ptr_t, RetireType>>;
+  using reclaimer_t = background_reclaimer<acquire_retire_nbr, retired_batch>;
+  friend reclaimer_t;
+  friend utils::thread_exit_hook<acquire_retire_nbr>;
+
+  // Align to cache line boundary to avoid false sharing
+  struct alignas(128) LocalSlot {
+    std::atomic<counted_ptr_t> announcement{nullptr};
+    std::array<std::atomic<counted_ptr_t>, snapshot_slots> snapshot_announcements{};
+    std::array<std::atomic<counted_ptr_t>, snapshot_slots> read_phase_announcements{};
+    uint64_t neutralizations{0};  // The number of neutralizations of the thread when the read phase slots were last used
+
+    LocalSlot() {
+      for (auto &a : snapshot_announcements) std::atomic_init(&a, nullptr);
+      for (auto &a : read_phase_announcements) std::atomic_init(&a, nullptr);
+    }
+  };
+
+  // A batch of deferred ejects that is waiting for the threads that were in
+  // read phases when it was set aside to be neutralized
+  struct alignas(128) pending_batch {
+    AlignedVector<std::pair<counted_ptr_t, RetireType>> batch;
+    std::vector<std::pair<size_t, uint64_t>> readers;     // The signalled threads and their read phases
+    bool active{false};
+  };
+
+ public:
+
+  static acquire_retire_nbr& instance() {
+    static acquire_retire_nbr ar;
+    return ar;
+  }
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    tracker.end_read_phase();
+    return this->template allocate_object<counted_object_t>(std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    tracker.end_read_phase();
+    return this->template allocate_object_with<counted_object_t>(alloc, std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    this->deallocate_object(p);
+  }
+
+  // Every operation that can not be undone ends the read phase first
+
+  void before_update() {
+    tracker.end_read_phase();
+  }
+
+  bool increment_ref_cnt(counted_ptr_t ptr) {
+    tracker.end_read_phase();
+    return base::increment_ref_cnt(ptr);
+  }
+
+  bool increment_weak_cnt(counted_ptr_t ptr) requires object_policy::weak_references {
+    tracker.end_read_phase();
+    return base::increment_weak_cnt(ptr);
+  }
+
+  void decrement_ref_cnt(counted_ptr_t ptr, size_t count = 1) {
+    tracker.end_read_phase();
+    base::decrement_ref_cnt(ptr, count);
+  }
+
+  void decrement_weak_cnt(counted_ptr_t ptr, size_t count = 1) requires object_policy::weak_references {
+    tracker.end_read_phase();
+    base::decrement_weak_cnt(ptr, count);
+  }
+
+  // An RAII wrapper around an acquired handle. Automatically
+  // releases the handle when the wrapper goes out of scope.
+  template<typename U>
+  struct acquired_pointer {
+   public:
+    friend struct acquire_retire_nbr;
+
+    acquired_pointer() : value(nullptr), slot(nullptr), read_phase_slot(false) {}
+
+    acquired_pointer(U value_, std::atomic<counted_ptr_t>* slot_, bool read_phase_slot_ = false)
+      : value(value_), slot(slot_), read_phase_slot(read_phase_slot_) {}
+
+    acquired_pointer(acquired_pointer&& other) noexcept : value(other.value), slot(other.slot), read_phase_slot(other.read_phase_slot) {
+      other.value = nullptr;
+      other.slot = nullptr;
+    }
+
+    ~acquired_pointer() { clear_protection(); }
+
+    acquired_pointer& operator=(acquired_pointer&& other) noexcept {
+      clear_protection();
+      value = other.value;
+      slot = other.slot;
+      read_phase_slot = other.read_phase_slot;
+      other.value = nullptr;
+      other.slot = nullptr;
+      return *this;
+    }
+
+    void swap(acquired_pointer &other) {
+      std::swap(value, other.value);
+      std::swap(slot, other.slot);
+      std::swap(read_phase_slot, other.read_phase_slot);
+    }
+
+    U& get() {
+      return value;
+    }
+
+    U get() const {
+      return value;
+    }
+
+    bool is_protected() const {
+      return slot != nullptr && value != nullptr;
+    }
+
+    void clear_protection() {
+      if (value != nullptr && slot != nullptr) {
+        slot->store(nullptr, std::memory_order_release);
+        if (read_phase_slot) nbr_tracker::instance().remove_read_phase_snapshot();
+      }
+    }
+
+    void clear() {
+      clear_protection();
+      value = nullptr;
+      slot = nullptr;
+    }
+
+   private:
+    U value;
+    std::atomic<counted_ptr_t> *slot;
+    bool read_phase_slot;         // Whether the slot is one of the read phase slots
+  };
+
+  acquire_retire_nbr() = default;
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    auto id = utils::threadID.getTID();
+    auto& announcement = announcement_slots[id].announcement;
+    U result;
+    if (reading_in_read_phase(id)) {
+      result = p->load(std::memory_order_seq_cst);
+      announcement.store(static_cast<counted_ptr_t>(result), std::memory_order_relaxed);
+      return acquired_pointer<U>(result, &announcement);
+    }
+    do {
+      result = p->load(std::memory_order_seq_cst);
+      announcement.store(static_cast<counted_ptr_t>(result), std::memory_order_seq_cst);
+    } while (p->load(std::memory_order_seq_cst) != result);
+    return acquired_pointer<U>(result, &announcement);
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    tracker.end_read_phase();
+    auto id = utils::threadID.getTID();
+    announcement_slots[id].announcement.store(static_cast<counted_ptr_t>(p), std::memory_order_seq_cst);
+    return acquired_pointer<U>(p, &announcement_slots[id].announcement);
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return {};
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    auto id = utils::threadID.getTID();
+    if (reading_in_read_phase(id)) {
+      if (auto* slot = get_free_read_phase_slot(id); slot != nullptr) {
+        U result = p->load(std::memory_order_seq_cst);
+        if (result == nullptr) return acquired_pointer<U>(result, nullptr);
+        slot->store(static_cast<counted_ptr_t>(result), std::memory_order_relaxed);
+        tracker.add_read_phase_snapshot();
+        return acquired_pointer<U>(result, slot, true);
+      }
+      // Out of slots, so continue outside of the read phase
+      tracker.end_read_phase();
+    }
+
+    auto *slot = get_free_slot(id);
+
+    // If no snapshot slot is available, just increment the reference count
+    if (slot == nullptr) {
+      while (true) {
+        auto a = acquire(p);
+        if (a.get() && increment_ref_cnt(a.get())) return acquired_pointer<U>(a.get(), nullptr);
+        else if (a.get() == nullptr || p->load() == a.get()) return acquired_pointer<U>(nullptr, nullptr);
+      }
+    }
+
+    U result;
+    do {
+      result = p->load(std::memory_order_seq_cst);
+      PARLAY_PREFETCH(result, 0, 0);
+      if (result == nullptr) {
+        slot->store(nullptr, std::memory_order_release);
+        return acquired_pointer<U>(result, nullptr);
+      }
+      slot->store(static_cast<counted_ptr_t>(result), std::memory_order_seq_cst);
+    } while (p->load(std::memory_order_seq_cst) != result);
+    return acquired_pointer<U>(result, slot);
+  }
+
+  void release() {
+    auto id = utils::threadID.getTID();
+    auto &slot = announcement_slots[id].announcement;
+    slot.store(nullptr, std::memory_order_release);
+  }
+
+  void retire(counted_ptr_t p, RetireType type) {
+    tracker.end_read_phase();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].emplace_back(p, type);
+    work_toward_deferred_decrements(1);
+  }
+
+  // Start performing deferred ejects on num_workers dedicated background threads.
+  // Application threads then hand their deferred ejects over to the background
+  // threads, unless more than queue_capacity batches are already waiting, in
+  // which case they perform them inline as usual. The background threads need
+  // thread IDs of their own. Must not be called concurrently with other operations.
+  void start_background_reclamation(size_t num_workers = 1, size_t queue_capacity = 64) {
+    assert(reclaimer == nullptr);
+    reclaimer = std::make_unique<reclaimer_t>(*this, num_workers, queue_capacity);
+  }
+
+  // Stop the background threads. Any ejects that they had not yet performed are
+  // taken over by the calling thread. Must not be called concurrently with other operations.
+  void stop_background_reclamation() {
+    assert(reclaimer != nullptr);
+    auto leftovers = reclaimer->stop();
+    reclaimer.reset();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].insert(deferred_destructs[id].end(), leftovers.begin(), leftovers.end());
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_nbr() {
+    if (reclaimer != nullptr) stop_background_reclamation();
+    in_progress.for_each([](auto& flag) { flag = true; });
+    pending_batches.for_each([&](auto& pending) {
+      auto& deferred = deferred_destructs[0];
+      deferred.insert(deferred.end(), pending.batch.begin(), pending.batch.end());
+      pending.batch.clear();
+      pending.active = false;
+    });
+
+    // Loop because the destruction of one object could trigger the deferred
+    // destruction of another object (possibly even in another thread), and
+    // so on recursively.
+    while (!orphans.empty() || deferred_destructs.any_of([](const auto &v) { return !v.empty(); }) ||
+           this->destructions_pending()) {
+
+      // Move all of the contents from the deferred destruction lists
+      // into a single local list. We don't want to just iterate the
+      // deferred lists because a destruction may trigger another
+      // deferred destruction to be added to one of the lists, which
+      // would invalidate its iterators
+      std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
+      orphans.adopt([&](const auto& x) { destructs.push_back(x); });
+      deferred_destructs.for_each([&](auto &v) {
+        destructs.insert(destructs.end(), v.begin(), v.end());
+        v.clear();
+      });
+
+      // Perform all of the pending deferred destructions
+      this->eject_coalesced(destructs);
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
+    }
+  }
+
+ private:
+
+  // Whether the calling thread is reading in a read phase. Its announcement slots
+  // are allocated on first use, which can not be rolled back, so a thread that
+  // has not used them yet leaves its read phase instead
+  bool reading_in_read_phase(size_t id) {
+    if (!tracker.in_read_phase()) [[likely]] return false;
+    if (announcement_slots.is_allocated(id)) [[likely]] return true;
+    tracker.end_read_phase();
+    return false;
+  }
+
+  [[nodiscard]] std::atomic<counted_ptr_t> *get_free_slot(size_t id) {
+    assert(snapshot_slots != 0);
+    for (auto& slot : announcement_slots[id].snapshot_announcements) {
+      if (slot.load(std::memory_order_acquire) == nullptr) return std::addressof(slot);
+    }
+    return nullptr;
+  }
+
+  // A neutralized read phase skips the destructors of its snapshots, so if the
+  // thread has been neutralized since the read phase slots were last used, they
+  // are all released. Every snapshot that the thread took in read phases up to
+  // then was taken in a neutralized phase (see nbr_tracker)
+  [[nodiscard]] std::atomic<counted_ptr_t> *get_free_read_phase_slot(size_t id) {
+    auto& local = announcement_slots[id];
+    auto neutralizations = tracker.neutralizations();
+    if (local.neutralizations != neutralizations) {
+      for (auto& slot : local.read_phase_announcements) slot.store(nullptr, std::memory_order_relaxed);
+      local.neutralizations = neutralizations;
+    }
+    for (auto& slot : local.read_phase_announcements) {
+      if (slot.load(std::memory_order_relaxed) == nullptr) return std::addressof(slot);
+    }
+    return nullptr;
+  }
+
+  // Apply the function f to every currently announced handle
+  template<typename F>
+  void scan_slots(F &&f) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    announcement_slots.for_each([&](const auto &announcement_slot) {
+      auto x = announcement_slot.announcement.load(std::memory_order_seq_cst);
+      if (x != nullptr) f(x);
+      for (const auto &free_slot : announcement_slot.snapshot_announcements) {
+        auto y = free_slot.load(std::memory_order_seq_cst);
+        if (y != nullptr) f(y);
+      }
+      for (const auto &read_phase_slot : announcement_slot.read_phase_announcements) {
+        auto y = read_phase_slot.load(std::memory_order_seq_cst);
+        if (y != nullptr) f(y);
+      }
+    });
+  }
+
+  // Once enough deferred ejects have built up, set them aside and neutralize
+  // the threads that are in read phases. The batch is performed by the first
+  // retire after every one of them has responded
+  void work_toward_deferred_decrements(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    if (in_progress[id]) return;
+    amortized_work[id] = amortized_work[id] + work;
+    auto threshold = std::max<size_t>(30, eject_delay * utils::num_thread_ids());  // Always attempt at least 30 ejects
+    bool overdue = amortized_work[id] >= threshold;
+    if (overdue) amortized_work[id] = 0;
+    auto& pending = pending_batches[id];
+    if (pending.active) {
+      finish_pending_batch(id, overdue);
+      return;
+    }
+    if (!overdue) return;
+    orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); });  // take over those of exited threads
+    if (deferred_destructs[id].size() == 0) return; // nothing to collect
+    if (reclaimer != nullptr && reclaimer->submit(deferred_destructs[id])) return; // handed off to the background threads
+    std::swap(pending.batch, deferred_destructs[id]);
+    tracker.neutralize_readers(pending.readers);
+    pending.active = true;
+    finish_pending_batch(id, false);
+  }
+
+  // Perform the unprotected ejects of the thread's pending batch if every thread
+  // that was in a read phase when it was set aside has since been neutralized,
+  // or has left its read phase. A signalled thread only responds once it runs, so
+  // if it has not, and the thread has built up another batch's worth of work in
+  // the meantime, give way to it in case it shares a core with this one
+  void finish_pending_batch(size_t id, bool overdue) {
+    auto& pending = pending_batches[id];
+    if (!tracker.readers_neutralized(pending.readers)) {
+      if (overdue) std::this_thread::yield();
+      return;
+    }
+    in_progress[id] = true;
+    eject_unprotected(pending.batch);
+    deferred_destructs[id].insert(deferred_destructs[id].end(), pending.batch.begin(), pending.batch.end());
+    pending.batch.clear();
+    pending.active = false;
+    in_progress[id] = false;
+  }
+
+  // Perform the deferred ejects in the batch on a background thread, which
+  // waits for the threads that are in read phases to be neutralized
+  void reclaim_in_background(retired_batch& batch) {
+    auto id = utils::threadID.getTID();
+    auto& pending = pending_batches[id];
+    tracker.neutralize_readers(pending.readers);
+    while (!tracker.readers_neutralized(pending.readers)) std::this_thread::yield();
+    in_progress[id] = true;
+    eject_unprotected(batch);
+    // Ejects may cause further ejects to be deferred by this thread, which are kept for the next pass
+    batch.insert(batch.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    in_progress[id] = false;
+  }
+
+  // Called by each thread as it exits. Withdraws the announcements left behind by
+  // neutralized read phases, and leaves the thread's deferred ejects on the orphan
+  // list for other threads to adopt, since it can not wait for read phases to end
+  bool on_thread_exit(size_t id) {
+    for (auto& slot : announcement_slots[id].read_phase_announcements) slot.store(nullptr, std::memory_order_release);
+    bool found_work = this->flush_destructions();
+    if (in_progress[id]) return found_work;
+    auto& pending = pending_batches[id];
+    auto& deferred = deferred_destructs[id];
+    deferred.insert(deferred.end(), pending.batch.begin(), pending.batch.end());
+    pending.batch.clear();
+    pending.active = false;
+    amortized_work[id] = 0;
+    if (deferred.empty()) return found_work;
+    auto orphaned = retired_batch(std::move(deferred));
+    deferred.clear();
+    orphans.push(std::move(orphaned));
+    return true;
+  }
+
+  // Perform every deferred eject in the given list whose object is not currently
+  // announced, and remove it from the list. An object that is deferred / announced
+  // multiple times has one more protection of each kind of action than it has
+  // announcements, since the first announcement needs to protect up to two actions
+  void eject_unprotected(retired_batch& deferred) {
+    auto& announced = announced_handles[utils::threadID.getTID()];
+    announced.clear();
+    scan_slots([&](auto reserved) { announced.push_back(reserved); });
+    std::sort(announced.begin(), announced.end());
+
+    // Sorting the list groups repeated ejects together, so that they are applied at once
+    std::sort(deferred.begin(), deferred.end());
+    auto kept = deferred.begin();
+    for (auto it = deferred.begin(); it != deferred.end();) {
+      auto [ptr, type] = *it;
+      auto next = std::find_if(it, deferred.end(), [&](const auto& x) { return x != *it; });
+      size_t count = next - it;
+      auto [first, last] = std::equal_range(announced.begin(), announced.end(), ptr);
+      size_t num_protected = first == last ? 0 : std::min<size_t>(count, (last - first) + 1);
+      if (num_protected < count) this->eject(ptr, type, count - num_protected);
+      kept = std::fill_n(kept, num_protected, std::make_pair(ptr, type));
+      it = next;
+    }
+
+    // Remove the deferred decrements that are successfully applied
+    deferred.erase(kept, deferred.end());
+  }
+
+  nbr_tracker& tracker{nbr_tracker::instance()};
+  utils::per_thread<LocalSlot> announcement_slots;          // Announcement array slots
+  utils::per_thread<AlignedBool> in_progress;               // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedVector<std::pair<counted_ptr_t, RetireType>>> deferred_destructs;   // Thread-local lists of pending deferred destructs
+  utils::per_thread<AlignedInt> amortized_work;             // Amortized work to pay for ejecting deferred destructs
+  utils::per_thread<pending_batch> pending_batches;         // Thread-local batches awaiting the neutralization of readers
+  utils::per_thread<AlignedVector<counted_ptr_t>> announced_handles;   // Thread-local storage for the handles found by a scan
+  std::unique_ptr<reclaimer_t> reclaimer;             // Background threads that perform deferred ejects, if enabled
+  orphan_list<std::pair<counted_ptr_t, RetireType>> orphans;      // Deferred ejects left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_nbr> exit_hook{*this};
+};
+
+// Whether the memory manager is the NBR backend, whose reads only skip their
+// fences inside of read phases
+template<typename memory_manager>
+constexpr bool is_nbr_backend = false;
+
+template<typename T, size_t snapshot_slots, size_t eject_delay, typename object_policy>
+constexpr bool is_nbr_backend<acquire_retire_nbr<T, snapshot_slots, eject_delay, object_policy>> = true;
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif  // CDRC_SMR_ACQUIRE_RETIRE_NBR_H
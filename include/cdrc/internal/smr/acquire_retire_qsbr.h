@@ -0,0 +1,420 @@
+#ifndef CDRC_SMR_ACQUIRE_RETIRE_QSBR_H
+#define CDRC_SMR_ACQUIRE_RETIRE_QSBR_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../background_reclaimer.h"
+#include "../counted_object.h"
+#include "../epoch_tracker.h"
+#include "../memory_manager_base.h"
+#include "../object_policy.h"
+#include "../orphan_list.h"
+#include "../utils.h"
+
+namespace cdrc {
+
+namespace internal {
+
+// Keeps track of the quiescent states of every thread for quiescent-state-based
+// reclamation (QSBR).
+//
+// A thread is in a quiescent state whenever it holds no unprotected references
+// that it read from shared memory, i.e., no snapshots or raw pointers, e.g.,
+// between two operations on a data structure. Counted references, such as an
+// rc_ptr, can be held across quiescent states. Rather
+// than announcing the start and end of each of its reads, like EBR, each online
+// thread announces the global epoch in which it last passed through a quiescent
+// state. Whatever was retired before that epoch is no longer reachable by the
+// thread. A thread that is offline holds no unprotected references at all, and
+// announces nothing. Threads are offline until they first go online.
+struct qsbr_tracker {
+
+  using epoch_type = epoch_tracker::epoch_type;
+  using Epoch = epoch_tracker::Epoch;
+  constexpr static epoch_type no_epoch = epoch_tracker::no_epoch;  // Announced by threads that are offline
+
+  static qsbr_tracker& instance() {
+    static qsbr_tracker tracker;
+    return tracker;
+  }
+
+  // Return the value of the current global epoch
+  epoch_type get_current_epoch() {
+    return global_epoch.load();
+  }
+
+  // Increment the global epoch
+  auto advance_global_epoch() {
+    return global_epoch.fetch_add(1);
+  }
+
+  // Announce that the calling thread is in a quiescent state. Nothing needs to be
+  // written if the thread has already announced a quiescent state in the current
+  // epoch, since it can not have read anything from an earlier epoch since then.
+  // Brings the thread online if it was offline.
+  void quiescent_state() {
+    auto id = utils::threadID.getTID();
+    auto current = global_epoch.load(std::memory_order_acquire);
+    if (quiescent_epoch[id].load(std::memory_order_relaxed) != current) {
+      quiescent_epoch[id].store(current, std::memory_order_seq_cst);
+    }
+  }
+
+  // Bring the calling thread online, after which it may read from shared memory
+  void online() {
+    auto id = utils::threadID.getTID();
+    quiescent_epoch[id].exchange(global_epoch.load(std::memory_order_acquire));
+  }
+
+  // Take the calling thread offline, after which it must not hold any unprotected
+  // references, or read from shared memory, until it comes back online
+  void offline() {
+    auto id = utils::threadID.getTID();
+    quiescent_epoch[id].store(no_epoch, std::memory_order_release);
+  }
+
+  bool is_online() {
+    auto id = utils::threadID.getTID();
+    return quiescent_epoch[id].load(std::memory_order_relaxed) != no_epoch;
+  }
+
+  // Return the earliest epoch in which an online thread last announced a quiescent
+  // state. Returns numeric_limits<epoch_type>::max() if no thread is online
+  epoch_type get_min_quiescent_epoch() {
+    epoch_type answer = std::numeric_limits<epoch_type>::max();
+    auto nt = utils::num_thread_ids();
+    for (size_t i = 0; i < nt; i++) {
+      answer = std::min(answer, quiescent_epoch[i].load(std::memory_order_acquire));
+    }
+    return answer;
+  }
+
+private:
+  friend utils::thread_exit_hook<qsbr_tracker>;
+
+  qsbr_tracker() : global_epoch(0) {}
+
+  // A thread that exits holds no unprotected references, and the next thread to be
+  // given its ID starts out offline
+  bool on_thread_exit(size_t id) {
+    quiescent_epoch[id].store(no_epoch, std::memory_order_release);
+    return false;
+  }
+
+  Epoch global_epoch;
+  utils::per_thread<Epoch> quiescent_epoch;
+  utils::thread_exit_hook<qsbr_tracker> exit_hook{*this};
+};
+
+}  // namespace internal
+
+// Announce that the calling thread holds no snapshots or raw pointers that it read
+// from pointers that are managed by the QSBR backend, e.g., because it is between
+// operations. Those obtained before the call must not be used after it, while
+// rc_ptrs remain valid. Brings the thread online if it was offline
+inline void quiescent_state() {
+  internal::qsbr_tracker::instance().quiescent_state();
+}
+
+// Bring the calling thread online, which it must be in order to read any pointer
+// that is managed by the QSBR backend
+inline void online() {
+  internal::qsbr_tracker::instance().online();
+}
+
+// Take the calling thread offline, e.g., before it blocks or sleeps, so that it
+// does not delay reclamation in the meantime. Until it comes back online, the
+// thread must not read any pointer that is managed by the QSBR backend, or hold
+// any snapshots or raw pointers that it read from one, but it may still write to
+// them and hold rc_ptrs. Threads go offline automatically when they exit
+inline void offline() {
+  internal::qsbr_tracker::instance().offline();
+}
+
+namespace internal {
+
+// An interface for safe memory reclamation that protects reference-counted
+// resources by deferring their reference count decrements until no thread
+// is still reading them.
+//
+// This implementation uses quiescent-state-based reclamation (QSBR), in which
+// reads do no work at all beyond loading the pointer. Instead, each thread that
+// reads must be online, and must regularly announce a quiescent state, in which
+// it holds no snapshots, such as the end of each iteration of an event loop
+//
+//   cdrc::online();
+//   while (running) {
+//     // handle an event
+//     cdrc::quiescent_state();
+//   }
+//   cdrc::offline();
+//
+// A deferred decrement is applied once every online thread has announced a
+// quiescent state in a later epoch than the one in which it was retired. A
+// thread that stays online without ever announcing a quiescent state therefore
+// prevents the reclamation of everything retired after its last one, so threads
+// should go offline before they block. Threads that are offline may still write
+// to the pointers, but must not read them.
+//
+// T =               The underlying type of the object being protected
+// epoch_frequency = How often to update the global epoch. More often (lower value)
+//                   will reduce memory usage, but makes quiescent states more costly.
+// eject_delay =     The maximum number of deferred ejects that will be held by
+//                   any one worker thread is at most eject_delay * #threads.
+// object_policy =   Customizes the representation and allocation of the managed
+//                   objects. See object_policy.h
+//
+template<typename T, size_t epoch_frequency = 10, size_t eject_delay = 2, typename object_policy = default_object_policy>
+struct acquire_retire_qsbr : public memory_manager_base<T, acquire_retire_qsbr<T, epoch_frequency, eject_delay, object_policy>, object_policy> {
+
+  using base = memory_manager_base<T, acquire_retire_qsbr<T, epoch_frequency, eject_delay, object_policy>, object_policy>;
+
+  using base::increment_ref_cnt;
+  using base::eject;
+  using base::decrement_weak_cnt;
+
+private:
+  using counted_object_t = counted_object<T, object_policy>;
+  using counted_ptr_t = std::add_pointer_t<counted_object_t>;
+
+public:
+
+  static acquire_retire_qsbr& instance() {
+    static acquire_retire_qsbr ar;
+    return ar;
+  }
+
+  template<typename... Args>
+  counted_ptr_t create_object(Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object<counted_object_t>(std::forward<Args>(args)...);
+  }
+
+  template<typename Alloc, typename... Args>
+  counted_ptr_t create_object_with_allocator(const Alloc& alloc, Args &&... args) {
+    work_toward_advancing_epoch(1);
+    return this->template allocate_object_with<counted_object_t>(alloc, std::forward<Args>(args)...);
+  }
+
+  void delete_object(counted_ptr_t p) {
+    this->deallocate_object(p);
+  }
+
+  struct RetiredObj {
+    counted_ptr_t obj; uint64_t retireTS; RetireType type;
+    RetiredObj(counted_ptr_t obj, uint64_t ts, RetireType type_) : obj(obj), retireTS(ts), type(type_) {}
+  };
+
+  template<typename U>
+  using acquired_pointer = basic_acquired_pointer<U>;
+
+  acquire_retire_qsbr() {
+    qsbr_tracker::instance();  // touch the tracker to force it to initialize before this object, since it must be destructed after it
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> acquire(const std::atomic<U> *p) {
+    assert(qsbr_tracker::instance().is_online());
+    return {p->load(std::memory_order_acquire)};
+  }
+
+  // Like acquire, but assuming that the caller already has a
+  // copy of the handle and knows that it is protected
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve(U p) {
+    return {p};
+  }
+
+  // Dummy function for when we need to conditionally reserve
+  // something, but might need to reserve nothing
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> reserve_nothing() const {
+    return {};
+  }
+
+  template<typename U>
+  [[nodiscard]] acquired_pointer<U> protect_snapshot(const std::atomic<U> *p) {
+    assert(qsbr_tracker::instance().is_online());
+    auto ptr = p->load(std::memory_order_acquire);
+    if (ptr != nullptr && ptr->get_use_count() == 0) ptr = nullptr;
+    return {ptr};
+  }
+
+  void release() { }
+
+  void retire(counted_ptr_t p, RetireType type) {
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].emplace_back(p, qsbr_tracker::instance().get_current_epoch(), type);
+    work_toward_ejects(1);
+  }
+
+  // Start performing deferred ejects on num_workers dedicated background threads.
+  // Application threads then hand their deferred ejects over to the background
+  // threads, unless more than queue_capacity batches are already waiting, in
+  // which case they perform them inline as usual. The background threads need
+  // thread IDs of their own, but never go online. Must not be called concurrently
+  // with other operations.
+  void start_background_reclamation(size_t num_workers = 1, size_t queue_capacity = 64) {
+    assert(reclaimer == nullptr);
+    reclaimer = std::make_unique<reclaimer_t>(*this, num_workers, queue_capacity);
+  }
+
+  // Stop the background threads. Any ejects that they had not yet performed are
+  // taken over by the calling thread. Must not be called concurrently with other operations.
+  void stop_background_reclamation() {
+    assert(reclaimer != nullptr);
+    auto leftovers = reclaimer->stop();
+    reclaimer.reset();
+    auto id = utils::threadID.getTID();
+    deferred_destructs[id].insert(deferred_destructs[id].end(), leftovers.begin(), leftovers.end());
+  }
+
+  // Perform any remaining deferred destruction. Need to be very careful
+  // about additional objects being queued for deferred destruction by
+  // an object that was just destructed.
+  ~acquire_retire_qsbr() {
+    if (reclaimer != nullptr) stop_background_reclamation();
+    in_progress.for_each([](auto& flag) { flag = true; });
+
+    // Loop because the destruction of one object could trigger the deferred
+    // destruction of another object (possibly even in another thread), and
+    // so on recursively.
+    while (!orphans.empty() || deferred_destructs.any_of([](const auto &v) { return !v.empty(); }) ||
+           this->destructions_pending()) {
+
+      // Move all of the contents from the deferred destruction lists
+      // into a single local list. We don't want to just iterate the
+      // deferred lists because a destruction may trigger another
+      // deferred destruction to be added to one of the lists, which
+      // would invalidate its iterators
+      std::vector<std::pair<counted_ptr_t,RetireType>> destructs;
+      orphans.adopt([&](const auto& x) { destructs.emplace_back(x.obj, x.type); });
+      deferred_destructs.for_each([&](auto &v) {
+        for (const auto& x : v) {
+          destructs.emplace_back(x.obj, x.type);
+        }
+        v.clear();
+      });
+
+      // Perform all of the pending deferred ejects
+      this->eject_coalesced(destructs);
+
+      // Dispose of any objects left queued by a finite destruction budget
+      this->drain_destruction_queues();
+    }
+  }
+
+private:
+
+  void work_toward_advancing_epoch(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    epoch_work[id] = epoch_work[id] + work;
+    if(epoch_work[id] >= epoch_frequency * utils::num_thread_ids()) {
+      epoch_work[id] = 0;
+      qsbr_tracker::instance().advance_global_epoch();
+    }
+  }
+
+  void work_toward_ejects(size_t work = 1) {
+    auto id = utils::threadID.getTID();
+    eject_work[id] = eject_work[id] + work;
+    auto threshold = std::max<size_t>(30, eject_delay * utils::num_thread_ids());  // Always attempt at least 30 ejects
+    while (!in_progress[id] && eject_work[id] >= threshold) {
+      eject_work[id] = 0;
+      bool adopted = false;
+      orphans.adopt([&](const auto& x) { deferred_destructs[id].push_back(x); adopted = true; });  // take over those of exited threads
+      if (deferred_destructs[id].size() == 0) break; // nothing to collect
+      // Unless some thread has passed a quiescent state since the last attempt, nothing
+      // that was left behind by it, or retired since, can be ejected yet
+      auto min_epoch = qsbr_tracker::instance().get_min_quiescent_epoch();
+      if (!adopted && min_epoch == scanned_epoch[id] && min_epoch != qsbr_tracker::no_epoch) break;
+      scanned_epoch[id] = min_epoch;
+      if (reclaimer != nullptr && reclaimer->submit(deferred_destructs[id])) break; // handed off to the background threads
+      in_progress[id] = true;
+      auto deferred = std::vector<RetiredObj>(std::move(deferred_destructs[id]));
+      eject_unprotected(deferred);
+      deferred_destructs[id].insert(deferred_destructs[id].end(), deferred.begin(), deferred.end());
+      in_progress[id] = false;
+    }
+  }
+
+  using retired_batch = std::vector<RetiredObj>;
+  using reclaimer_t = background_reclaimer<acquire_retire_qsbr, retired_batch>;
+  friend reclaimer_t;
+  friend utils::thread_exit_hook<acquire_retire_qsbr>;
+
+  // Perform the deferred ejects in the batch on a background thread
+  void reclaim_in_background(retired_batch& batch) {
+    auto id = utils::threadID.getTID();
+    in_progress[id] = true;
+    eject_unprotected(batch);
+    // Ejects may cause further ejects to be deferred by this thread, which are kept for the next pass
+    batch.insert(batch.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    in_progress[id] = false;
+  }
+
+  // Called by each thread as it exits. Performs the deferred ejects of the thread
+  // that are safe, and leaves the rest on the orphan list for other threads to adopt
+  bool on_thread_exit(size_t id) {
+    bool found_work = this->flush_destructions();
+    if (in_progress[id] || deferred_destructs[id].empty()) return found_work;
+    in_progress[id] = true;
+    auto deferred = retired_batch(std::move(deferred_destructs[id]));
+    deferred_destructs[id].clear();
+    eject_unprotected(deferred);
+    deferred.insert(deferred.end(), deferred_destructs[id].begin(), deferred_destructs[id].end());
+    deferred_destructs[id].clear();
+    eject_work[id] = 0;
+    in_progress[id] = false;
+    orphans.push(std::move(deferred));
+    return true;
+  }
+
+  // Perform every deferred eject in the given list that every online thread has
+  // passed a quiescent state since, and remove it from the list
+  void eject_unprotected(retired_batch& deferred) {
+    auto min_epoch = qsbr_tracker::instance().get_min_quiescent_epoch();
+
+    // Collect the deferred decrements that are safe to apply, so that repeated
+    // decrements of the same object can be applied together
+    std::vector<std::pair<counted_ptr_t, RetireType>> ejects;
+    auto f = [&ejects, min_epoch](const auto& x) {
+      if (x.retireTS < min_epoch) {
+        ejects.emplace_back(x.obj, x.type);
+        return true;
+      }
+      return false;
+    };
+
+    // Remove the deferred decrements that are successfully applied
+    deferred.erase(remove_if(deferred.begin(), deferred.end(), f), deferred.end());
+    this->eject_coalesced(ejects);
+  }
+
+  utils::per_thread<AlignedBool> in_progress;                         // Local flags to prevent reentrancy while destructing
+  utils::per_thread<AlignedVector<RetiredObj>> deferred_destructs;    // Thread-local lists of pending deferred destructs
+  utils::per_thread<AlignedInt> eject_work;                           // Amortized work to pay for ejecting deferred destructs
+  utils::per_thread<AlignedInt> epoch_work;                           // Amortized work to pay for incrementing the epoch
+  utils::per_thread<AlignedLong> scanned_epoch;                       // The earliest quiescent epoch at the last attempt to eject
+  std::unique_ptr<reclaimer_t> reclaimer;                       // Background threads that perform deferred ejects, if enabled
+  orphan_list<RetiredObj> orphans;                              // Deferred ejects left behind by threads that have exited
+  utils::thread_exit_hook<acquire_retire_qsbr> exit_hook{*this};
+};
+
+
+}  // namespace internal
+
+}  // namespace cdrc
+
+#endif // CDRC_SMR_ACQUIRE_RETIRE_QSBR_H
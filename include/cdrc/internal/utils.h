@@ -4,8 +4,11 @@
 #include <cstdint>
 #include <cstdlib>
 
+#include <array>
 #include <atomic>
+#include <bit>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <thread>
@@ -71,6 +74,9 @@ struct alignas(128) AlignedBool {
 
 namespace utils {
 
+// The number of threads that the program expects to run at once. This is not a
+// limit, but per-thread data is laid out so that it is cheapest to access when
+// there are at most this many threads at a time
 size_t num_threads() {
   static size_t n_threads = []() -> size_t {
     if (const auto env_p = std::getenv("NUM_THREADS")) {
@@ -113,6 +119,14 @@ struct alignas(128) Padded<T, typename std::enable_if<std::is_class<T>::value>::
 // Note: The counter steals the top two bits of the integer for book-
 // keeping purposes. Hence the maximum representable value in the
 // counter is 2^(8*sizeof(T)-2) - 1
+//
+// Counters narrower than 32 bits could realistically overflow, so they
+// saturate instead. Once such a counter exceeds half of its maximum value,
+// it is pinned to three quarters of its maximum value, and stays there
+// regardless of subsequent increments and decrements, so it never reaches
+// zero. That is, an object whose count saturates is never freed. This is
+// safe as long as fewer than a quarter of the maximum value worth of
+// increments or decrements are ever concurrently in flight.
 template<typename T>
 class StickyCounter {
   static_assert(std::is_integral_v<T> && std::is_unsigned_v<T>);
@@ -121,8 +135,13 @@ public:
 
   [[nodiscard]] bool is_lock_free() const { return true; }
   static constexpr bool is_always_lock_free = true;
+  static constexpr bool is_saturating = sizeof(T) < sizeof(uint32_t);
   [[nodiscard]] constexpr T max_value() const { return zero_pending_flag - 1; }
 
+  // The largest amount that a single increment or decrement may change the
+  // counter by. A saturated counter only tolerates a quarter of its range
+  static constexpr T max_delta = is_saturating ? (T(1) << (sizeof(T)*8 - 2)) / 4 : std::numeric_limits<T>::max();
+
   StickyCounter() noexcept : x(1) {}
   explicit StickyCounter(T desired) noexcept : x(desired == 0 ? zero_flag : desired) {}
 
@@ -133,6 +152,9 @@ public:
   bool increment(T arg, std::memory_order order = std::memory_order_seq_cst) noexcept {
     //if (x.load() & zero_flag) return false;
     auto val = x.fetch_add(arg, order);
+    if constexpr (is_saturating) {
+      if ((val & zero_flag) == 0 && val + arg > saturation_threshold) [[unlikely]] x.store(saturated_value, std::memory_order_relaxed);
+    }
     return (val & zero_flag) == 0;
   }
 
@@ -143,11 +165,15 @@ public:
   // Returns true if the counter was decremented to zero. Returns
   // false if the counter was not decremented to zero
   bool decrement(T arg, std::memory_order order = std::memory_order_seq_cst) noexcept {
-    if (x.fetch_sub(arg, order) == arg) {
+    auto val = x.fetch_sub(arg, order);
+    if (val == arg) {
       T expected = 0;
       if (x.compare_exchange_strong(expected, zero_flag)) [[likely]] return true;
       else if ((expected & zero_pending_flag) && (x.exchange(zero_flag) & zero_pending_flag)) return true;
     }
+    if constexpr (is_saturating) {
+      if (val > saturation_threshold) [[unlikely]] x.store(saturated_value, std::memory_order_relaxed);
+    }
     return false;
   }
 
@@ -170,38 +196,224 @@ public:
 private:
   static constexpr inline T zero_flag = (T(1) << (sizeof(T)*8 - 1));
   static constexpr inline T zero_pending_flag = (T(1) << (sizeof(T)*8 - 2));
+  static constexpr inline T saturation_threshold = zero_pending_flag / 2;
+  static constexpr inline T saturated_value = zero_pending_flag / 4 * 3;
 
   mutable std::atomic<T> x;
 };
 
 
-struct ThreadID {
-  static std::vector<std::atomic<bool>> in_use; // initialize to false
-  int tid;
+inline std::size_t num_thread_ids();
+
+// A growable array with one element per thread ID, which is indexed by the ID.
+//
+// The array consists of segments whose sizes double, each of which is allocated
+// on first use and then never moves, so elements can be accessed concurrently
+// with the growth of the array, and scans of every thread's element can run
+// concurrently with the arrival of new threads. The first segment holds the
+// elements of the first num_threads() threads, so programs that never have more
+// threads than that at a time only ever touch a single segment.
+//
+// Elements are value initialized when their segment is allocated.
+template<typename T>
+class per_thread {
+ public:
+  per_thread() : first_segment_bits(std::bit_width(num_threads() - 1)),
+                 first_segment(new T[first_segment_size()]()) {
+    segments[0].store(first_segment, std::memory_order_relaxed);
+  }
+
+  per_thread(const per_thread&) = delete;
+  per_thread& operator=(const per_thread&) = delete;
+
+  ~per_thread() {
+    for (auto& segment : segments) delete[] segment.load(std::memory_order_relaxed);
+  }
+
+  T& operator[](std::size_t i) {
+    if (i < first_segment_size()) [[likely]] return first_segment[i];
+    auto k = static_cast<std::size_t>(std::bit_width(i >> first_segment_bits));
+    return get_segment(k)[i - (first_segment_size() << (k - 1))];
+  }
+
+  const T& operator[](std::size_t i) const {
+    return const_cast<per_thread&>(*this)[i];
+  }
+
+  // Whether the element of the given thread ID has already been allocated, in
+  // which case accessing it is guaranteed not to allocate memory
+  bool is_allocated(std::size_t i) const {
+    if (i < first_segment_size()) [[likely]] return true;
+    auto k = static_cast<std::size_t>(std::bit_width(i >> first_segment_bits));
+    return segments[k].load(std::memory_order_acquire) != nullptr;
+  }
+
+  // Apply f to the element of every thread ID that has ever been handed out
+  template<typename F>
+  void for_each(F&& f) {
+    for (std::size_t i = 0, n = num_thread_ids(); i < n; i++) f((*this)[i]);
+  }
+
+  template<typename F>
+  void for_each(F&& f) const {
+    for (std::size_t i = 0, n = num_thread_ids(); i < n; i++) f((*this)[i]);
+  }
+
+  // Whether p holds for the element of any thread ID that has ever been handed out
+  template<typename P>
+  bool any_of(P&& p) {
+    for (std::size_t i = 0, n = num_thread_ids(); i < n; i++) {
+      if (p((*this)[i])) return true;
+    }
+    return false;
+  }
+
+ private:
+  std::size_t first_segment_size() const { return std::size_t(1) << first_segment_bits; }
+
+  // Segment k > 0 holds the elements at indices [first_segment_size() << (k-1), first_segment_size() << k)
+  T* get_segment(std::size_t k) {
+    auto segment = segments[k].load(std::memory_order_acquire);
+    if (segment == nullptr) {
+      auto allocated = new T[first_segment_size() << (k - 1)]();
+      if (segments[k].compare_exchange_strong(segment, allocated, std::memory_order_acq_rel)) segment = allocated;
+      else delete[] allocated;
+    }
+    return segment;
+  }
+
+  const int first_segment_bits;
+  T* const first_segment;
+  std::array<std::atomic<T*>, 64> segments{};
+};
 
-  ThreadID() {
-    for(size_t i = 0; i < num_threads(); i++) {
-      bool expected = false;
-      if(!in_use[i] && in_use[i].compare_exchange_strong(expected, true)) {
-        tid = i;
-        return;
+// Hands out thread IDs. The IDs of threads that have exited are kept on a
+// lock-free stack and are handed out again before any new ID, so both
+// registering and unregistering a thread take O(1) time, and the IDs stay
+// as small as the largest number of threads that have ever run at once.
+// There is no limit on the number of threads.
+class thread_registry {
+ public:
+  std::size_t acquire() {
+    auto head = free_head.load(std::memory_order_acquire);
+    while (index_of(head) != empty) {
+      auto next = links[index_of(head)].load(std::memory_order_relaxed);
+      if (free_head.compare_exchange_weak(head, make_head(next, tag_of(head) + 1), std::memory_order_acq_rel)) {
+        return index_of(head);
       }
     }
-    std::cerr << "Error: more than " << num_threads() << " threads created" << std::endl;
-    std::exit(1);
+    return next_id.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  void release(std::size_t id) {
+    auto head = free_head.load(std::memory_order_relaxed);
+    do {
+      links[id].store(index_of(head), std::memory_order_relaxed);
+    } while (!free_head.compare_exchange_weak(head, make_head(id, tag_of(head) + 1), std::memory_order_acq_rel));
+  }
+
+  // One more than the largest ID that has ever been handed out
+  std::size_t bound() const { return next_id.load(std::memory_order_seq_cst); }
+
+  // A callback that is run by every thread as it exits, while it still holds its ID.
+  // It returns whether it found anything to do for the thread.
+  struct exit_hook {
+    bool (*run)(void* owner, std::size_t id);
+    void* owner;
+    std::atomic<bool> active{true};
+    exit_hook* next{nullptr};
+  };
+
+  exit_hook* add_exit_hook(bool (*run)(void*, std::size_t), void* owner) {
+    auto hook = new exit_hook{run, owner};
+    auto head = exit_hooks.load(std::memory_order_relaxed);
+    do {
+      hook->next = head;
+    } while (!exit_hooks.compare_exchange_weak(head, hook, std::memory_order_acq_rel));
+    return hook;
+  }
+
+  // Removed hooks are only deactivated, never freed, since exiting threads may be traversing them
+  void remove_exit_hook(exit_hook* hook) {
+    hook->active.store(false, std::memory_order_release);
+  }
+
+  // Run every active exit hook for the given thread ID. The work done by one hook can
+  // create work for another, e.g., destroying an object retires the objects it points
+  // to, which may be managed by another memory manager, so the hooks are run repeatedly
+  // until none of them finds anything to do.
+  void run_exit_hooks(std::size_t id) {
+    bool found_work;
+    do {
+      found_work = false;
+      for (auto hook = exit_hooks.load(std::memory_order_acquire); hook != nullptr; hook = hook->next) {
+        if (hook->active.load(std::memory_order_acquire) && hook->run(hook->owner, id)) found_work = true;
+      }
+    } while (found_work);
   }
 
+ private:
+  // The head of the stack of free IDs holds the index of the top ID in its low
+  // half, and a tag that is incremented by every update, to avoid ABA, in its high half
+  constexpr static uint32_t empty = std::numeric_limits<uint32_t>::max();
+  static uint32_t index_of(uint64_t head) { return static_cast<uint32_t>(head); }
+  static uint32_t tag_of(uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+  static uint64_t make_head(uint64_t index, uint32_t tag) { return (static_cast<uint64_t>(tag) << 32) | index; }
+
+  std::atomic<uint64_t> free_head{empty};
+  std::atomic<std::size_t> next_id{0};
+  per_thread<std::atomic<uint32_t>> links;         // The ID below each free ID on the stack
+  std::atomic<exit_hook*> exit_hooks{nullptr};
+};
+
+// The registry is never destroyed, since threads may exit after static destruction
+inline thread_registry& get_thread_registry() {
+  static thread_registry* registry = new thread_registry;
+  return *registry;
+}
+
+// An upper bound on the IDs of all current threads. Scans of per-thread data
+// only need to visit the IDs below it, i.e., those that have ever been used
+inline std::size_t num_thread_ids() {
+  return get_thread_registry().bound();
+}
+
+struct ThreadID {
+  int tid;
+
+  ThreadID() : tid(static_cast<int>(get_thread_registry().acquire())) { }
+
   ~ThreadID() {
-    in_use[tid] = false;
+    get_thread_registry().run_exit_hooks(tid);
+    get_thread_registry().release(tid);
   }
 
   int getTID() const { return tid; }
 };
 
-std::vector<std::atomic<bool>> ThreadID::in_use(num_threads());
-
 thread_local ThreadID threadID;
 
+// Calls owner.on_thread_exit(id) in every thread that exits while the hook is alive,
+// before the thread's ID is handed out again, so that the owner can deal with any
+// work that the thread left behind. on_thread_exit returns whether there was any.
+// The owner must outlive the hook, and it must not be destroyed while threads are
+// exiting.
+template<typename Owner>
+class thread_exit_hook {
+ public:
+  explicit thread_exit_hook(Owner& owner) : hook(get_thread_registry().add_exit_hook(&run, &owner)) {}
+
+  thread_exit_hook(const thread_exit_hook&) = delete;
+  thread_exit_hook& operator=(const thread_exit_hook&) = delete;
+
+  ~thread_exit_hook() { get_thread_registry().remove_exit_hook(hook); }
+
+ private:
+  static bool run(void* owner, std::size_t id) { return static_cast<Owner*>(owner)->on_thread_exit(id); }
+
+  thread_registry::exit_hook* hook;
+};
+
 // a slightly cheaper, but possibly not as good version
 // based on splitmix64
 inline uint64_t hash64_2(uint64_t x) {
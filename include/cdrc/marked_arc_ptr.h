@@ -125,6 +125,27 @@ template<typename T>
 using marked_ws_ptr_hp = marked_ws_ptr<T, internal::acquire_retire<T>>;
 
 
+// Alias templates for marked pointers with hazard pointers with asymmetric fences
+
+template<typename T>
+using marked_arc_ptr_hp_asym = marked_arc_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using marked_rc_ptr_hp_asym = marked_rc_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using marked_snapshot_ptr_hp_asym = marked_snapshot_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using marked_aw_ptr_hp_asym = marked_aw_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using marked_weak_ptr_hp_asym = marked_weak_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+template<typename T>
+using marked_ws_ptr_hp_asym = marked_ws_ptr<T, internal::acquire_retire<T, 7, 2, internal::default_object_policy, internal::asymmetric_fence_policy>>;
+
+
 // Alias templates for marked pointers with EBR
 
 template<typename T>
@@ -167,6 +188,69 @@ template<typename T>
 using marked_ws_ptr_ibr = marked_ws_ptr<T, internal::acquire_retire_ibr<T>>;
 
 
+// Alias templates for marked pointers with tagged IBR
+
+template<typename T>
+using marked_arc_ptr_ibr_tagged = marked_arc_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using marked_rc_ptr_ibr_tagged = marked_rc_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using marked_snapshot_ptr_ibr_tagged = marked_snapshot_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using marked_aw_ptr_ibr_tagged = marked_aw_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using marked_weak_ptr_ibr_tagged = marked_weak_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+template<typename T>
+using marked_ws_ptr_ibr_tagged = marked_ws_ptr<T, internal::acquire_retire_ibr<T, 40, 2, internal::default_object_policy, internal::ibr_tagged_policy>>;
+
+
+// Alias templates for marked pointers with hazard eras
+
+template<typename T>
+using marked_arc_ptr_he = marked_arc_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_rc_ptr_he = marked_rc_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_he = marked_snapshot_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_aw_ptr_he = marked_aw_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_weak_ptr_he = marked_weak_ptr<T, internal::acquire_retire_he<T>>;
+
+template<typename T>
+using marked_ws_ptr_he = marked_ws_ptr<T, internal::acquire_retire_he<T>>;
+
+
+// Alias templates for marked pointers with neutralization-based reclamation
+
+template<typename T>
+using marked_arc_ptr_nbr = marked_arc_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using marked_rc_ptr_nbr = marked_rc_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_nbr = marked_snapshot_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using marked_aw_ptr_nbr = marked_aw_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using marked_weak_ptr_nbr = marked_weak_ptr<T, internal::acquire_retire_nbr<T>>;
+
+template<typename T>
+using marked_ws_ptr_nbr = marked_ws_ptr<T, internal::acquire_retire_nbr<T>>;
+
+
 // Alias templates for marked pointers with Hyaline
 
 template<typename T>
@@ -188,6 +272,69 @@ template<typename T>
 using marked_ws_ptr_hyaline = marked_ws_ptr<T, internal::acquire_retire_hyaline<T>>;
 
 
+// Alias templates for marked pointers with Hyaline-S
+
+template<typename T>
+using marked_arc_ptr_hyaline_s = marked_arc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_rc_ptr_hyaline_s = marked_rc_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_hyaline_s = marked_snapshot_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_aw_ptr_hyaline_s = marked_aw_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_weak_ptr_hyaline_s = marked_weak_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+template<typename T>
+using marked_ws_ptr_hyaline_s = marked_ws_ptr<T, internal::acquire_retire_hyaline_s<T>>;
+
+
+// Alias templates for marked pointers with Crystalline
+
+template<typename T>
+using marked_arc_ptr_crystalline = marked_arc_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using marked_rc_ptr_crystalline = marked_rc_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_crystalline = marked_snapshot_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using marked_aw_ptr_crystalline = marked_aw_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using marked_weak_ptr_crystalline = marked_weak_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+template<typename T>
+using marked_ws_ptr_crystalline = marked_ws_ptr<T, internal::acquire_retire_crystalline<T>>;
+
+
+// Alias templates for marked pointers with quiescent-state-based reclamation
+
+template<typename T>
+using marked_arc_ptr_qsbr = marked_arc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_rc_ptr_qsbr = marked_rc_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_snapshot_ptr_qsbr = marked_snapshot_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_aw_ptr_qsbr = marked_aw_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_weak_ptr_qsbr = marked_weak_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+template<typename T>
+using marked_ws_ptr_qsbr = marked_ws_ptr<T, internal::acquire_retire_qsbr<T>>;
+
+
 namespace internal {
 
 // Policy class for marked pointers.
@@ -218,6 +365,7 @@ class marked_ptr_policy {
    public:
     void set_mark(uintptr_t mark) {
       auto &parent = get_parent();
+      parent.mm.before_update();
       auto cur_ptr = parent.atomic_ptr.load();
       auto new_ptr = cur_ptr;
       new_ptr.set_mark(mark);
@@ -232,6 +380,7 @@ class marked_ptr_policy {
     void set_mark_bit(int bit) {
       assert(bit == 1 || bit == 2);
       auto &parent = get_parent();
+      parent.mm.before_update();
       auto cur_ptr = parent.atomic_ptr.load();
       auto new_ptr = cur_ptr;
       new_ptr.set_mark_bit(bit);
@@ -243,6 +392,7 @@ class marked_ptr_policy {
 
     bool compare_and_set_mark(const auto& expected, int desired_mark) {
       auto &parent = get_parent();
+      parent.mm.before_update();
       auto expected_ptr = expected.get_counted();
       auto desired_ptr = expected.get_counted();
       desired_ptr.set_mark(desired_mark);
@@ -4,6 +4,7 @@
 
 #include <cstddef>
 
+#include <memory_resource>
 #include <type_traits>
 #include <utility>
 
@@ -14,10 +15,16 @@
 
 namespace cdrc {
 
+// An rc_ptr<T, memory_manager> normally manages an object of type T. If the memory manager
+// manages objects of some other type U, the rc_ptr is instead an aliasing pointer, which
+// points at a T, usually a member of a U, while sharing ownership of the U that contains it
+// (see the aliasing constructor). Aliasing pointers can not be stored in an atomic_rc_ptr.
 template<typename T, typename memory_manager, typename pointer_policy>
 class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
 
-  using counted_object_t = internal::counted_object<T>;
+  constexpr static bool is_alias = !std::is_same_v<T, typename memory_manager::managed_type>;
+
+  using counted_object_t = internal::counted_object<typename memory_manager::managed_type, typename memory_manager::object_policy>;
   using counted_ptr_t = typename pointer_policy::template pointer_type<counted_object_t>;
 
   using atomic_ptr_t = atomic_rc_ptr<T, memory_manager, pointer_policy>;
@@ -35,26 +42,53 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
   friend typename pointer_policy::template arc_ptr_policy<T>;
   friend typename pointer_policy::template rc_ptr_policy<T>;
 
+  template<typename, typename, typename>
+  friend class rc_ptr;
+
  public:
+  using element_type = std::remove_extent_t<T>;
+
   rc_ptr() noexcept: ptr(nullptr) {}
 
   /* implicit */ rc_ptr(std::nullptr_t) noexcept: ptr(nullptr) {}
 
-  /* implicit */ rc_ptr(const snapshot_ptr_t &other) noexcept: ptr(other.get_counted()) {
+  /* implicit */ rc_ptr(const snapshot_ptr_t &other) noexcept: ptr(other.get_counted()), alias(other.alias) {
     if (ptr) mm.increment_ref_cnt(ptr);
   }
 
   /* implicit */ rc_ptr(const weak_ptr_t& other) noexcept : rc_ptr(other.lock()) { }
 
-  rc_ptr(const rc_ptr &other) noexcept: ptr(other.ptr) { if (ptr) mm.increment_ref_cnt(ptr); }
+  rc_ptr(const rc_ptr &other) noexcept: ptr(other.ptr), alias(other.alias) { if (ptr) mm.increment_ref_cnt(ptr); }
+
+  rc_ptr(rc_ptr &&other) noexcept: ptr(other.ptr), alias(other.alias) {
+    other.ptr = nullptr;
+    other.alias = {};
+  }
+
+  // Aliasing constructor. Creates an rc_ptr that points at p, but shares ownership
+  // of the object managed by owner, which is typically an object containing p. This
+  // allows a member of an object to be handed out without copying it into an object
+  // of its own. The type of the aliasing pointer names the memory manager of the owner,
+  // e.g., rc_ptr<Value, hp_backend<Node>> can point at the Value inside of a Node.
+  template<typename U> requires is_alias
+  rc_ptr(const rc_ptr<U, memory_manager, pointer_policy>& owner, element_type* p) noexcept
+      : ptr(owner.ptr), alias(p) {
+    if (ptr) mm.increment_ref_cnt(ptr);
+  }
 
-  rc_ptr(rc_ptr &&other) noexcept: ptr(other.release()) {}
+  template<typename U> requires is_alias
+  rc_ptr(rc_ptr<U, memory_manager, pointer_policy>&& owner, element_type* p) noexcept
+      : ptr(owner.ptr), alias(p) {
+    owner.ptr = nullptr;
+    owner.alias = {};
+  }
 
   ~rc_ptr() { clear(); }
 
   void clear() {
     if (ptr) { mm.decrement_ref_cnt(ptr); }
     ptr = nullptr;
+    alias = {};
   }
 
   // Assign the managed pointer to nullptr, releasing the current reference
@@ -67,6 +101,7 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
   rc_ptr &operator=(const rc_ptr &other) {
     auto tmp = ptr;
     ptr = other.ptr;
+    alias = other.alias;
     if (ptr) mm.increment_ref_cnt(ptr);
     if (tmp) mm.decrement_ref_cnt(tmp);
     return *this;
@@ -75,24 +110,40 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
   // move assignment
   rc_ptr &operator=(rc_ptr &&other) {
     auto tmp = ptr;
-    ptr = other.release();
+    ptr = other.ptr;
+    alias = other.alias;
+    other.ptr = nullptr;
+    other.alias = {};
     if (tmp) mm.decrement_ref_cnt(tmp);
     return *this;
   }
 
-  typename std::add_lvalue_reference_t<T> operator*() { return *(ptr->get()); }
+  typename std::add_lvalue_reference_t<T> operator*() { return *get_unchecked(); }
 
-  const typename std::add_lvalue_reference_t<T> operator*() const { return *(ptr->get()); }
+  const typename std::add_lvalue_reference_t<T> operator*() const { return *get_unchecked(); }
 
-  T *get() { return (ptr == nullptr) ? nullptr : ptr->get(); }
+  element_type *get() {
+    if constexpr (is_alias) return alias;
+    else return (ptr == nullptr) ? nullptr : ptr->get();
+  }
+
+  const element_type *get() const {
+    if constexpr (is_alias) return alias;
+    else return (ptr == nullptr) ? nullptr : ptr->get();
+  }
+
+  element_type *operator->() { return get(); }
+
+  const element_type *operator->() const { return get(); }
 
-  const T *get() const { return (ptr == nullptr) ? nullptr : ptr->get(); }
+  element_type &operator[](std::size_t i) requires std::is_unbounded_array_v<T> { return get_unchecked()[i]; }
 
-  T *operator->() { return (ptr == nullptr) ? nullptr : ptr->get(); }
+  const element_type &operator[](std::size_t i) const requires std::is_unbounded_array_v<T> { return get_unchecked()[i]; }
 
-  const T *operator->() const { return (ptr == nullptr) ? nullptr : ptr->get(); }
+  // The number of elements of the managed array
+  std::size_t size() const noexcept requires std::is_unbounded_array_v<T> { return (ptr == nullptr) ? 0 : ptr->size(); }
 
-  explicit operator bool() const { return ptr != nullptr; }
+  explicit operator bool() const { return get() != nullptr; }
 
   bool operator==(const rc_ptr &other) const { return get() == other.get(); }
 
@@ -100,19 +151,46 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
 
   size_t use_count() const noexcept { return (ptr == nullptr) ? 0 : ptr->get_use_count(); }
 
-  size_t weak_count() const noexcept { return (ptr == nullptr) ? 0 : ptr->get_weak_count() - 1; }
+  size_t weak_count() const noexcept {
+    if constexpr (!memory_manager::object_policy::weak_references) return 0;
+    else return (ptr == nullptr) ? 0 : ptr->get_weak_count() - 1;
+  }
 
   void swap(rc_ptr &other) {
     std::swap(ptr, other.ptr);
+    std::swap(alias, other.alias);
   }
 
   // Create a new rc_ptr containing an object of type T constructed from (args...).
   template<typename... Args>
+  requires (!std::is_unbounded_array_v<T> && !is_alias)
   static rc_ptr make_shared(Args &&... args) {
     auto ptr = mm.create_object(std::forward<Args>(args)...);
     return rc_ptr(ptr, AddRef::no);
   }
 
+  // Create a new rc_ptr containing an array of n value-initialized elements, which
+  // are stored inline in the same allocation as the reference counts
+  static rc_ptr make_shared(std::size_t n) requires std::is_unbounded_array_v<T> {
+    auto ptr = mm.create_object(internal::array_extent{n});
+    return rc_ptr(ptr, AddRef::no);
+  }
+
+  // Create a new rc_ptr containing an array of n copies of the given value
+  static rc_ptr make_shared(std::size_t n, const element_type& value) requires std::is_unbounded_array_v<T> {
+    auto ptr = mm.create_object(internal::array_extent{n}, value);
+    return rc_ptr(ptr, AddRef::no);
+  }
+
+  // Create a new rc_ptr containing an object of type T constructed from (args...), whose
+  // storage is obtained from the given allocator. The memory manager must use an
+  // allocator-aware object policy.
+  template<typename Alloc, typename... Args>
+  static rc_ptr allocate_shared(const Alloc& alloc, Args &&... args) {
+    auto ptr = mm.create_object_with_allocator(alloc, std::forward<Args>(args)...);
+    return rc_ptr(ptr, AddRef::no);
+  }
+
  protected:
 
   enum class AddRef {
@@ -120,6 +198,7 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
   };
 
   explicit rc_ptr(counted_ptr_t ptr_, AddRef add_ref) : ptr(ptr_) {
+    static_assert(!is_alias);
     if (ptr && add_ref == AddRef::yes) mm.increment_ref_cnt(ptr);
   }
 
@@ -128,6 +207,7 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
   }
 
   counted_ptr_t release() {
+    static_assert(!is_alias);
     auto p = ptr;
     ptr = nullptr;
     return p;
@@ -137,9 +217,23 @@ class rc_ptr : public pointer_policy::template rc_ptr_policy<T> {
     return ptr;
   }
 
+  // The pointed-to object, assuming that the pointer is not null
+  element_type* get_unchecked() {
+    if constexpr (is_alias) return alias;
+    else return ptr->get();
+  }
+
+  const element_type* get_unchecked() const {
+    if constexpr (is_alias) return alias;
+    else return ptr->get();
+  }
+
   static inline memory_manager& mm = memory_manager::instance();
 
   counted_ptr_t ptr;
+
+  // The object pointed at by an aliasing pointer
+  [[no_unique_address]] std::conditional_t<is_alias, element_type*, internal::empty_field> alias{};
 };
 
 // Create a new rc_ptr containing an object of type T constructed from (args...).
@@ -156,6 +250,23 @@ static rc_ptr<T, memory_manager, pointer_policy> make_rc(Args &&... args) {
   return rc_ptr<T, memory_manager, pointer_policy>::make_shared(std::forward<Args>(args)...);
 }
 
+// Create a new rc_ptr containing an object of type T constructed from (args...), whose storage
+// is obtained from the given allocator. The allocator is retained until the object is destroyed.
+template<typename T, typename memory_manager = internal::default_memory_manager<T>,
+  typename pointer_policy = internal::default_pointer_policy, typename Alloc, typename... Args>
+requires (!std::is_convertible_v<Alloc, std::pmr::memory_resource*>)
+static rc_ptr<T, memory_manager, pointer_policy> allocate_rc(const Alloc& alloc, Args &&... args) {
+  return rc_ptr<T, memory_manager, pointer_policy>::allocate_shared(alloc, std::forward<Args>(args)...);
+}
+
+// Create a new rc_ptr containing an object of type T constructed from (args...), whose storage
+// is obtained from the given memory resource, which must outlive the object.
+template<typename T, typename memory_manager = internal::default_memory_manager<T>,
+  typename pointer_policy = internal::default_pointer_policy, typename... Args>
+static rc_ptr<T, memory_manager, pointer_policy> allocate_rc(std::pmr::memory_resource* resource, Args &&... args) {
+  return rc_ptr<T, memory_manager, pointer_policy>::allocate_shared(std::pmr::polymorphic_allocator<std::byte>(resource), std::forward<Args>(args)...);
+}
+
 }  // namespace cdrc
 
 #endif  // CDRC_RC_PTR_H_
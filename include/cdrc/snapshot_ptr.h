@@ -5,16 +5,21 @@
 #include <cstddef>
 
 #include <type_traits>
+#include <utility>
 
 #include "internal/counted_object.h"
 #include "internal/fwd_decl.h"
 
 namespace cdrc {
 
+// Like rc_ptr, a snapshot_ptr whose memory manager manages objects of a type other than T
+// is an aliasing pointer, which points at a T while protecting the object that contains it
 template<typename T, typename memory_manager, typename pointer_policy>
 class snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
 
-  using counted_object_t = internal::counted_object<T>;
+  constexpr static bool is_alias = !std::is_same_v<T, typename memory_manager::managed_type>;
+
+  using counted_object_t = internal::counted_object<typename memory_manager::managed_type, typename memory_manager::object_policy>;
   using counted_ptr_t = typename pointer_policy::template pointer_type<counted_object_t>;
 
   using atomic_ptr_t = atomic_rc_ptr<T, memory_manager, pointer_policy>;
@@ -30,12 +35,28 @@ class snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
   friend typename pointer_policy::template arc_ptr_policy<T>;
   friend typename pointer_policy::template snapshot_ptr_policy<T>;
 
+  template<typename, typename, typename>
+  friend class snapshot_ptr;
+
  public:
+  using element_type = std::remove_extent_t<T>;
+
   snapshot_ptr() : acquired_ptr() {}
 
   /* implicit */ snapshot_ptr(std::nullptr_t) : acquired_ptr() {}
 
-  snapshot_ptr(snapshot_ptr &&other) noexcept: acquired_ptr(std::move(other.acquired_ptr)) {}
+  snapshot_ptr(snapshot_ptr &&other) noexcept: acquired_ptr(std::move(other.acquired_ptr)), alias(other.alias) {
+    other.alias = {};
+  }
+
+  // Aliasing constructor. Creates a snapshot_ptr that points at p, and takes over the
+  // protection of the object that is protected by owner, which is typically an object
+  // containing p. The owner's announcement is kept, rather than acquiring a new one.
+  template<typename U> requires is_alias
+  snapshot_ptr(snapshot_ptr<U, memory_manager, pointer_policy>&& owner, element_type* p) noexcept
+      : acquired_ptr(std::move(owner.acquired_ptr)), alias(p) {
+    owner.alias = {};
+  }
 
   snapshot_ptr(const snapshot_ptr&) = delete;
   snapshot_ptr &operator=(const snapshot_ptr&) = delete;
@@ -46,38 +67,52 @@ class snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
     return *this;
   }
 
-  typename std::add_lvalue_reference_t<T> operator*() { return *(acquired_ptr.get()->get()); }
+  typename std::add_lvalue_reference_t<T> operator*() { return *get_unchecked(); }
 
-  const typename std::add_lvalue_reference_t<T> operator*() const { return *(acquired_ptr.get()->get()); }
+  const typename std::add_lvalue_reference_t<T> operator*() const { return *get_unchecked(); }
 
-  T *get() { 
-    counted_ptr_t ptr = acquired_ptr.get();
-    return (ptr == nullptr) ? nullptr : ptr->get(); 
+  element_type *get() { 
+    if constexpr (is_alias) return alias;
+    else {
+      counted_ptr_t ptr = acquired_ptr.get();
+      return (ptr == nullptr) ? nullptr : ptr->get();
+    }
   }
 
-  const T *get() const { 
-    counted_ptr_t ptr = acquired_ptr.get();
-    return (ptr == nullptr) ? nullptr : ptr->get(); 
+  const element_type *get() const { 
+    if constexpr (is_alias) return alias;
+    else {
+      counted_ptr_t ptr = acquired_ptr.get();
+      return (ptr == nullptr) ? nullptr : ptr->get();
+    }
   }
 
-  T *operator->() { 
+  element_type *operator->() { return get(); }
+
+  const element_type *operator->() const { return get(); }
+
+  element_type &operator[](std::size_t i) requires std::is_unbounded_array_v<T> { return get_unchecked()[i]; }
+
+  const element_type &operator[](std::size_t i) const requires std::is_unbounded_array_v<T> { return get_unchecked()[i]; }
+
+  // The number of elements of the managed array
+  std::size_t size() const requires std::is_unbounded_array_v<T> {
     counted_ptr_t ptr = acquired_ptr.get();
-    return (ptr == nullptr) ? nullptr : ptr->get(); 
+    return (ptr == nullptr) ? 0 : ptr->size();
   }
 
-  const T *operator->() const { 
-    counted_ptr_t ptr = acquired_ptr.getValue();
-    return (ptr == nullptr) ? nullptr : ptr->get(); 
+  explicit operator bool() const {
+    if constexpr (is_alias) return alias != nullptr;
+    else return acquired_ptr.get() != nullptr;
   }
 
-  explicit operator bool() const { return acquired_ptr.get() != nullptr; }
-
   bool operator==(const snapshot_ptr<T> &other) const { return get() == other.get(); }
 
   bool operator!=(const snapshot_ptr<T> &other) const { return get() != other.get(); }
 
   void swap(snapshot_ptr &other) {
     acquired_ptr.swap(other.acquired_ptr);
+    std::swap(alias, other.alias);
   }
 
   ~snapshot_ptr() { clear(); }
@@ -88,12 +123,15 @@ class snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
       mm.decrement_ref_cnt(ptr);
     }
     acquired_ptr.clear();
+    alias = {};
   }
 
  protected:
 
   explicit snapshot_ptr(acquired_pointer_t&& acquired_ptr) :
-      acquired_ptr(std::move(acquired_ptr)) {}
+      acquired_ptr(std::move(acquired_ptr)) {
+    static_assert(!is_alias);
+  }
 
   counted_ptr_t get_counted() const {
     return acquired_ptr.get();
@@ -103,6 +141,17 @@ class snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
     return acquired_ptr.get();
   }
 
+  // The pointed-to object, assuming that the pointer is not null
+  element_type* get_unchecked() {
+    if constexpr (is_alias) return alias;
+    else return acquired_ptr.get()->get();
+  }
+
+  const element_type* get_unchecked() const {
+    if constexpr (is_alias) return alias;
+    else return acquired_ptr.get()->get();
+  }
+
   // For converting a snapshot_ptr into an rc_ptr
   // If the ref count has already been incremented,
   // the pointer can just be transferred, otherwise
@@ -123,6 +172,9 @@ class snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
   static inline memory_manager& mm = memory_manager::instance();
 
   acquired_pointer_t acquired_ptr;
+
+  // The object pointed at by an aliasing pointer
+  [[no_unique_address]] std::conditional_t<is_alias, element_type*, internal::empty_field> alias{};
 };
 
 }  // namespace cdrc
@@ -14,7 +14,7 @@ namespace cdrc {
 template<typename T, typename memory_manager, typename pointer_policy>
 class weak_ptr : public pointer_policy::template rc_ptr_policy<T> {
 
-  using counted_object_t = internal::counted_object<T>;
+  using counted_object_t = internal::counted_object<T, typename memory_manager::object_policy>;
   using counted_ptr_t = typename pointer_policy::template pointer_type<counted_object_t>;
 
   using atomic_ptr_t = atomic_rc_ptr<T, memory_manager, pointer_policy>;
@@ -45,7 +45,11 @@ class weak_ptr : public pointer_policy::template rc_ptr_policy<T> {
 
   weak_ptr(weak_ptr&& other) noexcept: ptr(other.release()) {}
 
-  ~weak_ptr() { clear(); }
+  ~weak_ptr() {
+    static_assert(memory_manager::object_policy::weak_references,
+      "Weak pointers require an object policy that permits weak references");
+    clear();
+  }
 
   void clear() {
     if (ptr) mm.decrement_weak_cnt(ptr);
@@ -74,7 +78,7 @@ class weak_ptr : public pointer_policy::template rc_ptr_policy<T> {
     else return nullptr;
   }
 
-  size_t use_count() const noexcept { return (ptr == nullptr) ? 0 : ptr->ref_cnt.load(); }
+  size_t use_count() const noexcept { return (ptr == nullptr) ? 0 : ptr->get_use_count(); }
 
   bool expired() const { return use_count() == 0; }
 
@@ -16,7 +16,7 @@ namespace cdrc {
 template<typename T, typename memory_manager, typename pointer_policy>
 class weak_snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T> {
 
-  using counted_object_t = internal::counted_object<T>;
+  using counted_object_t = internal::counted_object<T, typename memory_manager::object_policy>;
   using counted_ptr_t = typename pointer_policy::template pointer_type<counted_object_t>;
 
   using atomic_ptr_t = atomic_rc_ptr<T, memory_manager, pointer_policy>;
@@ -35,6 +35,8 @@ class weak_snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T>
   friend typename pointer_policy::template snapshot_ptr_policy<T>;
 
  public:
+  using element_type = std::remove_extent_t<T>;
+
   weak_snapshot_ptr() : acquired_ptr() {}
 
   /* implicit */ weak_snapshot_ptr(std::nullptr_t) : acquired_ptr() {}
@@ -60,22 +62,22 @@ class weak_snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T>
 
   const typename std::add_lvalue_reference_t<T> operator*() const { return *(acquired_ptr.get()->get()); }
 
-  T *get() { 
+  element_type *get() { 
     counted_ptr_t ptr = acquired_ptr.get();
     return (ptr == nullptr) ? nullptr : ptr->get(); 
   }
 
-  const T *get() const { 
+  const element_type *get() const { 
     counted_ptr_t ptr = acquired_ptr.get();
     return (ptr == nullptr) ? nullptr : ptr->get(); 
   }
 
-  T *operator->() { 
+  element_type *operator->() { 
     counted_ptr_t ptr = acquired_ptr.get();
     return (ptr == nullptr) ? nullptr : ptr->get(); 
   }
 
-  const T *operator->() const { 
+  const element_type *operator->() const { 
     counted_ptr_t ptr = acquired_ptr.getValue();
     return (ptr == nullptr) ? nullptr : ptr->get(); 
   }
@@ -90,7 +92,11 @@ class weak_snapshot_ptr : public pointer_policy::template snapshot_ptr_policy<T>
     acquired_ptr.swap(other.acquired_ptr);
   }
 
-  ~weak_snapshot_ptr() { clear(); }
+  ~weak_snapshot_ptr() {
+    static_assert(memory_manager::object_policy::weak_references,
+      "Weak pointers require an object policy that permits weak references");
+    clear();
+  }
 
   void clear() {
     counted_ptr_t ptr = acquired_ptr.get();
@@ -0,0 +1,136 @@
+#include <cassert>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/snapshot_ptr.h>
+
+std::atomic<int> num_live{0};
+
+struct Node {
+  int key;
+  std::string value;
+  Node(int key_, std::string value_) : key(key_), value(std::move(value_)) { num_live++; }
+  ~Node() { num_live--; }
+};
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using hyaline_backend = cdrc::hyaline_backend<T>;
+
+void test_rc_ptr_aliasing() {
+  using node_ptr = cdrc::rc_ptr<Node>;
+  using value_ptr = cdrc::rc_ptr<std::string, hp_backend<Node>>;
+  using char_ptr = cdrc::rc_ptr<char, hp_backend<Node>>;
+
+  static_assert(sizeof(node_ptr) == sizeof(void*));
+
+  {
+    node_ptr p = cdrc::make_rc<Node>(1, "one");
+    value_ptr v(p, &p->value);
+    assert(p.use_count() == 2);
+    assert(v.use_count() == 2);
+    assert(*v == "one");
+    assert(v->size() == 3);
+
+    // The aliasing pointer keeps the whole node alive
+    p = nullptr;
+    assert(num_live.load() == 1);
+    assert(*v == "one");
+
+    // Aliasing pointers can be re-aliased, copied, and moved
+    char_ptr c(v, &(*v)[1]);
+    assert(*c == 'n');
+    value_ptr w = v;
+    assert(w.get() == v.get());
+    assert(w.use_count() == 3);
+    value_ptr x = std::move(w);
+    assert(w == nullptr);
+    assert(x.get() == v.get());
+    char_ptr d(std::move(x), &(*v)[2]);
+    assert(x == nullptr);
+    assert(*d == 'e');
+    assert(v.use_count() == 3);
+
+    v = nullptr;
+    c = nullptr;
+    assert(num_live.load() == 1);
+  }
+  assert(num_live.load() == 0);
+
+  // An alias of a null owner is still non-null
+  static std::string standalone = "standalone";
+  value_ptr s(node_ptr(nullptr), &standalone);
+  assert(s);
+  assert(s.use_count() == 0);
+  assert(*s == "standalone");
+}
+
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_snapshot_aliasing() {
+  using rc_ptr = cdrc::rc_ptr<Node, memory_manager<Node>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<Node, memory_manager<Node>>;
+  using value_ptr = cdrc::rc_ptr<std::string, memory_manager<Node>>;
+  using value_snapshot_ptr = cdrc::snapshot_ptr<std::string, memory_manager<Node>>;
+
+  {
+    [[maybe_unused]] guard_t guard;
+    atomic_rc_ptr a(rc_ptr::make_shared(0, "0"));
+    auto s = a.get_snapshot();
+    auto value = &s->value;
+    value_snapshot_ptr sv(std::move(s), value);
+    assert(!s);
+    assert(sv.get() == value);
+
+    // The aliasing snapshot still protects the node after it is replaced
+    a.store(rc_ptr::make_shared(1, "1"));
+    assert(*sv == "0");
+    value_ptr v = sv;
+    sv = value_snapshot_ptr();
+    assert(*v == "0");
+    a.store(nullptr);
+  }
+
+  atomic_rc_ptr a(rc_ptr::make_shared(0, "0"));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 3; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 1; i <= 5000; i++) {
+        [[maybe_unused]] guard_t guard;
+        if (t == 0) {
+          a.store(rc_ptr::make_shared(i, std::to_string(i)));
+        } else {
+          auto s = a.get_snapshot();
+          [[maybe_unused]] auto key = s->key;
+          auto value = &s->value;
+          value_snapshot_ptr sv(std::move(s), value);
+          assert(*sv == std::to_string(key));
+          if (i % 2 == 0) {
+            value_ptr v = sv;
+            sv = value_snapshot_ptr();
+            assert(*v == std::to_string(key));
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  a.store(nullptr);
+}
+
+int main() {
+  test_rc_ptr_aliasing();
+  test_snapshot_aliasing<hp_backend>();
+  test_snapshot_aliasing<ebr_backend, cdrc::epoch_guard>();
+  test_snapshot_aliasing<hyaline_backend, cdrc::hyaline_guard>();
+}
@@ -0,0 +1,145 @@
+#include <cassert>
+#include <cstddef>
+
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+template<typename T>
+using aware_backend = cdrc::hp_backend<T, cdrc::allocator_aware_object_policy>;
+
+template<typename T>
+using aware_backend_ebr = cdrc::ebr_backend<T, cdrc::allocator_aware_object_policy>;
+
+template<typename T>
+using aware_backend_ibr = cdrc::ibr_backend<T, cdrc::allocator_aware_object_policy>;
+
+// A memory resource that remembers every block it has handed out, so
+// that it can check that blocks are always returned to their owner
+class tracking_resource : public std::pmr::memory_resource {
+ public:
+  std::size_t num_allocated() {
+    std::lock_guard<std::mutex> guard(lock);
+    return live.size();
+  }
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+    void* p = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    std::lock_guard<std::mutex> guard(lock);
+    live.insert(p);
+    return p;
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment) override {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      [[maybe_unused]] auto erased = live.erase(p);
+      assert(erased == 1);
+    }
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::mutex lock;
+  std::set<void*> live;
+};
+
+// A stateful allocator that counts its allocations
+template<typename T>
+struct counting_allocator {
+  using value_type = T;
+
+  explicit counting_allocator(std::atomic<int>& count_) : count(&count_) {}
+
+  template<typename U>
+  counting_allocator(const counting_allocator<U>& other) : count(other.count) {}
+
+  T* allocate(std::size_t n) {
+    count->fetch_add(1);
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T* p, std::size_t n) {
+    count->fetch_sub(1);
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  std::atomic<int>* count;
+};
+
+void test_custom_allocator() {
+  using rc_ptr = cdrc::rc_ptr<std::string, aware_backend<std::string>>;
+  std::atomic<int> count{0};
+  {
+    counting_allocator<std::string> alloc(count);
+    rc_ptr p = cdrc::allocate_rc<std::string, aware_backend<std::string>>(alloc, "allocated");
+    rc_ptr q = rc_ptr::make_shared("made");
+    assert(count.load() == 1);
+    assert(*p == "allocated");
+    assert(*q == "made");
+    rc_ptr r = p;
+    p = nullptr;
+    assert(count.load() == 1);
+  }
+  assert(count.load() == 0);
+}
+
+void test_monotonic_resource() {
+  using rc_ptr = cdrc::rc_ptr<int, aware_backend<int>>;
+  alignas(std::max_align_t) std::byte buffer[1024];
+  std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+  std::vector<rc_ptr> ptrs;
+  for (int i = 0; i < 10; i++) {
+    ptrs.push_back(cdrc::allocate_rc<int, aware_backend<int>>(&arena, i));
+    [[maybe_unused]] auto addr = reinterpret_cast<std::byte*>(ptrs.back().get());
+    assert(addr >= buffer && addr < buffer + sizeof(buffer));
+  }
+  for (int i = 0; i < 10; i++) assert(*ptrs[i] == i);
+  ptrs.clear();
+}
+
+// Objects released through deferred ejects must still be returned to the resource they came from
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_deferred_release() {
+  using rc_ptr = cdrc::rc_ptr<int, memory_manager<int>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<int, memory_manager<int>>;
+  tracking_resource resource;
+  {
+    [[maybe_unused]] guard_t guard;
+    atomic_rc_ptr slot;
+    for (int i = 0; i < 1000; i++) {
+      // Overwriting the slot while a snapshot is held defers the release of the old object
+      auto s = slot.get_snapshot();
+      if (i % 2 == 0) slot.store(cdrc::allocate_rc<int, memory_manager<int>>(&resource, i));
+      else slot.store(rc_ptr::make_shared(i));
+    }
+    slot.store(nullptr);
+  }
+  // Drain whatever is still deferred by creating and dropping more objects
+  for (int i = 0; i < 10000 && resource.num_allocated() > 0; i++) {
+    [[maybe_unused]] guard_t guard;
+    atomic_rc_ptr slot(rc_ptr::make_shared(i));
+    auto s = slot.get_snapshot();
+    slot.store(nullptr);
+  }
+  assert(resource.num_allocated() == 0);
+}
+
+int main() {
+  test_custom_allocator();
+  test_monotonic_resource();
+  test_deferred_release<aware_backend>();
+  test_deferred_release<aware_backend_ebr, cdrc::epoch_guard>();
+  test_deferred_release<aware_backend_ibr, cdrc::epoch_guard>();
+}
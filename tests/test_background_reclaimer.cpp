@@ -0,0 +1,93 @@
+#include <cassert>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+std::atomic<int> num_live{0};
+std::atomic<int> inline_destructs{0};
+std::atomic<int> background_destructs{0};
+thread_local bool is_application_thread = false;
+
+template<int delay_us>
+struct Tracked {
+  int x;
+  Tracked(int x_) : x(x_) { num_live++; }
+  ~Tracked() {
+    if constexpr (delay_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+    if (is_application_thread) inline_destructs++;
+    else background_destructs++;
+    num_live--;
+  }
+};
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using ibr_backend = cdrc::ibr_backend<T>;
+
+template<typename T, template<typename> typename memory_manager, typename guard_t>
+void run_workload(int num_ops) {
+  using rc_ptr = cdrc::rc_ptr<T, memory_manager<T>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<T, memory_manager<T>>;
+
+  std::vector<atomic_rc_ptr> slots(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&, t]() {
+      is_application_thread = true;
+      for (int i = 0; i < num_ops; i++) {
+        [[maybe_unused]] guard_t guard;
+        auto& slot = slots[(t + i) % slots.size()];
+        auto s = slot.get_snapshot();
+        if (s) assert(s->x >= 0);
+        slot.store(rc_ptr::make_shared(i));
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (auto& slot : slots) slot.store(nullptr);
+}
+
+// Deferred ejects are performed by the background threads
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_background() {
+  using T = Tracked<0>;
+  inline_destructs = 0;
+  background_destructs = 0;
+  auto& mm = memory_manager<T>::instance();
+  mm.start_background_reclamation(2);
+  run_workload<T, memory_manager, guard_t>(20000);
+  mm.stop_background_reclamation();
+  assert(background_destructs.load() > 0);
+}
+
+// When the background threads fall behind, application threads fall back to inline reclamation
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_fallback() {
+  using T = Tracked<20>;
+  inline_destructs = 0;
+  background_destructs = 0;
+  auto& mm = memory_manager<T>::instance();
+  mm.start_background_reclamation(1, 1);
+  run_workload<T, memory_manager, guard_t>(2000);
+  mm.stop_background_reclamation();
+  assert(background_destructs.load() > 0);
+  assert(inline_destructs.load() > 0);
+}
+
+int main() {
+  test_background<hp_backend>();
+  test_background<ebr_backend, cdrc::epoch_guard>();
+  test_background<ibr_backend, cdrc::epoch_guard>();
+  test_fallback<hp_backend>();
+  test_fallback<ebr_backend, cdrc::epoch_guard>();
+}
@@ -0,0 +1,147 @@
+#include <cassert>
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/atomic_weak_ptr.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/weak_ptr.h>
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using ibr_backend = cdrc::ibr_backend<T>;
+
+template<typename T>
+using he_backend = cdrc::he_backend<T>;
+
+template<typename T>
+using nbr_backend = cdrc::nbr_backend<T>;
+
+template<typename Tag>
+struct Tracked {
+  inline static std::atomic<int> num_live{0};
+  int x;
+  explicit Tracked(int x_) : x(x_) { num_live++; }
+  ~Tracked() { num_live--; }
+};
+
+// Storing the same object over and over defers a decrement of its reference
+// count each time, which should be applied together rather than one at a time
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_repeated_decrements() {
+  struct tag {};
+  using T = Tracked<tag>;
+  using rc_ptr = cdrc::rc_ptr<T, memory_manager<T>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<T, memory_manager<T>>;
+  auto& mm = memory_manager<T>::instance();
+  [[maybe_unused]] auto before = mm.coalesced_decrements();
+
+  {
+    auto p = rc_ptr::make_shared(1);
+    atomic_rc_ptr a(p);
+    for (int i = 0; i < 10000; i++) {
+      [[maybe_unused]] guard_t guard;
+      a.store(p);
+    }
+    {
+      // A snapshot must keep the object alive, even with its other references
+      // gone and many decrements of it pending
+      [[maybe_unused]] guard_t guard;
+      auto s = a.get_snapshot();
+      a.store(nullptr);
+      p = nullptr;
+      for (int i = 0; i < 1000; i++) {
+        [[maybe_unused]] guard_t guard2;
+        a.store(rc_ptr::make_shared(2));
+      }
+      assert(s->x == 1);
+    }
+    for (int i = 0; i < 10000 && T::num_live.load() > 1; i++) {
+      [[maybe_unused]] guard_t guard;
+      a.store(rc_ptr::make_shared(3));
+    }
+  }
+
+  assert(mm.coalesced_decrements() > before);
+}
+
+// The same for the decrements of weak reference counts
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_repeated_weak_decrements() {
+  struct tag {};
+  using T = Tracked<tag>;
+  using rc_ptr = cdrc::rc_ptr<T, memory_manager<T>>;
+  using weak_ptr = cdrc::weak_ptr<T, memory_manager<T>>;
+  using atomic_weak_ptr = cdrc::atomic_weak_ptr<T, memory_manager<T>>;
+  auto& mm = memory_manager<T>::instance();
+  [[maybe_unused]] auto before = mm.coalesced_decrements();
+
+  {
+    auto p = rc_ptr::make_shared(1);
+    weak_ptr w(p);
+    atomic_weak_ptr a(w);
+    for (int i = 0; i < 10000; i++) {
+      [[maybe_unused]] guard_t guard;
+      a.store(w);
+      rc_ptr::make_shared(2);  // epochs are advanced by allocations
+    }
+    assert(p->x == 1);
+    assert(a.load().lock()->x == 1);
+  }
+
+  assert(mm.coalesced_decrements() > before);
+}
+
+// Coalesced decrements of a saturated 16-bit count are applied in steps that it
+// tolerates, so that a group as large as the value that the count is pinned to
+// does not free the object
+void test_saturated_narrow_counts() {
+  struct tag {};
+  using T = Tracked<tag>;
+  using memory_manager = cdrc::hp_backend<T, cdrc::compact_counters_object_policy>;
+  using counted_ptr_t = cdrc::internal::counted_object<T, cdrc::compact_counters_object_policy>*;
+  using cdrc::internal::RetireType;
+  auto& mm = memory_manager::instance();
+
+  counted_ptr_t p = mm.create_object(1);
+  const std::size_t refs = 30000;
+  for (std::size_t i = 0; i < refs; i++) p->add_refs(1);
+  std::size_t pinned = p->get_use_count();
+  assert(pinned < refs);
+
+  std::vector<std::pair<counted_ptr_t, RetireType>> ejects(pinned, {p, RetireType::decrement_strong_count});
+  mm.eject_coalesced(ejects);
+  assert(T::num_live.load() == 1 && p->get()->x == 1);
+  ejects.assign(refs - pinned, {p, RetireType::decrement_strong_count});
+  mm.eject_coalesced(ejects);
+  assert(T::num_live.load() == 1 && p->get()->x == 1);
+
+  // A saturated count never reaches zero, so bring it back into range to free the object
+  p->ref_cnt().reset(1);
+  mm.decrement_ref_cnt(p);
+  assert(T::num_live.load() == 0);
+}
+
+int main() {
+  test_repeated_decrements<hp_backend>();
+  test_repeated_decrements<ebr_backend, cdrc::epoch_guard>();
+  test_repeated_decrements<ibr_backend, cdrc::epoch_guard>();
+  test_repeated_decrements<he_backend>();
+  test_repeated_decrements<nbr_backend>();
+
+  test_repeated_weak_decrements<hp_backend>();
+  test_repeated_weak_decrements<ebr_backend, cdrc::epoch_guard>();
+  test_repeated_weak_decrements<ibr_backend, cdrc::epoch_guard>();
+  test_repeated_weak_decrements<he_backend>();
+  test_repeated_weak_decrements<nbr_backend>();
+
+  test_saturated_narrow_counts();
+}
@@ -0,0 +1,88 @@
+#include <cassert>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+std::atomic<int> num_live{0};
+
+struct Tracked {
+  int x;
+  Tracked(int x_) : x(x_) { num_live++; }
+  ~Tracked() { num_live--; }
+};
+
+using memory_manager = cdrc::hp_backend<Tracked>;
+using rc_ptr = cdrc::rc_ptr<Tracked, memory_manager>;
+using atomic_rc_ptr = cdrc::atomic_rc_ptr<Tracked, memory_manager>;
+
+// Returns the largest number of live objects seen by any thread
+int run_workload(int num_threads, int num_ops) {
+  std::vector<atomic_rc_ptr> slots(4);
+  std::vector<std::thread> threads;
+  std::atomic<int> max_live{0};
+  for (int t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      int local_max = 0;
+      for (int i = 0; i < num_ops; i++) {
+        auto& slot = slots[(t + i) % slots.size()];
+        auto s = slot.get_snapshot();
+        if (s) assert(s->x >= 0);
+        slot.store(rc_ptr::make_shared(i));
+        local_max = std::max(local_max, num_live.load());
+      }
+      int expected = max_live.load();
+      while (expected < local_max && !max_live.compare_exchange_weak(expected, local_max)) { }
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (auto& slot : slots) slot.store(nullptr);
+  return max_live.load();
+}
+
+// The number of objects awaiting reclamation stays bounded
+void test_bounded() {
+  auto& mm = memory_manager::instance();
+  mm.set_reclamation_budget(2);
+  [[maybe_unused]] int max_live = run_workload(4, 20000);
+  assert(max_live < 2000);
+  mm.set_reclamation_budget(0);
+}
+
+// A snapshot taken while a pass is scanning protects its object until it is released
+void test_protected_during_pass() {
+  auto& mm = memory_manager::instance();
+  mm.set_reclamation_budget(2);
+  atomic_rc_ptr a(rc_ptr::make_shared(1));
+  {
+    auto s = a.get_snapshot();
+    for (int i = 0; i < 10000; i++) a.store(rc_ptr::make_shared(i + 2));
+    assert(s->x == 1);
+  }
+  a.store(nullptr);
+  mm.set_reclamation_budget(0);
+}
+
+// Turning incremental reclamation off hands any unfinished pass back to the
+// regular reclamation, which then reclaims everything
+void test_disable() {
+  auto& mm = memory_manager::instance();
+  mm.set_reclamation_budget(2);
+  run_workload(2, 1001);
+  mm.set_reclamation_budget(0);
+  atomic_rc_ptr a;
+  for (int i = 0; i < 100000 && num_live.load() > 1; i++) {
+    a.store(rc_ptr::make_shared(i));
+  }
+  assert(num_live.load() <= 1);
+}
+
+int main() {
+  test_bounded();
+  test_protected_during_pass();
+  test_disable();
+}
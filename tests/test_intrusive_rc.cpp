@@ -0,0 +1,151 @@
+#include <cassert>
+#include <cstddef>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/atomic_weak_ptr.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/weak_ptr.h>
+
+std::atomic<int> num_live{0};
+
+// A node that keeps its reference counts next to its key, ahead of its payload
+struct Node : public cdrc::rc_base {
+  int key;
+  cdrc::rc_ptr<Node> next;
+  char payload[256];
+
+  explicit Node(int key_, cdrc::rc_ptr<Node> next_ = nullptr) : key(key_), next(std::move(next_)) { num_live++; }
+  ~Node() { num_live--; }
+};
+
+// rc_base is not the first base, so its counts are not at the start of the object
+struct Tagged {
+  int tag{7};
+};
+
+std::atomic<bool> tagged_disposed{false};
+
+struct TaggedNode : public Tagged, public cdrc::rc_base {
+  int key;
+
+  explicit TaggedNode(int key_) : key(key_) { }
+  ~TaggedNode() { if (key >= 0) tagged_disposed = true; }
+};
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using hyaline_backend = cdrc::hyaline_backend<T>;
+
+void test_layout() {
+  using counted_object_t = cdrc::internal::counted_object<Node>;
+  counted_object_t* obj = new counted_object_t(1);
+  auto node_addr = reinterpret_cast<std::byte*>(obj->get());
+  auto count_addr = reinterpret_cast<std::byte*>(&obj->ref_cnt());
+  [[maybe_unused]] auto offset = count_addr - node_addr;
+  assert(offset >= 0 && offset < 64);
+#ifdef NDEBUG
+  static_assert(sizeof(counted_object_t) == sizeof(Node));
+#endif
+  [[maybe_unused]] auto action = obj->release_refs(1);
+  assert(action == counted_object_t::EjectAction::dispose);
+  obj->dispose();
+  delete obj;
+  assert(num_live.load() == 0);
+}
+
+void test_strong_and_weak() {
+  {
+    cdrc::rc_ptr<Node> p = cdrc::make_rc<Node>(1);
+    cdrc::rc_ptr<Node> q = cdrc::make_rc<Node>(2, p);
+    assert(p.use_count() == 2);
+    cdrc::weak_ptr<Node> w = p;
+    assert(p.weak_count() == 1);
+    p = nullptr;
+    assert(!w.expired());
+    q = nullptr;
+    assert(w.expired());
+    assert(w.lock() == nullptr);
+  }
+}
+
+// Weak references that outlive the object keep using its counts, which
+// outlive the object itself
+void test_weak_outlives_object() {
+  cdrc::weak_ptr<TaggedNode> w;
+  {
+    cdrc::rc_ptr<TaggedNode> p = cdrc::make_rc<TaggedNode>(1);
+    w = p;
+    assert(p.use_count() == 1 && p.weak_count() == 1);
+    assert(p->tag == 7 && p->key == 1);
+  }
+  // The disposal of a weakly-referenced object is deferred, so drive reclamation until it happens
+  for (int i = 0; i < 1000000 && !tagged_disposed.load(); i++) {
+    cdrc::atomic_rc_ptr<TaggedNode> a(cdrc::make_rc<TaggedNode>(-1));
+    auto s = a.get_snapshot();
+    a.store(nullptr);
+  }
+  assert(tagged_disposed.load());
+  assert(w.expired());
+  cdrc::weak_ptr<TaggedNode> w2 = w;
+  assert(w2.lock() == nullptr);
+}
+
+// Intrusive objects honor a policy that disallows weak references
+void test_no_weak() {
+  using memory_manager = cdrc::hp_backend<Node, cdrc::no_weak_object_policy>;
+  using rc_ptr = cdrc::rc_ptr<Node, memory_manager>;
+  static_assert(memory_manager::num_retire_types == 1);
+  [[maybe_unused]] int live_before = num_live.load();
+  {
+    rc_ptr p = rc_ptr::make_shared(1);
+    rc_ptr q = p;
+    assert(p.use_count() == 2);
+    p = nullptr;
+    assert(q.use_count() == 1 && q->key == 1);
+  }
+  assert(num_live.load() == live_before);
+}
+
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_concurrent() {
+  using rc_ptr = cdrc::rc_ptr<Node, memory_manager<Node>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<Node, memory_manager<Node>>;
+
+  atomic_rc_ptr head;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 10000; i++) {
+        [[maybe_unused]] guard_t guard;
+        if (t == 0) {
+          auto s = head.get_snapshot();
+          head.store(rc_ptr::make_shared(i));
+        } else {
+          auto s = head.get_snapshot();
+          if (s) assert(s->key >= 0);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  head.store(nullptr);
+}
+
+int main() {
+  test_layout();
+  test_strong_and_weak();
+  test_weak_outlives_object();
+  test_no_weak();
+  test_concurrent<hp_backend>();
+  test_concurrent<ebr_backend, cdrc::epoch_guard>();
+  test_concurrent<hyaline_backend, cdrc::hyaline_guard>();
+}
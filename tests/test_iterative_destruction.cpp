@@ -0,0 +1,149 @@
+#include <cassert>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+#include <cdrc/weak_ptr.h>
+
+// Long enough that destroying the chain recursively would overflow the call stack
+const int chain_length = 1000000;
+
+// Nodes with negative values are not counted, so that they can be used to drive deferred reclamation
+std::atomic<int> num_live{0};
+
+// Constructed before, and hence destroyed after, the memory managers, so that
+// it sees whether their destruction disposed of everything that was left queued
+struct check_at_exit {
+  ~check_at_exit() { assert(num_live.load() == 0); }
+} checker;
+
+template<typename Tag>
+struct Node {
+  int x;
+  cdrc::rc_ptr<Node> next;
+  Node(int x_, cdrc::rc_ptr<Node> next_) : x(x_), next(std::move(next_)) { if (x >= 0) num_live++; }
+  ~Node() { if (x >= 0) num_live--; }
+};
+
+template<typename Tag>
+struct AtomicNode {
+  int x;
+  cdrc::atomic_rc_ptr<AtomicNode> next;
+  AtomicNode(int x_, cdrc::rc_ptr<AtomicNode> next_) : x(x_), next(std::move(next_)) { if (x >= 0) num_live++; }
+  ~AtomicNode() { if (x >= 0) num_live--; }
+};
+
+template<typename node_type>
+cdrc::rc_ptr<node_type> make_chain(int length) {
+  cdrc::rc_ptr<node_type> head;
+  for (int i = 0; i < length; i++) {
+    head = cdrc::make_rc<node_type>(i, std::move(head));
+  }
+  return head;
+}
+
+void test_chain() {
+  struct tag {};
+  auto head = make_chain<Node<tag>>(chain_length);
+  assert(num_live.load() == chain_length);
+  head = nullptr;
+  assert(num_live.load() == 0);
+}
+
+// Weak references in the middle of the chain defer the disposal of their objects
+void test_chain_with_weak_refs() {
+  struct tag {};
+  using node_type = Node<tag>;
+  auto head = make_chain<node_type>(chain_length);
+  std::vector<cdrc::weak_ptr<node_type>> weak;
+  auto node = head.get();
+  for (int i = 0; node != nullptr; i++, node = node->next.get()) {
+    if (i % 1000 == 0) weak.emplace_back(node->next);
+  }
+  head = nullptr;
+  assert(weak.front().expired());
+  weak.clear();
+  for (int i = 0; i < 1000000 && num_live.load() > 0; i++) {
+    cdrc::atomic_rc_ptr<node_type> a(cdrc::make_rc<node_type>(-1, nullptr));
+    auto s = a.get_snapshot();
+    a.store(nullptr);
+  }
+  assert(num_live.load() == 0);
+}
+
+// Chains linked by atomic pointers are dropped one deferred decrement at a time,
+// and the disposals happen during ejects, which may themselves be reentrant
+void test_atomic_chain() {
+  struct tag {};
+  using node_type = AtomicNode<tag>;
+  const int length = 1000;
+  {
+    cdrc::atomic_rc_ptr<node_type> head(make_chain<node_type>(length));
+    auto s = head.get_snapshot();
+    assert(s->x == length - 1);
+  }
+  for (int i = 0; i < 1000000 && num_live.load() > 0; i++) {
+    cdrc::atomic_rc_ptr<node_type> a(cdrc::make_rc<node_type>(-1, nullptr));
+    auto s = a.get_snapshot();
+    a.store(nullptr);
+  }
+  assert(num_live.load() == 0);
+}
+
+// A destruction budget spreads the teardown of the chain across operations
+void test_budget() {
+  struct tag {};
+  using node_type = Node<tag>;
+  auto& mm = cdrc::hp_backend<node_type>::instance();
+  mm.set_destruction_budget(100);
+  auto head = make_chain<node_type>(chain_length);
+  head = nullptr;
+  assert(num_live.load() == chain_length - 100);
+  auto other = make_chain<node_type>(1);
+  other = nullptr;
+  assert(num_live.load() == chain_length - 199);
+  mm.flush_destructions();
+  assert(num_live.load() == 0);
+}
+
+// Objects that are dropped after the thread has exited, by which time nothing
+// would dispose of what the budget leaves queued, are disposed of by the
+// destruction of the memory manager
+void test_budget_at_exit() {
+  struct tag {};
+  using node_type = Node<tag>;
+  cdrc::hp_backend<node_type>::instance().set_destruction_budget(100);
+  static cdrc::rc_ptr<node_type> head = make_chain<node_type>(chain_length);
+  assert(num_live.load() == chain_length);
+}
+
+// Concurrently dropping parts of a shared chain
+void test_concurrent() {
+  struct tag {};
+  using node_type = Node<tag>;
+  auto head = make_chain<node_type>(chain_length);
+  std::vector<cdrc::rc_ptr<node_type>> starts;
+  auto node = head.get();
+  for (int i = 0; node != nullptr; i++, node = node->next.get()) {
+    if (i > 0 && i % (chain_length / 4) == 0) starts.emplace_back(node->next);
+  }
+  std::vector<std::thread> threads;
+  for (auto& start : starts) {
+    threads.emplace_back([&start]() { start = nullptr; });
+  }
+  head = nullptr;
+  for (auto& t : threads) t.join();
+  assert(num_live.load() == 0);
+}
+
+int main() {
+  test_chain();
+  test_chain_with_weak_refs();
+  test_atomic_chain();
+  test_budget();
+  test_concurrent();
+  test_budget_at_exit();
+}
@@ -0,0 +1,188 @@
+#include <cassert>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+std::atomic<int> num_live{0};
+
+// Only used by the object that test_nested_after_write keeps a snapshot of
+constexpr int watched_value = -42;
+std::atomic<bool> watched_destroyed{false};
+
+struct Tracked {
+  int x;
+  explicit Tracked(int x_) : x(x_) { num_live++; }
+  ~Tracked() {
+    if (x == watched_value) watched_destroyed.store(true);
+    num_live--;
+  }
+};
+
+using memory_manager = cdrc::nbr_backend<Tracked>;
+using rc_ptr = cdrc::rc_ptr<Tracked, memory_manager>;
+using atomic_rc_ptr = cdrc::atomic_rc_ptr<Tracked, memory_manager>;
+
+// A thread that stalls in a read phase while holding a snapshot is neutralized,
+// so it does not prevent the objects that it read from being reclaimed
+void test_stalled_reader() {
+  atomic_rc_ptr a(rc_ptr::make_shared(0));
+  std::atomic<bool> done{false};
+  std::atomic<int> attempts{0};
+
+  std::thread reader([&]() {
+    cdrc::with_nbr_read_phase([&]() {
+      attempts++;
+      auto s = a.get_snapshot();
+      while (!done.load()) {
+        assert(s->x >= 0);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    });
+  });
+
+  while (attempts.load() == 0) std::this_thread::yield();
+  for (int i = 1; i < 100000 && attempts.load() < 10; i++) {
+    a.store(rc_ptr::make_shared(i));
+  }
+  assert(attempts.load() >= 10);
+  assert(num_live.load() < 1000);
+  done.store(true);
+  reader.join();
+  a.store(nullptr);
+}
+
+// A read phase that writes is no longer restarted, and its snapshots stay protected
+void test_write_ends_read_phase() {
+  atomic_rc_ptr a(rc_ptr::make_shared(0));
+  atomic_rc_ptr b;
+  std::atomic<bool> wrote{false}, done{false};
+  std::atomic<int> attempts{0};
+
+  std::thread reader([&]() {
+    cdrc::with_nbr_read_phase([&]() {
+      attempts++;
+      auto s = a.get_snapshot();
+      b.store(rc_ptr::make_shared(-1));
+      wrote.store(true);
+      while (!done.load()) {
+        assert(s->x == 0);
+        std::this_thread::yield();
+      }
+    });
+  });
+
+  while (!wrote.load()) std::this_thread::yield();
+  for (int i = 1; i < 10000; i++) {
+    a.store(rc_ptr::make_shared(i));
+  }
+  done.store(true);
+  reader.join();
+  assert(attempts.load() == 1);
+  a.store(nullptr);
+  b.store(nullptr);
+}
+
+// A snapshot taken in a read phase that has ended early stays protected when the
+// rest of the function runs read phases of its own, even if they are neutralized
+void test_nested_after_write() {
+  atomic_rc_ptr a(rc_ptr::make_shared(watched_value));
+  atomic_rc_ptr b;
+  atomic_rc_ptr c(rc_ptr::make_shared(0));
+  std::atomic<bool> wrote{false}, done{false};
+
+  std::thread reader([&]() {
+    cdrc::with_nbr_read_phase([&]() {
+      auto s = a.get_snapshot();
+      b.store(rc_ptr::make_shared(-1));
+      wrote.store(true);
+      while (!done.load()) {
+        [[maybe_unused]] int x = cdrc::with_nbr_read_phase([&]() { return c.get_snapshot()->x; });
+        assert(x >= 0);
+        assert(!watched_destroyed.load());
+        std::this_thread::yield();
+      }
+      assert(s->x == watched_value);
+    });
+  });
+
+  while (!wrote.load()) std::this_thread::yield();
+  for (int i = 1; i < 10000; i++) {
+    a.store(rc_ptr::make_shared(i));
+    c.store(rc_ptr::make_shared(i));
+  }
+  assert(!watched_destroyed.load());
+  done.store(true);
+  reader.join();
+  a.store(nullptr);
+  b.store(nullptr);
+  c.store(nullptr);
+}
+
+// A read phase that is left by an exception ends, so that reads outside of read
+// phases are validated again, and a later read phase is neutralized as usual
+void test_exception_ends_read_phase() {
+  atomic_rc_ptr a(rc_ptr::make_shared(0));
+  std::atomic<bool> holding{false}, released{false}, done{false};
+  std::atomic<int> attempts{0};
+
+  std::thread reader([&]() {
+    try {
+      cdrc::with_nbr_read_phase([&]() {
+        auto s = a.get_snapshot();
+        throw s->x;
+      });
+    } catch (int) { }
+    assert(!cdrc::internal::nbr_tracker::instance().in_read_phase());
+    {
+      auto s = a.get_snapshot();
+      holding.store(true);
+      while (!released.load()) {
+        assert(s->x == 0);
+        std::this_thread::yield();
+      }
+    }
+    cdrc::with_nbr_read_phase([&]() {
+      attempts++;
+      auto s = a.get_snapshot();
+      while (!done.load()) {
+        assert(s->x >= 0);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    });
+  });
+
+  while (!holding.load()) std::this_thread::yield();
+  for (int i = 1; i < 10000; i++) {
+    a.store(rc_ptr::make_shared(i));
+  }
+  released.store(true);
+  while (attempts.load() == 0) std::this_thread::yield();
+  for (int i = 1; i < 100000 && attempts.load() < 10; i++) {
+    a.store(rc_ptr::make_shared(i));
+  }
+  assert(attempts.load() >= 10);
+  done.store(true);
+  reader.join();
+  a.store(nullptr);
+}
+
+// Read phases return the result of the function that they run
+void test_result() {
+  atomic_rc_ptr a(rc_ptr::make_shared(42));
+  [[maybe_unused]] int x = cdrc::with_nbr_read_phase([&]() { return a.get_snapshot()->x; });
+  assert(x == 42);
+  auto p = cdrc::with_nbr_read_phase([&]() { return a.load(); });
+  assert(p->x == 42);
+}
+
+int main() {
+  test_stalled_reader();
+  test_write_ends_read_phase();
+  test_nested_after_write();
+  test_exception_ends_read_phase();
+  test_result();
+}
@@ -0,0 +1,177 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+struct Small {
+  int x;
+  Small(int x_) : x(x_) {}
+};
+
+struct Large {
+  int x;
+  char payload[500];
+  Large(int x_) : x(x_) {}
+};
+
+template<typename T, typename object_policy>
+std::ptrdiff_t counter_offset() {
+  using counted_object_t = cdrc::internal::counted_object<T, object_policy>;
+  auto obj = new counted_object_t(1);
+  auto offset = reinterpret_cast<std::byte*>(&obj->ref_cnt()) - reinterpret_cast<std::byte*>(obj->get());
+  obj->release_refs(1);
+  obj->dispose();
+  delete obj;
+  return offset;
+}
+
+template<typename T>
+void test_layouts() {
+  [[maybe_unused]] auto packed = counter_offset<T, cdrc::default_object_policy>();
+  assert(packed >= static_cast<std::ptrdiff_t>(sizeof(T)));
+  assert(packed < static_cast<std::ptrdiff_t>(sizeof(T) + alignof(T)));
+
+  [[maybe_unused]] auto before = counter_offset<T, cdrc::counters_before_payload_object_policy>();
+  assert(before < 0 && before >= -64);
+
+  using isolated_t = cdrc::internal::counted_object<T, cdrc::isolated_counters_object_policy>;
+  static_assert(alignof(isolated_t) >= 128);
+  [[maybe_unused]] auto isolated = counter_offset<T, cdrc::isolated_counters_object_policy>();
+  assert(isolated >= static_cast<std::ptrdiff_t>(sizeof(T)));
+  assert(isolated % 128 == 0);
+}
+
+void test_counter_widths() {
+  static_assert(sizeof(cdrc::internal::counted_object<int, cdrc::compact_counters_object_policy>) <
+                sizeof(cdrc::internal::counted_object<int, cdrc::default_object_policy>));
+
+  // 16-bit counters saturate instead of overflowing, after which they never reach zero
+  cdrc::utils::StickyCounter<uint16_t> narrow(1);
+  for (int i = 0; i < 100000; i++) narrow.increment(1);
+  assert(narrow.load() > 0);
+  for (int i = 0; i < 100001; i++) {
+    [[maybe_unused]] bool zero = narrow.decrement(1);
+    assert(!zero);
+  }
+  assert(narrow.load() > 0);
+
+  // Counters that stay in range behave normally
+  cdrc::utils::StickyCounter<uint16_t> small(1);
+  for (int i = 0; i < 1000; i++) small.increment(1);
+  assert(small.load() == 1001);
+  for (int i = 0; i < 1000; i++) small.decrement(1);
+  [[maybe_unused]] bool zero = small.decrement(1);
+  assert(zero);
+  assert(small.load() == 0);
+
+  // 64-bit counters can exceed the range of a 32-bit counter
+  cdrc::utils::StickyCounter<uint64_t> wide(1);
+  wide.increment(uint64_t(1) << 40);
+  assert(wide.load() == (uint64_t(1) << 40) + 1);
+}
+
+std::atomic<int> num_live{0};
+
+struct Tracked {
+  int x;
+  Tracked(int x_) : x(x_) { num_live++; }
+  ~Tracked() { num_live--; }
+};
+
+template<typename T>
+using no_weak_ebr_backend = cdrc::ebr_backend<T, cdrc::no_weak_object_policy>;
+
+template<typename T>
+using no_weak_hyaline_backend = cdrc::hyaline_backend<T, cdrc::no_weak_object_policy>;
+
+void test_no_weak() {
+  static_assert(sizeof(cdrc::internal::counted_object<int, cdrc::no_weak_object_policy>) <
+                sizeof(cdrc::internal::counted_object<int, cdrc::default_object_policy>));
+  static_assert(cdrc::hp_backend<int, cdrc::no_weak_object_policy>::num_retire_types == 1);
+
+  // Without weak references, the last strong reference destroys the object immediately
+  using counted_object_t = cdrc::internal::counted_object<Tracked, cdrc::no_weak_object_policy>;
+  auto obj = new counted_object_t(1);
+  obj->add_refs(1);
+  [[maybe_unused]] auto action = obj->release_refs(1);
+  assert(action == counted_object_t::EjectAction::nothing);
+  action = obj->release_refs(1);
+  assert(action == counted_object_t::EjectAction::dispose);
+  obj->dispose();
+  assert(num_live.load() == 0);
+  delete obj;
+
+  using rc_ptr = cdrc::rc_ptr<Tracked, cdrc::hp_backend<Tracked, cdrc::no_weak_object_policy>>;
+  rc_ptr p = rc_ptr::make_shared(1);
+  rc_ptr q = p;
+  assert(p.use_count() == 2);
+  assert(p.weak_count() == 0);
+  p = nullptr;
+  q = nullptr;
+  assert(num_live.load() == 0);
+}
+
+template<template<typename> typename memory_manager, typename guard_t>
+void test_no_weak_deferred() {
+  using rc_ptr = cdrc::rc_ptr<Tracked, memory_manager<Tracked>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<Tracked, memory_manager<Tracked>>;
+
+  atomic_rc_ptr p(rc_ptr::make_shared(0));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 10000; i++) {
+        [[maybe_unused]] guard_t guard;
+        auto s = p.get_snapshot();
+        if (t == 0) p.store(rc_ptr::make_shared(i));
+        else if (s) assert(s->x >= 0);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  p.store(nullptr);
+}
+
+template<typename object_policy>
+void test_concurrent() {
+  using backend = cdrc::hp_backend<Large, object_policy>;
+  using rc_ptr = cdrc::rc_ptr<Large, backend>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<Large, backend>;
+
+  atomic_rc_ptr p(rc_ptr::make_shared(0));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 10000; i++) {
+        if (t == 0) p.store(rc_ptr::make_shared(i));
+        else {
+          [[maybe_unused]] auto s = p.get_snapshot();
+          assert(s->x >= 0);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  p.store(nullptr);
+}
+
+int main() {
+  test_layouts<Small>();
+  test_layouts<Large>();
+  test_counter_widths();
+  test_concurrent<cdrc::default_object_policy>();
+  test_concurrent<cdrc::counters_before_payload_object_policy>();
+  test_concurrent<cdrc::isolated_counters_object_policy>();
+  test_concurrent<cdrc::compact_counters_object_policy>();
+  test_concurrent<cdrc::wide_counters_object_policy>();
+  test_concurrent<cdrc::no_weak_object_policy>();
+  test_no_weak();
+  test_no_weak_deferred<no_weak_ebr_backend, cdrc::epoch_guard>();
+  test_no_weak_deferred<no_weak_hyaline_backend, cdrc::hyaline_guard>();
+}
@@ -0,0 +1,104 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+#include "../benchmarks/barrier.hpp"
+
+using pool = cdrc::internal::slab_pool;
+
+struct alignas(64) Aligned {
+  int x;
+  Aligned(int x_) : x(x_) {}
+};
+
+template<typename T>
+using pool_backend = cdrc::hp_backend<T, cdrc::pool_object_policy>;
+
+template<typename T>
+using pool_backend_ebr = cdrc::ebr_backend<T, cdrc::pool_object_policy>;
+
+void test_alignment_and_reuse() {
+  auto& p = pool::instance();
+  std::vector<std::pair<void*, std::size_t>> blocks;
+  for (std::size_t alignment : {1, 8, 16, 32, 64, 128}) {
+    for (std::size_t size = alignment; size <= pool::max_block_size; size += alignment) {
+      void* b = p.allocate(size, alignment);
+      assert(reinterpret_cast<uintptr_t>(b) % alignment == 0);
+      blocks.emplace_back(b, alignment);
+    }
+  }
+  [[maybe_unused]] auto stats = p.get_statistics();
+  assert(stats.used_blocks >= blocks.size());
+  assert(stats.reserved_bytes >= stats.used_bytes);
+
+  // Freed blocks should be handed straight back out again
+  void* b = p.allocate(48, 16);
+  p.deallocate(b, 48, 16);
+  void* c = p.allocate(40, 8);
+  assert(b == c);
+  p.deallocate(c, 40, 8);
+
+  for (std::size_t alignment : {1, 8, 16, 32, 64, 128}) {
+    for (std::size_t size = alignment; size <= pool::max_block_size; size += alignment) {
+      auto it = std::find_if(blocks.begin(), blocks.end(), [&](auto& x) { return x.second == alignment; });
+      p.deallocate(it->first, size, alignment);
+      blocks.erase(it);
+    }
+  }
+
+  // Oversized requests go to the system allocator
+  void* big = p.allocate(4 * pool::max_block_size, 16);
+  p.deallocate(big, 4 * pool::max_block_size, 16);
+}
+
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_cross_thread_frees() {
+  using rc_ptr = cdrc::rc_ptr<Aligned, memory_manager<Aligned>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<Aligned, memory_manager<Aligned>>;
+
+  const std::size_t num_threads = std::max<std::size_t>(2, cdrc::utils::num_threads() - 1);
+  const int num_ops = 10000;
+
+  // Objects are allocated by producers and freed by whichever thread
+  // drops the last reference, which exercises the batched hand-off
+  // of blocks between threads through the global lists
+  std::vector<atomic_rc_ptr> slots(4);
+  Barrier barrier(num_threads);
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      barrier.wait();
+      for (int i = 0; i < num_ops; i++) {
+        [[maybe_unused]] guard_t guard;
+        auto& slot = slots[(t + i) % slots.size()];
+        if (t % 2 == 0) {
+          slot.store(rc_ptr::make_shared(i));
+        } else {
+          rc_ptr p = slot.load();
+          if (p) assert(reinterpret_cast<uintptr_t>(p.get()) % alignof(Aligned) == 0);
+          slot.store(nullptr);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (auto& slot : slots) slot.store(nullptr);
+}
+
+int main() {
+  test_alignment_and_reuse();
+  test_cross_thread_frees<pool_backend>();
+  test_cross_thread_frees<pool_backend_ebr, cdrc::epoch_guard>();
+
+  [[maybe_unused]] auto stats = cdrc::internal::pool_allocator::get_statistics();
+  assert(stats.reserved_bytes > 0);
+  assert(stats.used_bytes <= stats.reserved_bytes);
+}
@@ -0,0 +1,119 @@
+#include <cassert>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+std::atomic<int> num_live{0};
+
+struct Tracked {
+  int x;
+  explicit Tracked(int x_) : x(x_) { num_live++; }
+  ~Tracked() { x = -1; num_live--; }
+};
+
+using memory_manager = cdrc::qsbr_backend<Tracked>;
+using rc_ptr = cdrc::rc_ptr<Tracked, memory_manager>;
+using atomic_rc_ptr = cdrc::atomic_rc_ptr<Tracked, memory_manager>;
+
+// Replace the object n times, announcing a quiescent state after each
+void churn(atomic_rc_ptr& a, int n) {
+  for (int i = 1; i <= n; i++) {
+    a.store(rc_ptr::make_shared(i));
+    cdrc::quiescent_state();
+  }
+}
+
+// A thread that stays online without announcing a quiescent state keeps what it
+// read alive, and holds back everything retired since. Once it goes offline, the
+// objects that it held back are reclaimed
+void test_online_reader_holds_back() {
+  atomic_rc_ptr a(rc_ptr::make_shared(0));
+  std::atomic<bool> reading{false}, done{false};
+
+  std::thread reader([&]() {
+    cdrc::online();
+    {
+      auto s = a.get_snapshot();
+      reading.store(true);
+      while (!done.load()) {
+        assert(s->x == 0);
+        std::this_thread::yield();
+      }
+    }
+    cdrc::offline();
+  });
+
+  while (!reading.load()) std::this_thread::yield();
+  churn(a, 10000);
+  assert(num_live.load() > 5000);
+  done.store(true);
+  reader.join();
+  churn(a, 10000);
+  assert(num_live.load() < 1000);
+  a.store(nullptr);
+}
+
+// A thread that is offline does not delay reclamation, however long it waits
+void test_offline_thread() {
+  atomic_rc_ptr a(rc_ptr::make_shared(0));
+  std::atomic<bool> waiting{false}, done{false};
+
+  std::thread sleeper([&]() {
+    cdrc::online();
+    assert(a.get_snapshot()->x >= 0);
+    cdrc::offline();
+    waiting.store(true);
+    while (!done.load()) std::this_thread::yield();
+  });
+
+  while (!waiting.load()) std::this_thread::yield();
+  churn(a, 10000);
+  assert(num_live.load() < 1000);
+  done.store(true);
+  sleeper.join();
+  a.store(nullptr);
+}
+
+// Threads that announce quiescent states between their operations never see an
+// object that has been destroyed
+void test_concurrent() {
+  constexpr int n_objects = 16, n_threads = 4, n_ops = 20000;
+  std::vector<atomic_rc_ptr> objects(n_objects);
+  for (auto& object : objects) object.store(rc_ptr::make_shared(0));
+
+  std::vector<std::thread> threads;
+  for (int p = 0; p < n_threads; p++) {
+    threads.emplace_back([&, p]() {
+      cdrc::online();
+      unsigned k = p;
+      for (int i = 0; i < n_ops; i++) {
+        k = (k * 1103515245 + 12345) % n_objects;
+        {
+          auto s = objects[k].get_snapshot();
+          assert(s->x >= 0);
+          objects[(k + 1) % n_objects].store(rc_ptr::make_shared(s->x + 1));
+          auto r = objects[(k + 2) % n_objects].load();
+          assert(r->x >= 0);
+        }
+        cdrc::quiescent_state();
+      }
+      cdrc::offline();
+    });
+  }
+  cdrc::offline();  // Do not hold back the other threads while waiting for them
+  for (auto& t : threads) t.join();
+  cdrc::online();
+  for (auto& object : objects) object.store(nullptr);
+}
+
+int main() {
+  cdrc::online();
+  test_online_reader_holds_back();
+  test_offline_thread();
+  test_concurrent();
+  cdrc::offline();
+}
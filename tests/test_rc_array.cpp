@@ -0,0 +1,168 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+std::atomic<int> num_live{0};
+std::atomic<int> fail_at{-1};
+
+struct Element {
+  int x;
+  Element() : x(0) { construct(); }
+  Element(const Element& other) : x(other.x) { construct(); }
+  ~Element() { num_live--; }
+
+ private:
+  void construct() {
+    if (fail_at.load() == num_live.load()) throw std::runtime_error("Element construction failed");
+    num_live++;
+  }
+};
+
+struct alignas(64) Aligned {
+  int x{0};
+};
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using ibr_backend = cdrc::ibr_backend<T>;
+
+template<typename T>
+using hyaline_backend = cdrc::hyaline_backend<T>;
+
+template<typename T>
+using pool_backend = cdrc::hp_backend<T, cdrc::pool_object_policy>;
+
+void test_basic() {
+  {
+    auto p = cdrc::make_rc<int[]>(100);
+    assert(p.size() == 100);
+    for (std::size_t i = 0; i < p.size(); i++) assert(p[i] == 0);
+    for (std::size_t i = 0; i < p.size(); i++) p[i] = static_cast<int>(i);
+    auto q = p;
+    assert(p.use_count() == 2);
+    assert(q[99] == 99);
+    assert(q.get() == p.get());
+
+    auto filled = cdrc::make_rc<int[]>(10, 42);
+    for (std::size_t i = 0; i < filled.size(); i++) assert(filled[i] == 42);
+
+    auto empty = cdrc::make_rc<int[]>(0);
+    assert(empty != nullptr);
+    assert(empty.size() == 0);
+
+    cdrc::rc_ptr<int[]> null;
+    assert(null.size() == 0);
+  }
+  {
+    auto p = cdrc::make_rc<Aligned[]>(7);
+    for (std::size_t i = 0; i < p.size(); i++) assert(reinterpret_cast<uintptr_t>(&p[i]) % 64 == 0);
+  }
+  // Backends that stamp their objects place the stamp in front, so the elements still follow the counts
+  {
+    auto p = cdrc::rc_ptr<Aligned[], ibr_backend<Aligned[]>>::make_shared(7);
+    for (std::size_t i = 0; i < p.size(); i++) assert(reinterpret_cast<uintptr_t>(&p[i]) % 64 == 0);
+    auto q = cdrc::rc_ptr<int[], ibr_backend<int[]>>::make_shared(10, 42);
+    for (std::size_t i = 0; i < q.size(); i++) assert(q[i] == 42);
+  }
+  // The elements are found from the address of the counts rather than through a pointer
+#ifdef NDEBUG
+  static_assert(sizeof(cdrc::internal::counted_object<int[]>) == 2 * sizeof(uint32_t) + sizeof(std::size_t));
+#endif
+}
+
+void test_element_lifetimes() {
+  {
+    auto p = cdrc::make_rc<Element[]>(50);
+    assert(num_live.load() == 50);
+    auto q = cdrc::make_rc<Element[]>(20, p[0]);
+    assert(num_live.load() == 70);
+  }
+  assert(num_live.load() == 0);
+
+  // If the construction of an element throws, the elements that were already
+  // constructed are destroyed, and the storage is released
+  fail_at.store(10);
+  [[maybe_unused]] bool thrown = false;
+  try {
+    auto p = cdrc::make_rc<Element[]>(50);
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+  fail_at.store(-1);
+  assert(thrown);
+  assert(num_live.load() == 0);
+}
+
+// A length whose storage would not fit in a size_t is rejected before anything is allocated
+void test_length_overflow() {
+  auto& mm = cdrc::hp_backend<Element[]>::instance();
+  [[maybe_unused]] auto allocated = mm.currently_allocated();
+  for (auto n : {std::numeric_limits<std::size_t>::max(), std::numeric_limits<std::size_t>::max() / sizeof(Element)}) {
+    [[maybe_unused]] bool thrown = false;
+    try {
+      auto p = cdrc::make_rc<Element[]>(n);
+    } catch (const std::bad_array_new_length&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+  assert(mm.currently_allocated() == allocated);
+  assert(num_live.load() == 0);
+}
+
+// Copy-on-write updates of a shared segment, where readers must always observe a fully-written copy
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_copy_on_write() {
+  using rc_ptr = cdrc::rc_ptr<int64_t[], memory_manager<int64_t[]>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<int64_t[], memory_manager<int64_t[]>>;
+
+  const std::size_t length = 64;
+  atomic_rc_ptr segment(rc_ptr::make_shared(length, 0));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 3; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 5000; i++) {
+        [[maybe_unused]] guard_t guard;
+        if (t == 0) {
+          auto old_segment = segment.load();
+          auto new_segment = rc_ptr::make_shared(length);
+          for (std::size_t j = 0; j < length; j++) new_segment[j] = old_segment[j] + 1;
+          segment.store(std::move(new_segment));
+        } else {
+          auto s = segment.get_snapshot();
+          assert(s.size() == length);
+          for (std::size_t j = 1; j < length; j++) assert(s[j] == s[0]);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  assert(segment.load()[0] == 5000);
+  segment.store(nullptr);
+}
+
+int main() {
+  test_basic();
+  test_element_lifetimes();
+  test_length_overflow();
+  test_copy_on_write<hp_backend>();
+  test_copy_on_write<ebr_backend, cdrc::epoch_guard>();
+  test_copy_on_write<ibr_backend, cdrc::epoch_guard>();
+  test_copy_on_write<hyaline_backend, cdrc::hyaline_guard>();
+  test_copy_on_write<pool_backend>();
+}
@@ -14,7 +14,11 @@
 #include <cdrc/internal/smr/acquire_retire.h>
 #include <cdrc/internal/smr/acquire_retire_ibr.h>
 #include <cdrc/internal/smr/acquire_retire_ebr.h>
+#include <cdrc/internal/smr/acquire_retire_he.h>
 #include <cdrc/internal/smr/acquire_retire_hyaline.h>
+#include <cdrc/internal/smr/acquire_retire_hyaline_s.h>
+#include <cdrc/internal/smr/acquire_retire_crystalline.h>
+#include <cdrc/internal/smr/acquire_retire_nbr.h>
 
 #include "../benchmarks/barrier.hpp"
 
@@ -118,6 +122,28 @@ void test_concurrent_delete() {
   delete setFactory;
 }
 
+// A pointer to a value in place keeps its node alive after the key is removed
+// and the node has been unlinked and retired
+template<class MapFactory>
+void test_value_ptr() {
+  auto* mapFactory = new MapFactory();
+  auto* map = mapFactory->build(nullptr);
+  assert(map->insert(1, 42, 0));
+  auto v = map->get_value_ptr(1, 0);
+  assert(v != nullptr && *v == 42);
+  assert(map->get_value_ptr(2, 0) == nullptr);
+  assert(map->remove(1, 0));
+  assert(!map->get(1, 0));
+  for (int i = 0; i < 10000; i++) {
+    assert(map->insert(i + 2, i, 0));
+    assert(map->remove(i + 2, 0));
+  }
+  assert(*v == 42);
+  v = nullptr;
+  delete map;
+  delete mapFactory;
+}
+
 template<class SetFactory>
 void run_all_tests(int num_iter) {
   test_simple<SetFactory>();
@@ -128,28 +154,69 @@ void run_all_tests(int num_iter) {
 template<typename T>
 using hp = cdrc::internal::acquire_retire<T>;
 
+template<typename T>
+using hp_asym = cdrc::hp_asymmetric_backend<T>;
+
 template<typename T>
 using ebr = cdrc::internal::acquire_retire_ebr<T>;
 
 template<typename T>
 using ibr = cdrc::internal::acquire_retire_ibr<T>;
 
+template<typename T>
+using ibr_tagged = cdrc::ibr_tagged_backend<T>;
+
+template<typename T>
+using he = cdrc::internal::acquire_retire_he<T>;
+
+template<typename T>
+using nbr = cdrc::internal::acquire_retire_nbr<T>;
+
 template<typename T>
 using hyaline = cdrc::internal::acquire_retire_hyaline<T>;
 
+template<typename T>
+using hyaline_s = cdrc::internal::acquire_retire_hyaline_s<T>;
+
+template<typename T>
+using crystalline = cdrc::internal::acquire_retire_crystalline<T>;
+
 int main() {
   run_all_tests<LinkListRCSSFactory<int, int, hp>>(4000);
+  run_all_tests<LinkListRCSSFactory<int, int, hp_asym>>(4000);
   run_all_tests<LinkListRCSSFactory<int, int, ebr, cdrc::epoch_guard>>(4000);
   run_all_tests<LinkListRCSSFactory<int, int, ibr, cdrc::epoch_guard>>(4000);
+  run_all_tests<LinkListRCSSFactory<int, int, ibr_tagged, cdrc::epoch_guard>>(4000);
+  run_all_tests<LinkListRCSSFactory<int, int, he>>(4000);
+  run_all_tests<LinkListRCSSFactory<int, int, nbr>>(4000);
   run_all_tests<LinkListRCSSFactory<int, int, hyaline, cdrc::hyaline_guard>>(4000);
+  run_all_tests<LinkListRCSSFactory<int, int, hyaline_s, cdrc::hyaline_guard>>(4000);
+  run_all_tests<LinkListRCSSFactory<int, int, crystalline, cdrc::crystalline_guard>>(4000);
 
   run_all_tests<NatarajanTreeRCSSFactory<int, int, hp>>(100000);
+  run_all_tests<NatarajanTreeRCSSFactory<int, int, hp_asym>>(100000);
   run_all_tests<NatarajanTreeRCSSFactory<int, int, ebr, cdrc::epoch_guard>>(100000);
   run_all_tests<NatarajanTreeRCSSFactory<int, int, ibr, cdrc::epoch_guard>>(100000);
+  run_all_tests<NatarajanTreeRCSSFactory<int, int, ibr_tagged, cdrc::epoch_guard>>(100000);
+  run_all_tests<NatarajanTreeRCSSFactory<int, int, he>>(100000);
+  run_all_tests<NatarajanTreeRCSSFactory<int, int, nbr>>(100000);
   run_all_tests<NatarajanTreeRCSSFactory<int, int, hyaline, cdrc::hyaline_guard>>(100000);
+  run_all_tests<NatarajanTreeRCSSFactory<int, int, hyaline_s, cdrc::hyaline_guard>>(100000);
+  run_all_tests<NatarajanTreeRCSSFactory<int, int, crystalline, cdrc::crystalline_guard>>(100000);
 
   run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, hp>>(100000);
+  run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, hp_asym>>(100000);
   run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, ebr, cdrc::epoch_guard>>(100000);
   run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, ibr, cdrc::epoch_guard>>(100000);
+  run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, ibr_tagged, cdrc::epoch_guard>>(100000);
+  run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, he>>(100000);
+  run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, nbr>>(100000);
   run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, hyaline, cdrc::hyaline_guard>>(100000);
+  run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, hyaline_s, cdrc::hyaline_guard>>(100000);
+  run_all_tests<SortedUnorderedMapRCSSTestFactory<int, int, crystalline, cdrc::crystalline_guard>>(100000);
+
+  test_value_ptr<SortedUnorderedMapRCSSTestFactory<int, int, hp>>();
+  test_value_ptr<SortedUnorderedMapRCSSTestFactory<int, int, ebr, cdrc::epoch_guard>>();
+  test_value_ptr<SortedUnorderedMapRCSSTestFactory<int, int, nbr>>();
+  test_value_ptr<SortedUnorderedMapRCSSTestFactory<int, int, hyaline, cdrc::hyaline_guard>>();
 }
@@ -0,0 +1,115 @@
+#include <cassert>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using ibr_backend = cdrc::ibr_backend<T>;
+
+template<typename T>
+using he_backend = cdrc::he_backend<T>;
+
+template<typename T>
+using nbr_backend = cdrc::nbr_backend<T>;
+
+template<typename T>
+using hyaline_backend = cdrc::hyaline_backend<T>;
+
+template<typename T>
+using hyaline_s_backend = cdrc::hyaline_s_backend<T>;
+
+template<typename T>
+using crystalline_backend = cdrc::crystalline_backend<T>;
+
+// Only objects with negative values are counted, so that the objects created by
+// the surviving thread to drive its own deferred reclamation are not
+template<typename Tag>
+struct Tracked {
+  inline static std::atomic<int> num_live{0};
+  int x;
+  explicit Tracked(int x_) : x(x_) { if (x < 0) num_live++; }
+  ~Tracked() { if (x < 0) num_live--; }
+};
+
+// Short-lived threads each retire a few objects, fewer than it takes to trigger
+// any reclamation, and exit. Their deferred ejects must not outlive them
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_short_lived_threads() {
+  struct tag {};
+  using T = Tracked<tag>;
+  using rc_ptr = cdrc::rc_ptr<T, memory_manager<T>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<T, memory_manager<T>>;
+
+  atomic_rc_ptr a(rc_ptr::make_shared(-1));
+  for (int i = 0; i < 100; i++) {
+    std::thread t([&]() {
+      for (int j = 0; j < 3; j++) {
+        [[maybe_unused]] guard_t guard;
+        a.store(rc_ptr::make_shared(-1));
+      }
+    });
+    t.join();
+  }
+
+  // Whatever the exiting threads could not reclaim is adopted by the main thread
+  for (int i = 0; i < 100000 && T::num_live.load() > 0; i++) {
+    [[maybe_unused]] guard_t guard;
+    a.store(rc_ptr::make_shared(i));
+  }
+  assert(T::num_live.load() == 0);
+}
+
+// A thread exits while one of the objects that it retired is still protected
+// by another thread, so it must leave the eject behind for the surviving thread
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_protected_at_exit() {
+  struct tag {};
+  using T = Tracked<tag>;
+  using rc_ptr = cdrc::rc_ptr<T, memory_manager<T>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<T, memory_manager<T>>;
+
+  atomic_rc_ptr a(rc_ptr::make_shared(-1));
+  {
+    [[maybe_unused]] guard_t guard;
+    auto s = a.get_snapshot();
+    std::thread t([&]() { a.store(rc_ptr::make_shared(-2)); });
+    t.join();
+    assert(s->x == -1);
+  }
+
+  for (int i = 0; i < 100000 && T::num_live.load() > 0; i++) {
+    [[maybe_unused]] guard_t guard;
+    a.store(rc_ptr::make_shared(i));
+  }
+  assert(T::num_live.load() == 0);
+}
+
+int main() {
+  test_short_lived_threads<hp_backend>();
+  test_short_lived_threads<ebr_backend, cdrc::epoch_guard>();
+  test_short_lived_threads<ibr_backend, cdrc::epoch_guard>();
+  test_short_lived_threads<he_backend>();
+  test_short_lived_threads<nbr_backend>();
+  test_short_lived_threads<hyaline_backend, cdrc::hyaline_guard>();
+  test_short_lived_threads<hyaline_s_backend, cdrc::hyaline_guard>();
+  test_short_lived_threads<crystalline_backend, cdrc::crystalline_guard>();
+
+  test_protected_at_exit<hp_backend>();
+  test_protected_at_exit<ebr_backend, cdrc::epoch_guard>();
+  test_protected_at_exit<ibr_backend, cdrc::epoch_guard>();
+  test_protected_at_exit<he_backend>();
+  test_protected_at_exit<nbr_backend>();
+  test_protected_at_exit<hyaline_backend, cdrc::hyaline_guard>();
+  test_protected_at_exit<hyaline_s_backend, cdrc::hyaline_guard>();
+  test_protected_at_exit<crystalline_backend, cdrc::crystalline_guard>();
+}
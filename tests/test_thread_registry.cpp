@@ -0,0 +1,107 @@
+#include <cassert>
+#include <cstddef>
+
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <cdrc/atomic_rc_ptr.h>
+#include <cdrc/rc_ptr.h>
+
+template<typename T>
+using hp_backend = cdrc::hp_backend<T>;
+
+template<typename T>
+using ebr_backend = cdrc::ebr_backend<T>;
+
+template<typename T>
+using ibr_backend = cdrc::ibr_backend<T>;
+
+template<typename T>
+using he_backend = cdrc::he_backend<T>;
+
+template<typename T>
+using nbr_backend = cdrc::nbr_backend<T>;
+
+template<typename T>
+using hyaline_backend = cdrc::hyaline_backend<T>;
+
+template<typename T>
+using hyaline_s_backend = cdrc::hyaline_s_backend<T>;
+
+template<typename T>
+using crystalline_backend = cdrc::crystalline_backend<T>;
+
+void test_per_thread() {
+  cdrc::utils::per_thread<std::atomic<std::size_t>> values;
+  const std::size_t n = 20 * cdrc::utils::num_threads() + 100;
+  for (std::size_t i = 0; i < n; i++) values[i].store(i);
+  for (std::size_t i = 0; i < n; i++) assert(values[i].load() == i);
+}
+
+// Thread IDs of threads that have exited are handed out again
+void test_recycling() {
+  [[maybe_unused]] auto bound = cdrc::utils::num_thread_ids();
+  for (int i = 0; i < 1000; i++) {
+    std::thread t([]() { cdrc::utils::threadID.getTID(); });
+    t.join();
+  }
+  assert(cdrc::utils::num_thread_ids() <= bound + 1);
+
+  // Concurrent threads have distinct IDs
+  const std::size_t num_threads = 2 * cdrc::utils::num_threads();
+  std::vector<int> ids(num_threads);
+  std::atomic<std::size_t> ready{0};
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t]() {
+      ids[t] = cdrc::utils::threadID.getTID();
+      ready++;
+      while (ready.load() < num_threads) std::this_thread::yield();
+    });
+  }
+  for (auto& t : threads) t.join();
+  assert(std::set<int>(ids.begin(), ids.end()).size() == num_threads);
+}
+
+// Run many more threads at once than the expected number of threads
+template<template<typename> typename memory_manager, typename guard_t = cdrc::empty_guard>
+void test_oversubscribed() {
+  using rc_ptr = cdrc::rc_ptr<int, memory_manager<int>>;
+  using atomic_rc_ptr = cdrc::atomic_rc_ptr<int, memory_manager<int>>;
+
+  const std::size_t num_threads = 4 * cdrc::utils::num_threads() + 8;
+  atomic_rc_ptr a(rc_ptr::make_shared(0));
+  for (int round = 0; round < 3; round++) {
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t]() {
+        for (int i = 0; i < 1000; i++) {
+          [[maybe_unused]] guard_t guard;
+          if ((t + i) % 4 == 0) {
+            a.store(rc_ptr::make_shared(i));
+          } else {
+            auto s = a.get_snapshot();
+            assert(s != nullptr && *s >= 0);
+          }
+        }
+      });
+    }
+    for (auto& t : threads) t.join();
+  }
+  a.store(nullptr);
+}
+
+int main() {
+  test_per_thread();
+  test_recycling();
+  test_oversubscribed<hp_backend>();
+  test_oversubscribed<ebr_backend, cdrc::epoch_guard>();
+  test_oversubscribed<ibr_backend, cdrc::epoch_guard>();
+  test_oversubscribed<he_backend>();
+  test_oversubscribed<nbr_backend>();
+  test_oversubscribed<hyaline_backend, cdrc::hyaline_guard>();
+  test_oversubscribed<hyaline_s_backend, cdrc::hyaline_guard>();
+  test_oversubscribed<crystalline_backend, cdrc::crystalline_guard>();
+}